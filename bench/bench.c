@@ -0,0 +1,504 @@
+#include "camera.h"
+#include "config.h"
+#include "display.h"
+#include "kernels.h"
+#include "memory.h"
+#include "mesh.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "trace.h"
+#include "upng.h"
+
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*******************************************************/
+/* Renders every model of model_paths offscreen along  */
+/* the same scripted camera path, without frame cap or */
+/* input, and reports per stage times as JSON. With    */
+/* --baseline every model gets a frame time budget     */
+/* relative to a previous report. With --golden it     */
+/* checks rendered images of every model in            */
+/* assets/models instead.                              */
+/*******************************************************/
+
+int bench_frames = 240;         // Measured frames per model
+int bench_warmup = 30;          // Frames rendered before measuring each model
+int bench_runs = 1;             // Measured runs per model, the fastest one is reported
+const char* bench_output = "bench.json"; // JSON report path, "-" for stdout
+const char* bench_trace = NULL;         // Trace-event JSON path
+double bench_budget_ms = 0;             // Longest average frame time of a model, 0: no budget
+const char* bench_baseline = NULL;      // Report holding the frame time of every model to budget against
+double bench_budget_margin = 50;        // Percentage a model may take over its baseline frame time
+const char* golden_dir = NULL;          // Reference images, switches to the golden image check
+bool golden_record = false;             // Writes the reference images instead of checking them
+double golden_tolerance = 0.1;          // Percentage of pixels that may differ from the reference
+
+bool parse_arguments(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        bool valid;
+        if (parse_display_argument(argv[i], &valid)) {
+            if (!valid) {
+                return false;
+            }
+            continue;
+        }
+        // * "--frames=N" measures N frames per model
+        // * "--warmup=N" renders N unmeasured frames first
+        bool is_frames = strncmp(argv[i], "--frames=", 9) == 0;
+        if (is_frames || strncmp(argv[i], "--warmup=", 9) == 0) {
+            char* end;
+            long count = strtol(argv[i] + 9, &end, 10);
+            if (*end != '\0' || count < (is_frames ? 1 : 0) || count > INT32_MAX) {
+                fprintf(stderr, "<!> Invalid frame count '%s'.\n", argv[i] + 9);
+                return false;
+            }
+            *(is_frames ? &bench_frames : &bench_warmup) = (int)count;
+            continue;
+        }
+        // * "--runs=N" measures every model N times and reports its fastest run
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            char* end;
+            long count = strtol(argv[i] + 7, &end, 10);
+            if (*end != '\0' || count < 1 || count > INT32_MAX) {
+                fprintf(stderr, "<!> Invalid run count '%s'.\n", argv[i] + 7);
+                return false;
+            }
+            bench_runs = (int)count;
+            continue;
+        }
+        // * "--alloc-guard" aborts on any allocation in a steady state frame
+        if (strcmp(argv[i], "--alloc-guard") == 0) {
+            allocation_guard = true;
+            continue;
+        }
+        // * "--trace=trace.json" records stage spans for chrome://tracing or Perfetto
+        if (strncmp(argv[i], "--trace=", 8) == 0) {
+            bench_trace = argv[i] + 8;
+            continue;
+        }
+        // * "--budget-ms=X" fails when a model takes more than X ms per frame on average
+        if (strncmp(argv[i], "--budget-ms=", 12) == 0) {
+            char* end;
+            bench_budget_ms = strtod(argv[i] + 12, &end);
+            if (*end != '\0' || bench_budget_ms <= 0) {
+                fprintf(stderr, "<!> Invalid frame time budget '%s'.\n", argv[i] + 12);
+                return false;
+            }
+            continue;
+        }
+        // * "--baseline=report.json" fails when a model takes longer per frame than in that report,
+        //   plus "--budget-margin=P" percent (default 50)
+        if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            bench_baseline = argv[i] + 11;
+            continue;
+        }
+        if (strncmp(argv[i], "--budget-margin=", 16) == 0) {
+            char* end;
+            bench_budget_margin = strtod(argv[i] + 16, &end);
+            if (*end != '\0' || bench_budget_margin < 0) {
+                fprintf(stderr, "<!> Invalid budget margin '%s' (expected a percentage).\n", argv[i] + 16);
+                return false;
+            }
+            continue;
+        }
+        // * "--golden=dir" renders every model in every draw mode and compares the frames
+        //   with the reference images in dir, "--record" writes them there instead
+        if (strncmp(argv[i], "--golden=", 9) == 0) {
+            golden_dir = argv[i] + 9;
+            continue;
+        }
+        if (strcmp(argv[i], "--record") == 0) {
+            golden_record = true;
+            continue;
+        }
+        // * "--tolerance=P" lets up to P percent of the pixels differ from the reference
+        if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+            char* end;
+            golden_tolerance = strtod(argv[i] + 12, &end);
+            if (*end != '\0' || golden_tolerance < 0 || golden_tolerance > 100) {
+                fprintf(stderr, "<!> Invalid tolerance '%s' (expected a percentage).\n", argv[i] + 12);
+                return false;
+            }
+            continue;
+        }
+        // * "--output=report.json" sets the report path, "-" prints it
+        if (strncmp(argv[i], "--output=", 9) == 0) {
+            bench_output = argv[i] + 9;
+            continue;
+        }
+        fprintf(stderr, "<!> Unknown argument '%s'.\n", argv[i]);
+        return false;
+    }
+    if (golden_record && !golden_dir) {
+        fprintf(stderr, "<!> --record needs --golden.\n");
+        return false;
+    }
+    return true;
+}
+
+// Frame i of count: one turn of the model, a nod, and a dolly in and back out
+void place_camera(int i, int count) {
+    float t = 2.0f * (float)M_PI * i / count;
+    mesh.rotation = (vec3_t){ 0.3f * sinf(t), t, 0 };
+    camera.position = (vec3_t){ 0, 0, 1.25f * (1.0f - cosf(t)) };
+    camera.rotation = (vec3_t){ 0, 0, 0 };
+}
+
+void write_stats(FILE* out, const char* indent, double seconds) {
+    double frames = frame_stats.frames ? (double)frame_stats.frames : 1.0;
+    fprintf(out, "%s\"frames\": %llu,\n", indent, (unsigned long long)frame_stats.frames);
+    fprintf(out, "%s\"triangles\": %llu,\n", indent, (unsigned long long)frame_stats.triangles);
+    fprintf(out, "%s\"seconds\": %.6f,\n", indent, seconds);
+    fprintf(out, "%s\"fps\": %.3f,\n", indent, frame_stats.frames / seconds);
+    fprintf(out, "%s\"triangles_per_second\": %.1f,\n", indent, frame_stats.triangles / seconds);
+    fprintf(out, "%s\"frame_ms\": %.6f,\n", indent, seconds * 1000.0 / frames);
+    fprintf(out, "%s\"stage_ms\": {", indent);
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        fprintf(out, "%s\"%s\": %.6f", stage ? ", " : " ", pipeline_stage_name(stage),
+            stats_ticks_to_ms(frame_stats.stage_ticks[stage]) / frames);
+    }
+    fprintf(out, " },\n");
+    fprintf(out, "%s\"present_wait_ms\": %.6f,\n", indent, stats_ticks_to_ms(frame_stats.present_wait_ticks) / frames);
+
+    const pipeline_counters_t* c = &frame_stats.counters;
+    fprintf(out, "%s\"counters\": { \"faces\": %llu, \"faces_culled\": %llu, \"faces_clipped\": %llu, "
+        "\"clip_triangles\": %llu, \"triangles_dropped\": %llu, \"pixels_tested\": %llu, \"pixels_written\": %llu }\n", indent,
+        (unsigned long long)c->faces, (unsigned long long)c->faces_culled, (unsigned long long)c->faces_clipped,
+        (unsigned long long)c->clip_triangles, (unsigned long long)c->triangles_dropped,
+        (unsigned long long)c->pixels_tested, (unsigned long long)c->pixels_written);
+}
+
+// Renders every model along the scripted path and writes the JSON report, false on a failed
+// present or a model over the frame time budget
+// The whole file as a string, NULL when it can not be read
+char* read_text_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    char* text = NULL;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0 && (text = malloc((size_t)size + 1)) != NULL) {
+        if (fread(text, 1, (size_t)size, file) == (size_t)size) {
+            text[size] = '\0';
+        } else {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(file);
+    return text;
+}
+
+// The frame_ms of model name in a report written by run_benchmark(), 0 when it has none
+double baseline_frame_ms(const char* report, const char* name) {
+    char key[512];
+    snprintf(key, sizeof(key), "\"name\": \"%s\",", name);
+    const char* model = strstr(report, key);
+    const char* frame_ms = model ? strstr(model, "\"frame_ms\": ") : NULL;
+    return frame_ms ? strtod(frame_ms + 12, NULL) : 0;
+}
+
+bool run_benchmark(FILE* out) {
+    char* baseline = NULL;
+    if (bench_baseline && (baseline = read_text_file(bench_baseline)) == NULL) {
+        fprintf(stderr, "<!> Could not read the baseline %s.\n", bench_baseline);
+        return false;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"isa\": \"%s\",\n", kernels.name);
+    fprintf(out, "  \"depth\": \"%s\",\n", depth_format_name(depth_format));
+    fprintf(out, "  \"layout\": \"%s\",\n", framebuffer_layout_name(framebuffer_layout));
+    fprintf(out, "  \"buffers\": %d,\n", frame_buffer_count);
+    fprintf(out, "  \"width\": %d,\n", win_width);
+    fprintf(out, "  \"height\": %d,\n", win_height);
+    fprintf(out, "  \"models\": [\n");
+
+    frame_stats_t totals = { 0 };
+    uint64_t total_ticks = 0;
+    bool presented = true;
+    bool within_budget = true;
+
+    // setup() loaded the first model already
+    for (int model = 0; model_paths[model] != NULL && presented; ++model) {
+        if (model > 0) {
+            load_next_obj_file_data();
+        }
+
+        for (int i = 0; i < bench_warmup && presented; ++i) {
+            place_camera(i, bench_warmup);
+            update(1.0f / FPS);
+            presented = render();
+        }
+
+        // The fastest run is the one least disturbed by the rest of the machine
+        frame_stats_t fastest = { 0 };
+        uint64_t ticks = 0;
+        for (int run = 0; run < bench_runs && presented; ++run) {
+            reset_frame_stats();
+            uint64_t start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < bench_frames && presented; ++i) {
+                place_camera(i, bench_frames);
+                update(1.0f / FPS);
+                presented = render();
+            }
+            // The frames still queued for presentation are part of the run
+            flush_frames();
+            uint64_t run_ticks = SDL_GetPerformanceCounter() - start;
+            if (run == 0 || run_ticks < ticks) {
+                ticks = run_ticks;
+                fastest = frame_stats;
+            }
+        }
+        frame_stats = fastest;
+
+        fprintf(out, "%s    {\n      \"name\": \"%s\",\n", model > 0 ? ",\n" : "", model_paths[model]);
+        write_stats(out, "      ", stats_ticks_to_ms(ticks) / 1000.0);
+        fprintf(out, "    }");
+
+        // The tighter of --budget-ms and the baseline budget applies
+        double frame_ms = stats_ticks_to_ms(ticks) / (frame_stats.frames ? frame_stats.frames : 1);
+        double budget_ms = bench_budget_ms;
+        if (baseline) {
+            double baseline_ms = baseline_frame_ms(baseline, model_paths[model]);
+            double relative_ms = baseline_ms * (1.0 + bench_budget_margin / 100.0);
+            if (baseline_ms <= 0) {
+                fprintf(stderr, "<!> %s has no frame time in the baseline %s.\n", model_paths[model], bench_baseline);
+                within_budget = false;
+            } else if (budget_ms <= 0 || relative_ms < budget_ms) {
+                budget_ms = relative_ms;
+            }
+        }
+        if (budget_ms > 0 && frame_ms > budget_ms) {
+            fprintf(stderr, "<!> %s is over budget: %.3f ms per frame (budget %.3f ms).\n", model_paths[model], frame_ms, budget_ms);
+            within_budget = false;
+        }
+
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            totals.stage_ticks[stage] += frame_stats.stage_ticks[stage];
+        }
+        totals.present_wait_ticks += frame_stats.present_wait_ticks;
+        totals.frames += frame_stats.frames;
+        totals.triangles += frame_stats.triangles;
+        add_pipeline_counters(&totals.counters, &frame_stats.counters);
+        total_ticks += ticks;
+    }
+
+    frame_stats = totals;
+    fprintf(out, "\n  ],\n  \"totals\": {\n");
+    write_stats(out, "    ", stats_ticks_to_ms(total_ticks) / 1000.0);
+    fprintf(out, "  },\n  \"steady_frame_allocations\": %llu,\n", (unsigned long long)steady_frame_allocations());
+    fprintf(out, "  \"within_budget\": %s\n}\n", within_budget ? "true" : "false");
+    free(baseline);
+    return presented && within_budget;
+}
+
+/*******************************************************/
+/* Golden images: every model from fixed viewpoints in */
+/* every draw mode, compared with reference PNGs. The  */
+/* frames that fail are kept in the working directory  */
+/* as <name>.out.png, the references are only read.    */
+/*******************************************************/
+#define GOLDEN_CHANNEL_TOLERANCE 2  // Largest channel difference of a matching pixel
+
+typedef struct {
+    const char* name;
+    int step;                       // Frame of the scripted path, out of GOLDEN_PATH_STEPS
+} golden_view_t;
+
+// Every model in assets/models, not only the ones the viewer cycles through. A model without
+// a texture keeps the one of the model before it, so the order is part of the references
+static const char* golden_models[] = {
+    "cube",
+    "colored_cube",
+    "crab",
+    "drone",
+    "efa",
+    "f117",
+    "f22",
+    "flat_vase",
+    "quad",
+    "sphere",
+    "runway",
+    "smooth_vase",
+};
+
+#define GOLDEN_PATH_STEPS 8
+static const golden_view_t golden_views[] = {
+    { "front", 0 },
+    { "three_quarter", 1 },
+    { "close", 4 },                 // Nearest point of the dolly
+};
+
+typedef struct {
+    const char* name;
+    draw_config_t config;
+} golden_mode_t;
+
+static const golden_mode_t golden_modes[] = {
+    { "wireframe", D_WIREFRAME | D_BACK_FACE_CULLED },
+    { "wireframe_nocull", D_WIREFRAME },
+    { "solid", D_SOLID | D_BACK_FACE_CULLED },
+    { "solid_nocull", D_SOLID },
+    { "textured", D_TEXTURED | D_BACK_FACE_CULLED },
+    { "textured_nocull", D_TEXTURED },
+};
+
+// Reads a PNG as written by write_frame() into RGBA32 pixels, NULL when it can not
+static uint8_t* read_png(const char* path, int* width, int* height) {
+    upng_t* png = upng_new_from_file(path);
+    if (png == NULL) {
+        return NULL;
+    }
+    uint8_t* pixels = NULL;
+    if (upng_header(png) == UPNG_EOK) {
+        *width = (int)upng_get_width(png);
+        *height = (int)upng_get_height(png);
+        size_t size = (size_t)*width * *height * 4;
+        pixels = (uint8_t*)malloc(size);
+        if (pixels && upng_decode_rgba(png, pixels, (unsigned long)size) != UPNG_EOK) {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    upng_free(png);
+    return pixels;
+}
+
+// Percentage of pixels that differ, or -1 when the images can not be compared
+static double compare_images(const char* reference_path, const char* frame_path) {
+    int reference_width, reference_height, width, height;
+    uint8_t* reference = read_png(reference_path, &reference_width, &reference_height);
+    uint8_t* frame = read_png(frame_path, &width, &height);
+    double different = -1;
+    if (reference && frame && reference_width == width && reference_height == height) {
+        size_t count = 0;
+        for (size_t i = 0; i < (size_t)width * height; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                if (abs(reference[i * 4 + c] - frame[i * 4 + c]) > GOLDEN_CHANNEL_TOLERANCE) {
+                    count++;
+                    break;
+                }
+            }
+        }
+        different = 100.0 * count / ((double)width * height);
+    }
+    free(reference);
+    free(frame);
+    return different;
+}
+
+bool run_golden() {
+    int images = 0;
+    int failures = 0;
+    draw_config_t previous_config = draw_config;
+
+    for (size_t model = 0; model < sizeof(golden_models) / sizeof(golden_models[0]); ++model) {
+        model_data_t data;
+        load_named_model_data(golden_models[model], &data);
+        swap_model_data(&data);
+        release_model_data(&data);
+        for (size_t view = 0; view < sizeof(golden_views) / sizeof(golden_views[0]); ++view) {
+            for (size_t mode = 0; mode < sizeof(golden_modes) / sizeof(golden_modes[0]); ++mode) {
+                char name[256], reference_path[1024], frame_path[1024];
+                snprintf(name, sizeof(name), "%s_%s_%s", golden_models[model], golden_views[view].name, golden_modes[mode].name);
+                snprintf(reference_path, sizeof(reference_path), "%s/%s.png", golden_dir, name);
+                snprintf(frame_path, sizeof(frame_path), "%s.out.png", name);
+
+                // A single frame buffer set presents, that is writes the frame, inside render()
+                frame_output_path = golden_record ? reference_path : frame_path;
+                draw_config = golden_modes[mode].config;
+                place_camera(golden_views[view].step, GOLDEN_PATH_STEPS);
+                update(1.0f / FPS);
+                if (!render()) {
+                    return false;
+                }
+                images++;
+                if (golden_record) {
+                    continue;
+                }
+
+                double different = compare_images(reference_path, frame_path);
+                if (different < 0) {
+                    fprintf(stderr, "<!> %s: no usable reference image %s.\n", name, reference_path);
+                    failures++;
+                } else if (different > golden_tolerance) {
+                    fprintf(stderr, "<!> %s: %.3f%% of the pixels differ (tolerance %.3f%%).\n", name, different, golden_tolerance);
+                    failures++;
+                } else {
+                    remove(frame_path);
+                }
+            }
+        }
+    }
+    frame_output_path = NULL;
+    draw_config = previous_config;
+
+    if (golden_record) {
+        printf("Golden images: %d recorded in %s\n", images, golden_dir);
+    } else {
+        printf("Golden images: %d checked, %d failed\n", images, failures);
+    }
+    return failures == 0;
+}
+
+int main(int argc, char **argv) {
+    if (!parse_arguments(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+
+    // No window; frame files are only written by the golden image check
+    headless = true;
+    frame_output_path = NULL;
+    if (golden_dir) {
+        frame_buffer_count = 1;
+    }
+
+    if (bench_trace) {
+        start_trace(bench_trace);
+        trace_thread_name("render");
+    }
+
+    init_kernels();
+
+    if (!initialize_window() || !setup()) {
+        destroy_window();
+        return EXIT_FAILURE;
+    }
+
+    bool passed;
+    if (golden_dir) {
+        passed = run_golden();
+    } else {
+        // Model loading logs to stdout, so the report only goes there on request
+        bool to_stdout = strcmp(bench_output, "-") == 0;
+        FILE* out = to_stdout ? stdout : fopen(bench_output, "w");
+        if (out == NULL) {
+            fprintf(stderr, "<!> Could not open %s for writing.\n", bench_output);
+            destroy_window();
+            free_resources();
+            return EXIT_FAILURE;
+        }
+        passed = run_benchmark(out);
+        if (!to_stdout) {
+            fclose(out);
+            printf("Benchmark report: %s\n", bench_output);
+        }
+    }
+
+    destroy_window();
+    stop_trace();
+    free_resources();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,427 @@
+#include "bc1.h"
+#include "clipping.h"
+#include "display.h"
+#include "kernels.h"
+#include "light.h"
+#include "matrix.h"
+#include "palette.h"
+#include "texture.h"
+#include "triangle.h"
+#include "upng.h"
+#include "vector.h"
+
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************************/
+/* Hot functions timed one by one over synthetic       */
+/* inputs. Every benchmark is warmed up, then runs in  */
+/* samples of enough iterations to last --sample-ms:   */
+/* the median time per call and its median absolute    */
+/* deviation (MAD) over --samples are shown.           */
+/*******************************************************/
+
+#define MICROBENCH_SIZE 512     // Square framebuffer, fits the 100k pixel triangles
+#define MICROBENCH_TEXTURE 64
+#define MICROBENCH_LARGE_TEXTURE 2048  // 16 MB as RGBA32, far past the caches
+#define MAX_SAMPLES 1001
+#define MAX_ITERATIONS (1 << 30)
+// Calibration keeps the fastest of these samples: a preemption or a cache flush only makes one slower
+#define CALIBRATION_SAMPLES 3
+
+typedef struct {
+    const char* name;
+    void (*run)(int param, int iterations);
+    int param;
+    double items;               // Work items per call (pixels, vertices...), 0: none
+} microbench_t;
+
+static int samples = 31;
+static int warmup_samples = 5;
+static double sample_ms = 2.0;
+static const char* filter = NULL;
+
+// Results are folded in here so the compiler can not drop the calls
+static volatile uint32_t sink;
+
+/*******************************************************/
+/* Matrices                                            */
+/*******************************************************/
+void run_mat4_mul_mat4(int param, int iterations) {
+    mat4_t rotation = mat4_make_rotation_y(0.001f);
+    mat4_t m = mat4_identity();
+    for (int i = 0; i < iterations; ++i) {
+        m = mat4_mul_mat4(rotation, m);
+    }
+    sink += (uint32_t)(m.m[0][0] * 1000.0f);
+}
+
+void run_mat4_mul_vec4(int param, int iterations) {
+    mat4_t rotation = mat4_make_rotation_y(0.001f);
+    vec4_t v = { 1, 2, 3, 1 };
+    for (int i = 0; i < iterations; ++i) {
+        v = mat4_mul_vec4(rotation, v);
+    }
+    sink += (uint32_t)(v.x * 1000.0f);
+}
+
+#define TRANSFORM_VERTICES 1024
+void run_transform_vertices(int param, int iterations) {
+    static vec3_t in[TRANSFORM_VERTICES];
+    static vec4_t out[TRANSFORM_VERTICES];
+    for (int i = 0; i < TRANSFORM_VERTICES; ++i) {
+        in[i] = (vec3_t){ (float)i, (float)(i & 15), (float)(i >> 4) };
+    }
+    mat4_t m = mat4_make_rotation_y(0.5f);
+    for (int i = 0; i < iterations; ++i) {
+        kernels.transform_vertices(out, in, TRANSFORM_VERTICES, &m);
+    }
+    sink += (uint32_t)out[TRANSFORM_VERTICES - 1].x;
+}
+
+/*******************************************************/
+/* Clipping, the frustum of the renderer: 60 degrees   */
+/* field of view, near 0.1, far 100                    */
+/*******************************************************/
+enum { CLIP_INSIDE, CLIP_STRADDLING, CLIP_OUTSIDE };
+
+void run_clip_polygon(int param, int iterations) {
+    vec3_t a, b, c;
+    switch (param) {
+        case CLIP_INSIDE:     a = (vec3_t){ -1, -1, 5 }; b = (vec3_t){ 0, 1, 5 };  c = (vec3_t){ 1, -1, 5 };  break;
+        case CLIP_STRADDLING: a = (vec3_t){ -9, -1, 5 }; b = (vec3_t){ 0, 9, -1 }; c = (vec3_t){ 1, -1, 5 };  break;
+        default:              a = (vec3_t){ -9, -1, 5 }; b = (vec3_t){ -8, 1, 5 }; c = (vec3_t){ -7, -1, 5 }; break;
+    }
+    tex2_t uv = { 0, 0 };
+    int vertices = 0;
+    for (int i = 0; i < iterations; ++i) {
+        polygon_t polygon = create_polygon_from_triangle(a, b, c, uv, uv, uv);
+        clip_polygon(&polygon);
+        vertices += polygon.num_vertices;
+    }
+    sink += vertices;
+}
+
+/*******************************************************/
+/* Triangles of param pixels: right triangles with     */
+/* equal legs. Every call is drawn closer than the     */
+/* last, so all of them pass the depth test; the       */
+/* z-buffer is cleared when the depth range runs out.  */
+/*******************************************************/
+static uint32_t* texture = NULL;
+static uint32_t* large_texture = NULL;
+static float inv_w = 0;
+
+// Noise texels, in texture_format as the span shaders sample them
+static uint32_t* make_texture(int size) {
+    uint32_t* pixels = malloc((size_t)size * size * sizeof(uint32_t));
+    for (int i = 0; i < size * size; ++i) {
+        pixels[i] = 0xFF000000 | (uint32_t)i * 2654435761u;
+    }
+    if (texture_format == TEXTURE_FORMAT_BC1) {
+        uint32_t* blocks = malloc(bc1_size(size, size));
+        bc1_encode(blocks, pixels, size, size);
+        free(pixels);
+        return blocks;
+    }
+    if (texture_format == TEXTURE_FORMAT_PALETTE) {
+        uint32_t* palettized = malloc(palette_size(size, size));
+        int colors;
+        palette_encode(palettized, pixels, size, size, &colors);
+        free(pixels);
+        return palettized;
+    }
+    return pixels;
+}
+
+static float next_w() {
+    // One step of the coarsest depth format, 1/w is stored as 1 - 1/w (depth_near is 1)
+    float step = depth_format == DEPTH_FORMAT_U16 ? 2.0f / DEPTH_U16_MAX : 1.0e-6f;
+    inv_w += step;
+    if (inv_w >= 0.99f) {
+        clear_z_buffer();
+        inv_w = step;
+    }
+    return 1.0f / inv_w;
+}
+
+void run_draw_filled_triangle_with_z(int param, int iterations) {
+    int leg = (int)ceilf(sqrtf(2.0f * param));
+    for (int i = 0; i < iterations; ++i) {
+        float w = next_w();
+        draw_filled_triangle_with_z(4, 4, 0, w, 4 + leg, 4, 0, w, 4, 4 + leg, 0, w, 0xFFEEEEEE, 1.0f);
+    }
+    sink += color_buffer[pixel_index(4, 4)];
+}
+
+void run_draw_textured_triangle(int param, int iterations) {
+    int leg = (int)ceilf(sqrtf(2.0f * param));
+    texture_width = MICROBENCH_TEXTURE;
+    texture_height = MICROBENCH_TEXTURE;
+    for (int i = 0; i < iterations; ++i) {
+        float w = next_w();
+        // One texture repeat across the legs
+        draw_textured_triangle(
+            4, 4, 0, w, 0, 0,
+            4 + leg, 4, 0, w, 1, 0,
+            4, 4 + leg, 0, w, 0, 1,
+            texture, 0.8f
+        );
+    }
+    sink += color_buffer[pixel_index(4, 4)];
+}
+
+// The whole large texture across the legs, minified about 4 times: texture memory bound
+void run_draw_large_textured_triangle(int param, int iterations) {
+    int leg = (int)ceilf(sqrtf(2.0f * param));
+    texture_width = MICROBENCH_LARGE_TEXTURE;
+    texture_height = MICROBENCH_LARGE_TEXTURE;
+    for (int i = 0; i < iterations; ++i) {
+        float w = next_w();
+        draw_textured_triangle(
+            4, 4, 0, w, 0, 0,
+            4 + leg, 4, 0, w, 1, 0,
+            4, 4 + leg, 0, w, 0, 1,
+            large_texture, 0.8f
+        );
+    }
+    sink += color_buffer[pixel_index(4, 4)];
+}
+
+/*******************************************************/
+/* Clears, shading, PNG decoding                       */
+/*******************************************************/
+void run_clear_color_buffer(int param, int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        clear_color_buffer(0xFF000000 | i);
+    }
+    sink += color_buffer[0];
+}
+
+void run_update_color_intensity(int param, int iterations) {
+    uint32_t color = 0;
+    for (int i = 0; i < iterations; ++i) {
+        color += update_color_intensity(0xFF808080 ^ i, (i & 255) / 255.0f);
+    }
+    sink += color;
+}
+
+static unsigned char* png_bytes = NULL;
+static unsigned long png_size = 0;
+
+void run_upng_decode(int param, int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        upng_t* png = upng_new_from_bytes(png_bytes, png_size);
+        upng_decode(png);
+        sink += upng_get_width(png);
+        upng_free(png);
+    }
+}
+
+static bool load_png_bytes(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "<!> Could not open %s.\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    png_size = (unsigned long)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    png_bytes = (unsigned char*)malloc(png_size);
+    bool read = png_bytes && fread(png_bytes, 1, png_size, file) == png_size;
+    fclose(file);
+    if (!read) {
+        fprintf(stderr, "<!> Could not read %s.\n", path);
+    }
+    return read;
+}
+
+#define TRIANGLE_SWEEP(name, run) \
+    { name " 1px", run, 1, 1 }, \
+    { name " 10px", run, 10, 10 }, \
+    { name " 100px", run, 100, 100 }, \
+    { name " 1kpx", run, 1000, 1000 }, \
+    { name " 10kpx", run, 10000, 10000 }, \
+    { name " 100kpx", run, 100000, 100000 }
+
+static const microbench_t microbenches[] = {
+    { "mat4_mul_mat4", run_mat4_mul_mat4, 0, 0 },
+    { "mat4_mul_vec4", run_mat4_mul_vec4, 0, 0 },
+    { "transform_vertices 1024", run_transform_vertices, 0, TRANSFORM_VERTICES },
+    { "clip_polygon inside", run_clip_polygon, CLIP_INSIDE, 0 },
+    { "clip_polygon straddling", run_clip_polygon, CLIP_STRADDLING, 0 },
+    { "clip_polygon outside", run_clip_polygon, CLIP_OUTSIDE, 0 },
+    TRIANGLE_SWEEP("draw_filled_triangle_with_z", run_draw_filled_triangle_with_z),
+    TRIANGLE_SWEEP("draw_textured_triangle", run_draw_textured_triangle),
+    { "draw_textured_triangle 2k texture 100kpx", run_draw_large_textured_triangle, 100000, 100000 },
+    { "clear_color_buffer", run_clear_color_buffer, 0, MICROBENCH_SIZE * MICROBENCH_SIZE },
+    { "update_color_intensity", run_update_color_intensity, 0, 0 },
+    { "upng_decode", run_upng_decode, 0, 0 },
+};
+
+/*******************************************************/
+/* Statistics                                          */
+/*******************************************************/
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts values in place
+static double median(double* values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+static double time_sample(const microbench_t* bench, int iterations) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    bench->run(bench->param, iterations);
+    return (SDL_GetPerformanceCounter() - start) * 1.0e9 / SDL_GetPerformanceFrequency();
+}
+
+static double fastest_sample(const microbench_t* bench, int iterations) {
+    double fastest = time_sample(bench, iterations);
+    for (int i = 1; i < CALIBRATION_SAMPLES; ++i) {
+        double ns = time_sample(bench, iterations);
+        if (ns < fastest) {
+            fastest = ns;
+        }
+    }
+    return fastest;
+}
+
+static void run_microbench(const microbench_t* bench) {
+    // Untimed calls for --sample-ms per warmup sample first: page faults and cold caches in a
+    // first sample would otherwise end the calibration after a handful of iterations
+    for (int i = 0; i < warmup_samples; ++i) {
+        double elapsed = 0;
+        for (int iterations = 1; elapsed < sample_ms * 1.0e6 && iterations < MAX_ITERATIONS; iterations *= 2) {
+            elapsed += time_sample(bench, iterations);
+        }
+    }
+
+    // Double the iterations until one sample lasts long enough to time
+    int iterations = 1;
+    while (fastest_sample(bench, iterations) < sample_ms * 1.0e6 && iterations < MAX_ITERATIONS) {
+        iterations *= 2;
+    }
+
+    static double ns_per_call[MAX_SAMPLES];
+    static double deviations[MAX_SAMPLES];
+    for (int i = 0; i < samples; ++i) {
+        ns_per_call[i] = time_sample(bench, iterations) / iterations;
+    }
+
+    double mid = median(ns_per_call, samples);
+    for (int i = 0; i < samples; ++i) {
+        deviations[i] = fabs(ns_per_call[i] - mid);
+    }
+    double mad = median(deviations, samples);
+
+    printf("%-40s %10d %14.2f %12.2f %7.2f%%", bench->name, iterations, mid, mad, mid > 0 ? 100.0 * mad / mid : 0.0);
+    if (bench->items > 0) {
+        printf(" %12.1f", bench->items * 1000.0 / mid);
+    }
+    printf("\n");
+}
+
+static bool parse_count(const char* value, int min, int max, int* count) {
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    if (*end != '\0' || parsed < min || parsed > max) {
+        fprintf(stderr, "<!> Invalid count '%s' (expected %d to %d).\n", value, min, max);
+        return false;
+    }
+    *count = (int)parsed;
+    return true;
+}
+
+bool parse_arguments(int argc, char **argv, const char** png_path) {
+    for (int i = 1; i < argc; ++i) {
+        bool valid;
+        if (parse_display_argument(argv[i], &valid)) {
+            if (!valid) {
+                return false;
+            }
+            continue;
+        }
+        // * "--samples=N" timed samples per benchmark
+        if (strncmp(argv[i], "--samples=", 10) == 0) {
+            if (!parse_count(argv[i] + 10, 1, MAX_SAMPLES, &samples)) return false;
+            continue;
+        }
+        // * "--warmup=N" untimed samples first
+        if (strncmp(argv[i], "--warmup=", 9) == 0) {
+            if (!parse_count(argv[i] + 9, 0, MAX_SAMPLES, &warmup_samples)) return false;
+            continue;
+        }
+        // * "--sample-ms=N" shortest sample
+        if (strncmp(argv[i], "--sample-ms=", 12) == 0) {
+            int ms;
+            if (!parse_count(argv[i] + 12, 1, 10000, &ms)) return false;
+            sample_ms = ms;
+            continue;
+        }
+        // * "--filter=text" only runs the benchmarks whose name contains text
+        if (strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+            continue;
+        }
+        // * "--png=path" image decoded by upng_decode
+        if (strncmp(argv[i], "--png=", 6) == 0) {
+            *png_path = argv[i] + 6;
+            continue;
+        }
+        fprintf(stderr, "<!> Unknown argument '%s'.\n", argv[i]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char* png_path = "./assets/models/f22.png";
+    if (!parse_arguments(argc, argv, &png_path) || !load_png_bytes(png_path)) {
+        return EXIT_FAILURE;
+    }
+
+    // Offscreen, presented by nobody: only the buffers are needed
+    headless = true;
+    frame_buffer_count = 1;
+    win_width = MICROBENCH_SIZE;
+    win_height = MICROBENCH_SIZE;
+
+    init_kernels();
+    if (!initialize_window() || !create_frame_buffers()) {
+        destroy_window();
+        return EXIT_FAILURE;
+    }
+
+    depth_near = 1.0f;
+    float fovy = M_PI / 3.0f;
+    init_frustum_planes(fovy, fovy, 0.1f, 100.0f);
+
+    texture = make_texture(MICROBENCH_TEXTURE);
+    large_texture = make_texture(MICROBENCH_LARGE_TEXTURE);
+
+    printf("ISA: %s, depth: %s, layout: %s, textures: %s, %d samples of %.0f ms or more\n",
+        kernels.name, depth_format_name(depth_format), framebuffer_layout_name(framebuffer_layout),
+        texture_format_name(texture_format), samples, sample_ms);
+    printf("%-40s %10s %14s %12s %8s %12s\n", "benchmark", "iterations", "median ns", "MAD ns", "MAD", "items/us");
+    for (size_t i = 0; i < sizeof(microbenches) / sizeof(microbenches[0]); ++i) {
+        if (filter == NULL || strstr(microbenches[i].name, filter)) {
+            run_microbench(&microbenches[i]);
+        }
+    }
+
+    destroy_frame_buffers();
+    destroy_window();
+    free(png_bytes);
+    free(texture);
+    free(large_texture);
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "array.h"
+#include "memory.h"
 
 #define ARRAY_RAW_DATA(array) ((int*)(array) - 2)
 #define ARRAY_CAPACITY(array) (ARRAY_RAW_DATA(array)[0])
@@ -9,7 +10,7 @@
 void* array_hold(void* array, int count, int item_size) {
     if (array == NULL) {
         int raw_size = (sizeof(int) * 2) + (item_size * count);
-        int* base = (int*)malloc(raw_size);
+        int* base = (int*)memory_alloc(MEMORY_ARRAYS, raw_size);
         base[0] = count;  // capacity
         base[1] = count;  // occupied
         return base + 2;
@@ -22,19 +23,60 @@ void* array_hold(void* array, int count, int item_size) {
         int capacity = needed_size > float_curr ? needed_size : float_curr;
         int occupied = needed_size;
         int raw_size = sizeof(int) * 2 + item_size * capacity;
-        int* base = (int*)realloc(ARRAY_RAW_DATA(array), raw_size);
+        int* base = (int*)memory_realloc(MEMORY_ARRAYS, ARRAY_RAW_DATA(array), raw_size);
         base[0] = capacity;
         base[1] = occupied;
         return base + 2;
     }
 }
 
+void* array_reserve(void* array, int capacity, int item_size) {
+    if (array_capacity(array) >= capacity) {
+        return array;
+    }
+    int occupied = array_length(array);
+    int raw_size = sizeof(int) * 2 + item_size * capacity;
+    int* base = (int*)memory_realloc(MEMORY_ARRAYS, array ? ARRAY_RAW_DATA(array) : NULL, raw_size);
+    base[0] = capacity;
+    base[1] = occupied;
+    return base + 2;
+}
+
+int array_capacity(void* array) {
+    return (array != NULL) ? ARRAY_CAPACITY(array) : 0;
+}
+
 int array_length(void* array) {
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
 
+// Empties the array but keeps its memory for reuse
+void array_clear(void* array) {
+    if (array != NULL) {
+        ARRAY_OCCUPIED(array) = 0;
+    }
+}
+
+const void* array_stored(void* array, int item_size, size_t* size) {
+    if (array == NULL) {
+        *size = 0;
+        return NULL;
+    }
+    *size = sizeof(int) * 2 + (size_t)item_size * ARRAY_OCCUPIED(array);
+    return ARRAY_RAW_DATA(array);
+}
+
+void* array_from_stored(const void* stored, size_t size, int item_size) {
+    const int* base = (const int*)stored;
+    if (stored == NULL || size < sizeof(int) * 2 || base[1] < 0 ||
+        size != sizeof(int) * 2 + (size_t)item_size * base[1]) {
+        return NULL;
+    }
+    return (void*)(base + 2);
+}
+
 void array_free(void* array) {
     if (array != NULL) {
-        free(ARRAY_RAW_DATA(array));
+        memory_free(ARRAY_RAW_DATA(array));
     }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef PK_ARRAY_H
 #define PK_ARRAY_H
 
+#include <stddef.h>
+
 #define array_push(array, value)                                              \
     do {                                                                      \
         (array) = array_hold((array), 1, sizeof(*(array)));                   \
@@ -9,6 +11,15 @@
 
 void* array_hold(void* array, int count, int item_size);
 int array_length(void* array);
+// Grows the capacity to at least capacity items, keeping the length
+void* array_reserve(void* array, int capacity, int item_size);
+int array_capacity(void* array);
+void array_clear(void* array);
 void array_free(void* array);
 
+// An array as one block of bytes, its header then its items, to store it in a file.
+// array_from_stored() turns such a block back into an array that can not grow nor be freed.
+const void* array_stored(void* array, int item_size, size_t* size);
+void* array_from_stored(const void* stored, size_t size, int item_size);
+
 #endif // PK_ARRAY_H
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "asset_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ASSET_CACHE_MAGIC 0x43414B50u  // "PKAC"
+#define ASSET_CACHE_ALIGNMENT 64        // Sections start on a cache line
+
+static bool cache_path(char* path, size_t size, const char* source_path) {
+    int written = snprintf(path, size, "%s.cache", source_path);
+    return written >= 0 && written < (int)size;
+}
+
+static bool source_stamp(const char* source_path, uint64_t* size, int64_t* mtime) {
+    struct stat info;
+    if (stat(source_path, &info) != 0) {
+        return false;
+    }
+    *size = (uint64_t)info.st_size;
+    *mtime = (int64_t)info.st_mtime;
+    return true;
+}
+
+bool open_asset_cache(const char* source_path, asset_cache_kind_t kind, mapped_file_t* file) {
+    char path[1024];
+    uint64_t size;
+    int64_t mtime;
+    memset(file, 0, sizeof(*file));
+    if (!cache_path(path, sizeof(path), source_path) || !source_stamp(source_path, &size, &mtime)) {
+        return false;
+    }
+    struct stat info;
+    if (stat(path, &info) != 0 || !map_file(path, file)) {
+        return false;
+    }
+
+    const asset_cache_header_t* header = asset_cache_header(file);
+    bool valid = file->size >= sizeof(asset_cache_header_t) &&
+        header->magic == ASSET_CACHE_MAGIC &&
+        header->version == ASSET_CACHE_VERSION &&
+        header->kind == (uint32_t)kind &&
+        header->source_size == size &&
+        header->source_mtime == mtime &&
+        header->section_count <= ASSET_CACHE_MAX_SECTIONS;
+    for (uint32_t i = 0; valid && i < header->section_count; ++i) {
+        valid = header->section_offsets[i] <= file->size && header->section_sizes[i] <= file->size - header->section_offsets[i];
+    }
+    if (!valid) {
+        printf("Cache %s is stale, it will be rebuilt\n", path);
+        unmap_file(file);
+        return false;
+    }
+    return true;
+}
+
+const asset_cache_header_t* asset_cache_header(const mapped_file_t* file) {
+    return (const asset_cache_header_t*)file->data;
+}
+
+asset_cache_section_t asset_cache_section(const mapped_file_t* file, int index) {
+    const asset_cache_header_t* header = asset_cache_header(file);
+    asset_cache_section_t section = { NULL, 0 };
+    if (index < (int)header->section_count) {
+        section.data = file->data + header->section_offsets[index];
+        section.size = (size_t)header->section_sizes[index];
+    }
+    return section;
+}
+
+// The cache is written beside and renamed over the old one, so a reader never maps half a file
+bool write_asset_cache(const char* source_path, asset_cache_kind_t kind, const uint32_t params[4],
+    const asset_cache_section_t* sections, int section_count) {
+    char path[1024];
+    char temp_path[1040];
+    asset_cache_header_t header = {
+        .magic = ASSET_CACHE_MAGIC,
+        .version = ASSET_CACHE_VERSION,
+        .kind = (uint32_t)kind,
+        .section_count = (uint32_t)section_count,
+    };
+    if (section_count > ASSET_CACHE_MAX_SECTIONS || !cache_path(path, sizeof(path), source_path) ||
+        !source_stamp(source_path, &header.source_size, &header.source_mtime)) {
+        return false;
+    }
+    if (params) {
+        memcpy(header.params, params, sizeof(header.params));
+    }
+    uint64_t offset = sizeof(header);
+    for (int i = 0; i < section_count; ++i) {
+        offset = (offset + ASSET_CACHE_ALIGNMENT - 1) & ~(uint64_t)(ASSET_CACHE_ALIGNMENT - 1);
+        header.section_offsets[i] = offset;
+        header.section_sizes[i] = sections[i].size;
+        offset += sections[i].size;
+    }
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "<!> Could not write the cache %s.\n", path);
+        return false;
+    }
+    static const uint8_t padding[ASSET_CACHE_ALIGNMENT] = { 0 };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t position = sizeof(header);
+    for (int i = 0; written && i < section_count; ++i) {
+        size_t pad = (size_t)(header.section_offsets[i] - position);
+        written = fwrite(padding, 1, pad, file) == pad &&
+            (sections[i].size == 0 || fwrite(sections[i].data, sections[i].size, 1, file) == 1);
+        position = header.section_offsets[i] + sections[i].size;
+    }
+    written = fclose(file) == 0 && written;
+
+    // rename() does not replace an existing file everywhere
+    remove(path);
+    if (!written || rename(temp_path, path) != 0) {
+        fprintf(stderr, "<!> Could not write the cache %s.\n", path);
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef PK_ASSET_CACHE_H
+#define PK_ASSET_CACHE_H
+
+#include "file_map.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************/
+/* Binary caches of decoded assets, "<source>.cache"   */
+/* beside every source file. A cache holds sections    */
+/* in their final in-memory layout: loading maps the   */
+/* file and points into it. It is only used while the  */
+/* size and modification time of the source match.     */
+/*******************************************************/
+
+// Bump on any change of the layout of a section
+#define ASSET_CACHE_VERSION 2
+#define ASSET_CACHE_MAX_SECTIONS 4
+
+typedef enum {
+    ASSET_CACHE_MESH = 1,       // Sections: the vertex, tex_coord, normal and face arrays
+    ASSET_CACHE_TEXTURE = 2,    // Section: the texels in their texture_format_t layout; params: width, height, format
+} asset_cache_kind_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t section_count;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t params[4];         // Meaning depends on the kind
+    uint64_t section_offsets[ASSET_CACHE_MAX_SECTIONS];
+    uint64_t section_sizes[ASSET_CACHE_MAX_SECTIONS];
+} asset_cache_header_t;
+
+typedef struct {
+    const void* data;
+    size_t size;
+} asset_cache_section_t;
+
+// Maps the cache of source_path, false (and nothing mapped) when it is missing or stale
+bool open_asset_cache(const char* source_path, asset_cache_kind_t kind, mapped_file_t* file);
+const asset_cache_header_t* asset_cache_header(const mapped_file_t* file);
+asset_cache_section_t asset_cache_section(const mapped_file_t* file, int index);
+
+bool write_asset_cache(const char* source_path, asset_cache_kind_t kind, const uint32_t params[4],
+    const asset_cache_section_t* sections, int section_count);
+
+#endif // PK_ASSET_CACHE_H
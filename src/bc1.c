@@ -0,0 +1,135 @@
+#include "bc1.h"
+
+#include <math.h>
+
+size_t bc1_size(int width, int height) {
+    return (size_t)bc1_blocks_per_row(width) * ((height + 3) >> 2) * 2 * sizeof(uint32_t);
+}
+
+// Channels are in the byte order of the texels: byte 0 goes to the top 5 bits, byte 1 gets 6 bits
+static uint32_t to_565(const int c[3]) {
+    return (uint32_t)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+static void from_565(uint32_t c, int out[3]) {
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// 4 colors between c0 and c1 when c0 > c1, else 3 and black
+static void block_palette(int palette[4][3], uint32_t c0, uint32_t c1) {
+    from_565(c0, palette[0]);
+    from_565(c1, palette[1]);
+    for (int i = 0; i < 3; ++i) {
+        if (c0 > c1) {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        } else {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+}
+
+/*******************************************************/
+/* The endpoints are the two texels furthest apart     */
+/* along the principal axis of the block colors, found */
+/* by a few power iterations on their covariance.      */
+/* Every texel then takes the nearest palette color.   */
+/*******************************************************/
+static void encode_block(uint32_t* block, const int texels[16][3]) {
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            mean[c] += texels[i][c] / 16.0f;
+        }
+    }
+    float cov[3][3] = { { 0 } };
+    for (int i = 0; i < 16; ++i) {
+        float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < 3; ++b) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+    float axis[3] = { 1, 1, 1 };
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        float next[3];
+        for (int a = 0; a < 3; ++a) {
+            next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+        }
+        float largest = fmaxf(fabsf(next[0]), fmaxf(fabsf(next[1]), fabsf(next[2])));
+        if (largest == 0) {
+            break;
+        }
+        for (int a = 0; a < 3; ++a) {
+            axis[a] = next[a] / largest;
+        }
+    }
+
+    int lowest = 0;
+    int highest = 0;
+    float low = INFINITY;
+    float high = -INFINITY;
+    for (int i = 0; i < 16; ++i) {
+        float p = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+        if (p < low) { low = p; lowest = i; }
+        if (p > high) { high = p; highest = i; }
+    }
+
+    uint32_t c0 = to_565(texels[highest]);
+    uint32_t c1 = to_565(texels[lowest]);
+    if (c0 < c1) {
+        uint32_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+    block[0] = c0 | c1 << 16;
+    block[1] = 0;
+    if (c0 == c1) {
+        // Flat block: every index is 0
+        return;
+    }
+
+    int palette[4][3];
+    block_palette(palette, c0, c1);
+    for (int i = 0; i < 16; ++i) {
+        int nearest = 0;
+        int nearest_distance = INT32_MAX;
+        for (int p = 0; p < 4; ++p) {
+            int dr = texels[i][0] - palette[p][0];
+            int dg = texels[i][1] - palette[p][1];
+            int db = texels[i][2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < nearest_distance) {
+                nearest_distance = distance;
+                nearest = p;
+            }
+        }
+        block[1] |= (uint32_t)nearest << (2 * i);
+    }
+}
+
+void bc1_encode(uint32_t* blocks, const uint32_t* pixels, int width, int height) {
+    int blocks_per_row = bc1_blocks_per_row(width);
+    int block_rows = (height + 3) >> 2;
+    for (int by = 0; by < block_rows; ++by) {
+        for (int bx = 0; bx < blocks_per_row; ++bx) {
+            int texels[16][3];
+            for (int i = 0; i < 16; ++i) {
+                int x = bx * 4 + (i & 3);
+                int y = by * 4 + (i >> 2);
+                uint32_t texel = pixels[(size_t)(y < height ? y : height - 1) * width + (x < width ? x : width - 1)];
+                texels[i][0] = texel & 0xFF;
+                texels[i][1] = (texel >> 8) & 0xFF;
+                texels[i][2] = (texel >> 16) & 0xFF;
+            }
+            encode_block(blocks + 2 * ((size_t)by * blocks_per_row + bx), texels);
+        }
+    }
+}
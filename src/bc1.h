@@ -0,0 +1,54 @@
+#ifndef PK_BC1_H
+#define PK_BC1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************/
+/* BC1 (DXT1) block compression of RGBA32 textures:    */
+/* every 4x4 texels are stored as two RGB565 colors    */
+/* and a 2-bit index per texel into the 4 colors on    */
+/* the line between them, 8 bytes per block instead    */
+/* of 64. Alpha is not kept, texels decode opaque.     */
+/* It saves memory rather than time: decoding a texel  */
+/* costs more than the texture reads it saves, even    */
+/* when the RGBA32 texels no longer fit in L2.         */
+/* Samplers decode only the texel they sample, with    */
+/* shifts and a multiply: minified textures touch a    */
+/* new block at almost every pixel, so decoding whole  */
+/* blocks or caching them costs more than it saves.    */
+/* bc1_encode() only writes 4-color blocks (c0 > c1,   */
+/* or c0 == c1 with every index 0), so the samplers    */
+/* skip the 3-color mode.                              */
+/*******************************************************/
+
+// Thirds of c1 in the color of each index, 2 bits per index: 0 (c0), 3 (c1), 1 and 2
+#define BC1_C1_THIRDS 0x9C
+
+// Partial blocks on the right and bottom edges are stored whole, padded with the edge texels
+static inline int bc1_blocks_per_row(int width) {
+    return (width + 3) >> 2;
+}
+
+size_t bc1_size(int width, int height);
+// blocks: bc1_size(width, height) bytes, 2 words per block, blocks in rows
+void bc1_encode(uint32_t* blocks, const uint32_t* pixels, int width, int height);
+
+// The 8-bit channels of an RGB565 color, the top bits repeated into the bottom ones, 21 bits apart
+static inline uint64_t bc1_spread_565(uint32_t c) {
+    uint64_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return (r << 3 | r >> 2) | (g << 2 | g >> 4) << 21 | (b << 3 | b >> 2) << 42;
+}
+
+// The RGBA32 texel (x, y): (c0 * (3 - thirds) + c1 * thirds) / 3 per channel, all 3 channels in one
+// 64-bit multiply. A channel sum is at most 765, and n * 683 >> 11 is n / 3 for n below 2046.
+static inline uint32_t bc1_fetch(const uint32_t* blocks, int blocks_per_row, int x, int y) {
+    const uint32_t* block = blocks + 2 * ((size_t)(y >> 2) * blocks_per_row + (x >> 2));
+    uint32_t index = (block[1] >> (((y & 3) << 3) | ((x & 3) << 1))) & 3;
+    uint64_t thirds = (BC1_C1_THIRDS >> (index << 1)) & 3;
+    uint64_t sum = bc1_spread_565(block[0] & 0xFFFF) * (3 - thirds) + bc1_spread_565(block[0] >> 16) * thirds;
+    uint64_t third = sum * 683;
+    return (uint32_t)((third >> 11) & 0xFF) | (uint32_t)((third >> 32) & 0xFF) << 8 | (uint32_t)((third >> 53) & 0xFF) << 16 | 0xFF000000u;
+}
+
+#endif // PK_BC1_H
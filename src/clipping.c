@@ -1,8 +1,8 @@
 #include "clipping.h"
 
 #include <math.h>
+#include <stddef.h>
 
-#define NUM_PLANES 6
 plane_t frustum_planes[NUM_PLANES];
 
 /********************************************************************/
@@ -76,7 +76,8 @@ float float_lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
 
-void clip_polygon_against_plane(polygon_t* polygon, int plane) {
+// Returns true when a vertex was outside the plane, that is when the polygon got cut or dropped
+bool clip_polygon_against_plane(polygon_t* polygon, int plane) {
     vec3_t plane_point = frustum_planes[plane].point;
     vec3_t plane_normal = frustum_planes[plane].normal;
 
@@ -90,6 +91,7 @@ void clip_polygon_against_plane(polygon_t* polygon, int plane) {
     vec3_t* previous_vertex = &polygon->vertices[polygon->num_vertices - 1];
     tex2_t* previous_texcoord = &polygon->texcoords[polygon->num_vertices - 1];
 
+    bool clipped = false;
     float current_dot = 0;
     float previous_dot = vec3_dot(vec3_sub(*previous_vertex, plane_point), plane_normal);
 
@@ -128,6 +130,8 @@ void clip_polygon_against_plane(polygon_t* polygon, int plane) {
             inside_vertices[num_inside] = vec3_clone(current_vertex);
             inside_texcoords[num_inside] = tex2_clone(current_texcoord);
             ++num_inside;
+        } else {
+            clipped = true;
         }
 
         // Iterate to the next
@@ -144,15 +148,17 @@ void clip_polygon_against_plane(polygon_t* polygon, int plane) {
         polygon->vertices[i] = vec3_clone(&inside_vertices[i]);
         polygon->texcoords[i] = tex2_clone(&inside_texcoords[i]);
     }
+    return clipped;
 }
 
-void clip_polygon(polygon_t* polygon) {
-    clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+int clip_polygon(polygon_t* polygon) {
+    int planes_hit = 0;
+    for (int plane = LEFT_FRUSTUM_PLANE; plane <= FAR_FRUSTUM_PLANE; ++plane) {
+        if (clip_polygon_against_plane(polygon, plane)) {
+            planes_hit |= 1 << plane;
+        }
+    }
+    return planes_hit;
 }
 
 void triangles_from_polygon(polygon_t* polygon, triangle_t triangles[], int* num_triangles) {
@@ -6,6 +6,7 @@
 
 #define MAX_NUM_POLYGON_VERTICES 10
 #define MAX_NUM_POLYGON_TRIANGLES 10
+#define NUM_PLANES 6
 
 enum {
     LEFT_FRUSTUM_PLANE,
@@ -29,7 +30,8 @@ typedef struct {
 
 void init_frustum_planes(float fovx, float fovy, float z_near, float z_far);
 polygon_t create_polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2);
-void clip_polygon(polygon_t* polygon);
+// Returns the planes that cut or dropped the polygon, bit (1 << plane) per frustum plane
+int clip_polygon(polygon_t* polygon);
 void triangles_from_polygon(polygon_t* polygon, triangle_t triangles[], int* num_triangles);
 
 #endif // PK_CLIPPING_H
\ No newline at end of file
@@ -10,18 +10,26 @@ void enable_vertex_point()         { draw_config |= D_VERTEX_POINT;
 void enable_solid()                { draw_config |= D_SOLID; disable_textured();                      }
 void enable_textured()             { draw_config |= D_TEXTURED; disable_solid();                      }
 void enable_backface_culling()     { draw_config |= D_BACK_FACE_CULLED;                               }
+void enable_stats_overlay()        { draw_config |= D_STATS_OVERLAY;                                  }
+void enable_overdraw()             { draw_config |= D_OVERDRAW;                                       }
 void disable_wireframe()           { draw_config &= ~D_WIREFRAME;                                     }
 void disable_vertex_point()        { draw_config &= ~D_VERTEX_POINT;                                  }
 void disable_solid()               { draw_config &= ~D_SOLID;                                         }
 void disable_textured()            { draw_config &= ~D_TEXTURED;                                      }
 void disable_backface_culling()    { draw_config &= ~D_BACK_FACE_CULLED;                              }
+void disable_stats_overlay()       { draw_config &= ~D_STATS_OVERLAY;                                 }
+void disable_overdraw()            { draw_config &= ~D_OVERDRAW;                                      }
 void toggle_wireframe()            { draw_config ^= D_WIREFRAME;                                      }
 void toggle_vertex_point()         { draw_config ^= D_VERTEX_POINT;                                   }
 void toggle_solid()                { draw_config ^= D_SOLID; disable_textured();                      }
 void toggle_textured()             { draw_config ^= D_TEXTURED; disable_solid();                      }
 void toggle_backface_culling()     { draw_config ^= D_BACK_FACE_CULLED;                               }
+void toggle_stats_overlay()        { draw_config ^= D_STATS_OVERLAY;                                  }
+void toggle_overdraw()             { draw_config ^= D_OVERDRAW;                                       }
 bool is_wireframe_enabled()        { return (draw_config & D_WIREFRAME) == D_WIREFRAME;               }
 bool is_vertex_point_enabled()     { return (draw_config & D_VERTEX_POINT) == D_VERTEX_POINT;         }
 bool is_solid_enabled()            { return (draw_config & D_SOLID) == D_SOLID;                       }
 bool is_textured_enabled()         { return (draw_config & D_TEXTURED) == D_TEXTURED;                 }
-bool is_backface_culling_enabled() { return (draw_config & D_BACK_FACE_CULLED) == D_BACK_FACE_CULLED; }
\ No newline at end of file
+bool is_backface_culling_enabled() { return (draw_config & D_BACK_FACE_CULLED) == D_BACK_FACE_CULLED; }
+bool is_stats_overlay_enabled()    { return (draw_config & D_STATS_OVERLAY) == D_STATS_OVERLAY;       }
+bool is_overdraw_enabled()         { return (draw_config & D_OVERDRAW) == D_OVERDRAW;                 }
\ No newline at end of file
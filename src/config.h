@@ -7,6 +7,8 @@ typedef enum {
     D_SOLID             = 1 << 2,
     D_TEXTURED          = 1 << 3,
     D_BACK_FACE_CULLED  = 1 << 4,
+    D_STATS_OVERLAY     = 1 << 5,
+    D_OVERDRAW          = 1 << 6,
 } draw_config_t;
 
 extern draw_config_t draw_config;
@@ -16,18 +18,26 @@ void enable_vertex_point();
 void enable_solid();
 void enable_textured();
 void enable_backface_culling();
+void enable_stats_overlay();
+void enable_overdraw();
 void disable_wireframe();
 void disable_vertex_point();
 void disable_solid();
 void disable_textured();
 void disable_backface_culling();
+void disable_stats_overlay();
+void disable_overdraw();
 void toggle_wireframe();
 void toggle_vertex_point();
 void toggle_solid();
 void toggle_textured();
 void toggle_backface_culling();
+void toggle_stats_overlay();
+void toggle_overdraw();
 bool is_wireframe_enabled();
 bool is_vertex_point_enabled();
 bool is_solid_enabled();
 bool is_textured_enabled();
-bool is_backface_culling_enabled();
\ No newline at end of file
+bool is_backface_culling_enabled();
+bool is_stats_overlay_enabled();
+bool is_overdraw_enabled();
\ No newline at end of file
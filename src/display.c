@@ -1,3 +1,11 @@
+#include "display.h"
+#include "frame_writer.h"
+#include "kernels.h"
+#include "memory.h"
+#include "stats.h"
+#include "texture.h"
+#include "trace.h"
+
 #include <SDL.h>
 
 #include <math.h>
@@ -5,19 +13,38 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 SDL_Texture* color_buffer_texture = NULL;
 uint32_t* color_buffer = NULL;
-float* z_buffer = NULL;
+uint32_t* detile_buffer = NULL;
+void* z_buffer = NULL;
+depth_format_t depth_format = DEPTH_FORMAT_F32;
+float depth_near = 0.1f;
+framebuffer_layout_t framebuffer_layout = FRAMEBUFFER_LINEAR;
+int frame_buffer_count = 1;
+bool zero_copy = false;
+bool headless = false;
+const char* frame_output_path = NULL;
+int buffer_stride = 0;
 
-const int win_width = 1920 / 4;
-const int win_height = 1080 / 4;
+int win_width = 1920 / 4;
+int win_height = 1080 / 4;
 int WINDOW_INDEX = 0;
 
 bool initialize_window() {
 
+    // Offscreen: no window and no video subsystem, frames only go to files
+    if (headless) {
+        if (SDL_Init(SDL_INIT_TIMER) != 0) {
+            fprintf(stderr, "SDL could not be initialized!\n");
+            return false;
+        }
+        return true;
+    }
+
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "SDL could not be initialized!\n");
         return false;
@@ -47,13 +74,6 @@ bool initialize_window() {
         return false;
     }
 
-    // Initialize SDL Renderer
-    renderer = SDL_CreateRenderer(window, -1, 0);
-    if (!renderer) {
-        fprintf(stderr, "<!> Could not create renderer.\n");
-        return false;
-    }
-
     // SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
 
     return true;
@@ -64,7 +84,7 @@ void draw_pixel(int x, int y, uint32_t color) {
         //fprintf(stderr, "Can not set pixel at (x=%d, y=%d)\n", x, y);
         return;
     }
-    color_buffer[y * win_width + x] = color;
+    color_buffer[pixel_index(x, y)] = color;
 }
 
 void draw_grid(int cell_width, int cell_height) {
@@ -79,7 +99,7 @@ void draw_grid(int cell_width, int cell_height) {
             uint32_t r = (uint32_t)(0x000000FF * ((x / (float)win_width))) << 16;
             uint32_t g = (uint32_t)(0x000000FF * (y / (float)win_height)) << 8;
             uint32_t b = (0x00000000);
-            color_buffer[i] = a | r | g | b;
+            color_buffer[pixel_index(x, y)] = a | r | g | b;
         }
     } 
 }
@@ -119,44 +139,570 @@ void draw_line(int x0, int y0, int x1, int y1, uint32_t color) {
     }
 }
 
-void render_color_buffer() {
-    SDL_UpdateTexture(
-        color_buffer_texture,
-        NULL,
-        color_buffer,
-        (int)(win_width * sizeof(uint32_t))
+static void clear_color_pixels(uint32_t* pixels, uint32_t color) {
+    if (framebuffer_layout == FRAMEBUFFER_TILED) {
+        // Same pattern, one tile row at a time (the padding past win_width is cleared too)
+        for (int y = 0; y < win_height; ++y) {
+            uint32_t row_color = y % 10 == 0 ? 0xFF333333 : color;
+            for (int x = 0; x < win_width; x += TILE_SIZE) {
+                kernels.fill_u32(pixels + pixel_index(x, y), row_color, TILE_SIZE);
+            }
+            for (int x = 0; x < win_width; x += 10) {
+                pixels[pixel_index(x, y)] = 0xFF333333;
+            }
+        }
+        return;
+    }
+    for (size_t y = 0; y < win_height; ++y) {
+        uint32_t* row = pixels + y * buffer_stride;
+        if (y % 10 == 0) {
+            kernels.fill_u32(row, 0xFF333333, win_width);
+            continue;
+        }
+        kernels.fill_u32(row, color, win_width);
+        for (size_t x = 0; x < win_width; x += 10) {
+            row[x] = 0xFF333333;
+        }
+    }
+}
+
+static void clear_depth_values(void* depth) {
+    if (depth_format != DEPTH_FORMAT_F32) {
+        // The far value of the integer formats is all bits set
+        memset(depth, 0xFF, framebuffer_pixel_count() * depth_format_size(depth_format));
+        return;
+    }
+    // Bit pattern of 1.0f
+    kernels.fill_u32((uint32_t*)depth, 0x3F800000, framebuffer_pixel_count());
+}
+
+/*******************************************************/
+/* Frame buffers. The main thread presents every frame */
+/* itself, SDL's render API belongs to it. With more   */
+/* than one set, the renderer goes on in a cleared set */
+/* right after the present while the clear worker      */
+/* clears the set just shown: only the clear leaves    */
+/* the render path, the upload and present stay on it. */
+/* With a single set the clear runs on the main thread */
+/* too, which is why one set is the default.           */
+/*                                                     */
+/* In zero-copy mode a linear set renders straight     */
+/* into its own streaming texture, kept locked while   */
+/* it is drawn; a tiled set is detiled straight into   */
+/* the locked texture. Either way SDL_UpdateTexture    */
+/* and its full frame copy go away.                    */
+/*******************************************************/
+typedef struct {
+    uint32_t* color;        // Owned buffer, or the locked pixels of texture
+    void* depth;
+    SDL_Texture* texture;   // Zero-copy linear sets only
+    uint32_t clear_color;   // Color to clear to once presented
+    bool cleared;           // False until the set is cleared the first time
+    uint64_t present_ticks; // Time the last present of the set took, and its clear
+    uint64_t clear_ticks;
+} frame_buffer_t;
+
+// Fixed size FIFO of frame buffer indices
+typedef struct {
+    int items[MAX_FRAME_BUFFERS];
+    int head;
+    int count;
+} frame_queue_t;
+
+static frame_buffer_t frame_buffers[MAX_FRAME_BUFFERS];
+static int current_frame_buffer = 0;
+
+static frame_queue_t clear_queue;   // Presented, waiting to be cleared by the worker
+static frame_queue_t free_queue;    // Cleared, waiting to be rendered into
+static SDL_mutex* clear_mutex = NULL;
+static SDL_cond* clear_cond = NULL;
+static SDL_Thread* clear_thread = NULL;
+static bool clear_quit = false;
+
+static void frame_queue_push(frame_queue_t* queue, int item) {
+    queue->items[(queue->head + queue->count) % MAX_FRAME_BUFFERS] = item;
+    queue->count++;
+}
+
+static int frame_queue_pop(frame_queue_t* queue) {
+    int item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % MAX_FRAME_BUFFERS;
+    queue->count--;
+    return item;
+}
+
+static bool renders_into_texture() {
+    return zero_copy && !headless && framebuffer_layout == FRAMEBUFFER_LINEAR;
+}
+
+static SDL_Texture* create_color_texture() {
+    SDL_Texture* texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_RGBA32,
+        SDL_TEXTUREACCESS_STREAMING,
+        win_width,
+        win_height
     );
+    if (!texture) {
+        fprintf(stderr, "<!> Could not allocate the color buffer texture.\n");
+    }
+    return texture;
+}
+
+// Points the color buffer of a set at its locked texture, all sets and the z-buffers share the pitch
+static bool lock_frame_texture(frame_buffer_t* frame) {
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(frame->texture, NULL, &pixels, &pitch) != 0) {
+        fprintf(stderr, "<!> Could not lock the color buffer texture: %s\n", SDL_GetError());
+        return false;
+    }
+    if (buffer_stride == 0 && pitch % sizeof(uint32_t) == 0) {
+        buffer_stride = pitch / sizeof(uint32_t);
+    }
+    if (pitch != buffer_stride * (int)sizeof(uint32_t)) {
+        fprintf(stderr, "<!> Unsupported color buffer texture pitch %d.\n", pitch);
+        SDL_UnlockTexture(frame->texture);
+        return false;
+    }
+    frame->color = (uint32_t*)pixels;
+    return true;
+}
+
+static bool create_renderer() {
+    if (headless) {
+        return true;
+    }
+
+    renderer = SDL_CreateRenderer(window, -1, 0);
+    if (!renderer) {
+        fprintf(stderr, "<!> Could not create renderer.\n");
+        return false;
+    }
+
+    if (!renders_into_texture()) {
+        color_buffer_texture = create_color_texture();
+        return color_buffer_texture != NULL;
+    }
+
+    // Zero-copy linear sets have a streaming texture each and render into it
+    for (int i = 0; i < frame_buffer_count; ++i) {
+        frame_buffers[i].texture = create_color_texture();
+        if (!frame_buffers[i].texture || !lock_frame_texture(&frame_buffers[i])) {
+            return false;
+        }
+        // Locked pixels start undefined, match a freshly allocated buffer
+        memset(frame_buffers[i].color, 0, (size_t)buffer_stride * win_height * sizeof(uint32_t));
+    }
+    return true;
+}
+
+static void destroy_renderer() {
+    for (int i = 0; i < MAX_FRAME_BUFFERS; ++i) {
+        if (frame_buffers[i].texture) {
+            SDL_DestroyTexture(frame_buffers[i].texture);
+            frame_buffers[i].texture = NULL;
+            // Locked pixels are gone with their texture
+            frame_buffers[i].color = NULL;
+        }
+    }
+    if (color_buffer_texture) {
+        SDL_DestroyTexture(color_buffer_texture);
+        color_buffer_texture = NULL;
+    }
+    if (renderer) {
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+    }
+}
+
+// Headless present: writes the frame when an output path is set
+static bool write_pixels(const uint32_t* pixels) {
+    static int frame_number = 0;
+    int number = frame_number++;
+    if (frame_output_path == NULL) {
+        return true;
+    }
+
+    int stride = buffer_stride;
+    if (framebuffer_layout == FRAMEBUFFER_TILED) {
+        kernels.detile_u32(detile_buffer, win_width, pixels, win_width, win_height);
+        pixels = detile_buffer;
+        stride = win_width;
+    }
+
+    char path[1024];
+    frame_format_t format;
+    if (!format_frame_path(path, sizeof(path), frame_output_path, number)) {
+        fprintf(stderr, "<!> Frame output path is too long: %s\n", frame_output_path);
+        return false;
+    }
+    if (!frame_format_from_path(path, &format)) {
+        fprintf(stderr, "<!> Unknown frame output format: %s\n", path);
+        return false;
+    }
+    return write_frame(path, format, pixels, win_width, win_height, stride);
+}
+
+static bool present_pixels(const uint32_t* pixels) {
+    if (headless) {
+        return write_pixels(pixels);
+    }
+    if (framebuffer_layout == FRAMEBUFFER_TILED && zero_copy) {
+        void* texture_pixels;
+        int pitch;
+        if (SDL_LockTexture(color_buffer_texture, NULL, &texture_pixels, &pitch) != 0) {
+            fprintf(stderr, "<!> Could not lock the color buffer texture: %s\n", SDL_GetError());
+            return false;
+        }
+        kernels.detile_u32(texture_pixels, pitch / sizeof(uint32_t), pixels, win_width, win_height);
+        SDL_UnlockTexture(color_buffer_texture);
+    } else if (framebuffer_layout == FRAMEBUFFER_TILED) {
+        kernels.detile_u32(detile_buffer, win_width, pixels, win_width, win_height);
+        SDL_UpdateTexture(color_buffer_texture, NULL, detile_buffer, (int)(win_width * sizeof(uint32_t)));
+    } else {
+        SDL_UpdateTexture(color_buffer_texture, NULL, pixels, (int)(buffer_stride * sizeof(uint32_t)));
+    }
     SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL);
     SDL_RenderPresent(renderer);
+    return true;
+}
+
+// Main thread: shows a rendered set, or writes it out when headless
+static bool show_frame_buffer(frame_buffer_t* frame) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (frame->texture) {
+        SDL_UnlockTexture(frame->texture);
+        SDL_RenderCopy(renderer, frame->texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        if (!lock_frame_texture(frame)) {
+            frame->color = NULL;
+            return false;
+        }
+    } else if (!present_pixels(frame->color)) {
+        return false;
+    }
+    uint64_t end = SDL_GetPerformanceCounter();
+    frame->present_ticks = end - start;
+    if (trace_enabled) {
+        trace_record("present", start, end);
+    }
+    return true;
+}
+
+// Leaves a shown set ready to be rendered into again, on whichever thread has it
+static void clear_frame_buffer(frame_buffer_t* frame) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    clear_color_pixels(frame->color, frame->clear_color);
+    clear_depth_values(frame->depth);
+    frame->cleared = true;
+    uint64_t end = SDL_GetPerformanceCounter();
+    frame->clear_ticks = end - start;
+    if (trace_enabled) {
+        trace_record("clear", start, end);
+    }
+}
+
+// The stage times of a set are accounted by the render thread once it gets the set back
+static void add_frame_buffer_stats(frame_buffer_t* frame) {
+    frame_stats.stage_ticks[STAGE_PRESENT] += frame->present_ticks;
+    frame_stats.stage_ticks[STAGE_CLEAR] += frame->clear_ticks;
+    frame->present_ticks = 0;
+    frame->clear_ticks = 0;
+}
+
+static int clear_thread_main(void* data) {
+    trace_thread_name("clear");
+
+    SDL_LockMutex(clear_mutex);
+    for (;;) {
+        while (clear_queue.count == 0 && !clear_quit) {
+            SDL_CondWait(clear_cond, clear_mutex);
+        }
+        // Queued sets are still cleared after a quit request
+        if (clear_queue.count == 0) {
+            break;
+        }
+        frame_buffer_t* frame = &frame_buffers[frame_queue_pop(&clear_queue)];
+        SDL_UnlockMutex(clear_mutex);
+
+        clear_frame_buffer(frame);
+
+        SDL_LockMutex(clear_mutex);
+        frame_queue_push(&free_queue, (int)(frame - frame_buffers));
+        SDL_CondBroadcast(clear_cond);
+    }
+    SDL_UnlockMutex(clear_mutex);
+    return 0;
+}
+
+bool create_frame_buffers() {
+    // Zero-copy sets take the row pitch of the locked texture, known once the renderer exists
+    buffer_stride = renders_into_texture() ? 0 : win_width;
+
+    if (!renders_into_texture()) {
+        // The buffers are padded so the vector span shaders can run past the last pixel
+        for (int i = 0; i < frame_buffer_count; ++i) {
+            frame_buffers[i].color = (uint32_t*)memory_calloc(MEMORY_FRAME_BUFFERS, framebuffer_pixel_count() + KERNELS_MAX_LANES, sizeof(uint32_t));
+            if (!frame_buffers[i].color) {
+                fprintf(stderr, "<!> Could not allocate the color buffer.\n");
+                return false;
+            }
+        }
+    }
+
+    // The tiled color buffer is turned back into rows here before every present
+    if (framebuffer_layout == FRAMEBUFFER_TILED && (!zero_copy || headless)) {
+        detile_buffer = (uint32_t*)memory_alloc(MEMORY_FRAME_BUFFERS, (size_t)win_width * win_height * sizeof(uint32_t));
+        if (!detile_buffer) {
+            fprintf(stderr, "<!> Could not allocate the detile buffer.\n");
+            return false;
+        }
+    }
+
+    if (!create_renderer()) {
+        return false;
+    }
+    if (frame_buffer_count > 1) {
+        clear_mutex = SDL_CreateMutex();
+        clear_cond = SDL_CreateCond();
+        clear_thread = SDL_CreateThread(clear_thread_main, "clear", NULL);
+        if (!clear_thread) {
+            fprintf(stderr, "<!> Could not create the clear thread: %s\n", SDL_GetError());
+            return false;
+        }
+    }
+
+    // Vector span shaders write the color buffer through masked stores only, the
+    // z-buffer is read past the end too and stays padded
+    for (int i = 0; i < frame_buffer_count; ++i) {
+        frame_buffers[i].depth = memory_calloc(MEMORY_FRAME_BUFFERS, framebuffer_pixel_count() + KERNELS_MAX_LANES, depth_format_size(depth_format));
+        if (!frame_buffers[i].depth) {
+            fprintf(stderr, "<!> Could not allocate the z-buffer.\n");
+            return false;
+        }
+        clear_depth_values(frame_buffers[i].depth);
+        if (i > 0) {
+            frame_queue_push(&free_queue, i);
+        }
+    }
+    current_frame_buffer = 0;
+    color_buffer = frame_buffers[0].color;
+    z_buffer = frame_buffers[0].depth;
+    return true;
+}
+
+/*******************************************************/
+/* Present the rendered frame and continue in a        */
+/* cleared set. With a clear worker the set just shown */
+/* is handed to it; this blocks only when every other  */
+/* set is still waiting for its clear. Returns false   */
+/* once a set could not be presented.                  */
+/*******************************************************/
+bool present_frame(uint32_t clear_color) {
+    frame_buffer_t* frame = &frame_buffers[current_frame_buffer];
+    frame->clear_color = clear_color;
+    if (!show_frame_buffer(frame)) {
+        return false;
+    }
+
+    if (!clear_thread) {
+        clear_frame_buffer(frame);
+        add_frame_buffer_stats(frame);
+        color_buffer = frame->color;
+        return true;
+    }
+
+    SDL_LockMutex(clear_mutex);
+    frame_queue_push(&clear_queue, current_frame_buffer);
+    SDL_CondBroadcast(clear_cond);
+    while (free_queue.count == 0) {
+        SDL_CondWait(clear_cond, clear_mutex);
+    }
+    current_frame_buffer = frame_queue_pop(&free_queue);
+    SDL_UnlockMutex(clear_mutex);
+
+    // The present ticks of the set just shown are accounted when it comes back, with its clear
+    frame = &frame_buffers[current_frame_buffer];
+    add_frame_buffer_stats(frame);
+    if (!frame->cleared) {
+        clear_color_pixels(frame->color, clear_color);
+        frame->cleared = true;
+    }
+    color_buffer = frame->color;
+    z_buffer = frame->depth;
+    return true;
+}
+
+// Waits until every presented set is cleared, and accounts their stage times
+void flush_frames() {
+    if (!clear_thread) {
+        return;
+    }
+    SDL_LockMutex(clear_mutex);
+    // Every set but the current one is back once the clear worker is idle
+    while (free_queue.count < frame_buffer_count - 1) {
+        SDL_CondWait(clear_cond, clear_mutex);
+    }
+    for (int i = 0; i < free_queue.count; ++i) {
+        add_frame_buffer_stats(&frame_buffers[free_queue.items[(free_queue.head + i) % MAX_FRAME_BUFFERS]]);
+    }
+    SDL_UnlockMutex(clear_mutex);
+}
+
+static void stop_clear_thread() {
+    if (!clear_thread) {
+        return;
+    }
+    SDL_LockMutex(clear_mutex);
+    clear_quit = true;
+    SDL_CondBroadcast(clear_cond);
+    SDL_UnlockMutex(clear_mutex);
+    SDL_WaitThread(clear_thread, NULL);
+    clear_thread = NULL;
+}
+
+void destroy_frame_buffers() {
+    for (int i = 0; i < MAX_FRAME_BUFFERS; ++i) {
+        // Texture pixels belong to SDL and are gone with the renderer
+        if (!renders_into_texture()) {
+            memory_free(frame_buffers[i].color);
+        }
+        memory_free(frame_buffers[i].depth);
+        frame_buffers[i].color = NULL;
+        frame_buffers[i].depth = NULL;
+    }
+    color_buffer = NULL;
+    z_buffer = NULL;
+    memory_free(detile_buffer);
+    detile_buffer = NULL;
+}
+
+void render_color_buffer() {
+    present_pixels(color_buffer);
 }
 
 void clear_color_buffer(uint32_t color) {
     if (color_buffer == NULL) {
         return;
     }
-    for (size_t x = 0; x < win_width; ++x) {
-        for (size_t y = 0; y < win_height; ++y) {
-            size_t i = y * win_width + x;
-            color_buffer[i] = color;
-            if (x % 10 == 0 || y % 10 == 0) {
-                color_buffer[i] = 0xFF333333;
-            }
-        }
-    } 
+    clear_color_pixels(color_buffer, color);
 }
 
 void clear_z_buffer() {
     if (z_buffer == NULL) {
         return;
     }
-    for (size_t i = 0; i < win_width * win_height; ++i) {
-        z_buffer[i] = 1.0;
-    } 
+    clear_depth_values(z_buffer);
+}
+
+
+size_t depth_format_size(depth_format_t format) {
+    switch (format) {
+        case DEPTH_FORMAT_U16: return 2;
+        case DEPTH_FORMAT_U24: return 3;
+        default:               return 4;
+    }
+}
+
+const char* depth_format_name(depth_format_t format) {
+    switch (format) {
+        case DEPTH_FORMAT_U16: return "u16";
+        case DEPTH_FORMAT_U24: return "u24";
+        default:               return "f32";
+    }
+}
+
+bool parse_depth_format(const char* name, depth_format_t* format) {
+    if (strcmp(name, "f32") == 0) { *format = DEPTH_FORMAT_F32; return true; }
+    if (strcmp(name, "u24") == 0) { *format = DEPTH_FORMAT_U24; return true; }
+    if (strcmp(name, "u16") == 0) { *format = DEPTH_FORMAT_U16; return true; }
+    return false;
+}
+
+size_t framebuffer_pixel_count() {
+    if (framebuffer_layout == FRAMEBUFFER_LINEAR) {
+        return (size_t)buffer_stride * win_height;
+    }
+    // Partial tiles on the right and bottom edges are stored whole
+    size_t tiles_x = (win_width + TILE_MASK) >> TILE_SHIFT;
+    size_t tiles_y = (win_height + TILE_MASK) >> TILE_SHIFT;
+    return tiles_x * tiles_y * TILE_PIXELS;
+}
+
+const char* framebuffer_layout_name(framebuffer_layout_t layout) {
+    switch (layout) {
+        case FRAMEBUFFER_TILED: return "tiled";
+        default:                return "linear";
+    }
+}
+
+bool parse_framebuffer_layout(const char* name, framebuffer_layout_t* layout) {
+    if (strcmp(name, "linear") == 0) { *layout = FRAMEBUFFER_LINEAR; return true; }
+    if (strcmp(name, "tiled") == 0) { *layout = FRAMEBUFFER_TILED; return true; }
+    return false;
+}
+
+/*******************************************************/
+/* Command line options of the display, shared by the  */
+/* executables. Returns false for arguments that are   */
+/* not display options; *valid tells whether the value */
+/* of a display option could be used.                  */
+/*******************************************************/
+bool parse_display_argument(const char* arg, bool* valid) {
+    *valid = true;
+    // * "--depth=f32|u24|u16" selects the z-buffer format
+    if (strncmp(arg, "--depth=", 8) == 0) {
+        *valid = parse_depth_format(arg + 8, &depth_format);
+        if (!*valid) {
+            fprintf(stderr, "<!> Unknown depth format '%s' (expected f32, u24 or u16).\n", arg + 8);
+        }
+        return true;
+    }
+    // * "--texture-format=rgba32|bc1|palette" stores the textures as they are, BC1 compressed or palettized
+    if (strncmp(arg, "--texture-format=", 17) == 0) {
+        *valid = parse_texture_format(arg + 17, &texture_format);
+        if (!*valid) {
+            fprintf(stderr, "<!> Unknown texture format '%s' (expected rgba32, bc1 or palette).\n", arg + 17);
+        }
+        return true;
+    }
+    // * "--layout=linear|tiled" selects the color and z-buffer memory layout
+    if (strncmp(arg, "--layout=", 9) == 0) {
+        *valid = parse_framebuffer_layout(arg + 9, &framebuffer_layout);
+        if (!*valid) {
+            fprintf(stderr, "<!> Unknown framebuffer layout '%s' (expected linear or tiled).\n", arg + 9);
+        }
+        return true;
+    }
+    // * "--buffers=1|2|3" sets the number of frame buffers (default 1), above 1 a worker thread clears them
+    if (strncmp(arg, "--buffers=", 10) == 0) {
+        char* end;
+        long count = strtol(arg + 10, &end, 10);
+        if (*end != '\0' || count < 1 || count > MAX_FRAME_BUFFERS) {
+            fprintf(stderr, "<!> Invalid frame buffer count '%s' (expected 1 to %d).\n", arg + 10, MAX_FRAME_BUFFERS);
+            *valid = false;
+        } else {
+            frame_buffer_count = (int)count;
+        }
+        return true;
+    }
+    // * "--zero-copy" renders straight into the locked SDL texture
+    if (strcmp(arg, "--zero-copy") == 0) {
+        zero_copy = true;
+        return true;
+    }
+    return false;
 }
 
 void destroy_window() {
-    SDL_DestroyTexture(color_buffer_texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    stop_clear_thread();
+    destroy_renderer();
+    SDL_DestroyCond(clear_cond);
+    SDL_DestroyMutex(clear_mutex);
+    if (window) {
+        SDL_DestroyWindow(window);
+        window = NULL;
+    }
     SDL_Quit();
 }
@@ -4,29 +4,85 @@
 #include <SDL.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define FPS 144
 #define FRAME_TARGET_TIME (1000 / FPS)
 
+typedef enum {
+    DEPTH_FORMAT_F32, // 32-bit float holding 1 - 1/w
+    DEPTH_FORMAT_U24, // 24-bit unsigned normalized, packed in 3 bytes
+    DEPTH_FORMAT_U16, // 16-bit unsigned normalized
+    DEPTH_FORMAT_COUNT,
+} depth_format_t;
+
+typedef enum {
+    FRAMEBUFFER_LINEAR, // Row-major pixels
+    FRAMEBUFFER_TILED,  // Row-major 8x8 tiles, row-major pixels within a tile
+} framebuffer_layout_t;
+
+#define TILE_SHIFT 3
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+
+// Color and z buffer sets cycled between the renderer and the clear worker
+#define MAX_FRAME_BUFFERS 3
+
 extern SDL_Window* window;
 extern SDL_Renderer* renderer;
 extern SDL_Texture* color_buffer_texture;
 extern uint32_t* color_buffer;
-extern float* z_buffer;
+extern uint32_t* detile_buffer;
+extern void* z_buffer;
+extern depth_format_t depth_format;
+extern float depth_near;
+extern framebuffer_layout_t framebuffer_layout;
+extern int frame_buffer_count;
+extern bool zero_copy;
+extern bool headless;                   // No window: frames are written to frame_output_path, if set
+extern const char* frame_output_path;   // "%d" or "%0Nd" is replaced by the frame number
+extern int buffer_stride;       // Pixels per row of the linear color and z buffers, set by create_frame_buffers()
 
 extern int win_width;
 extern int win_height;
 extern int WINDOW_INDEX;
 
+/*******************************************************/
+/* Offset of pixel (x, y) in the color and z buffers.  */
+/* The tiled layout keeps every 8x8 block in 64        */
+/* consecutive pixels, so a triangle touches a few     */
+/* cache lines per block instead of one per row.       */
+/*******************************************************/
+static inline int pixel_index(int x, int y) {
+    if (framebuffer_layout == FRAMEBUFFER_LINEAR) {
+        return y * buffer_stride + x;
+    }
+    int tiles_x = (win_width + TILE_MASK) >> TILE_SHIFT;
+    int tile = (y >> TILE_SHIFT) * tiles_x + (x >> TILE_SHIFT);
+    return tile * TILE_PIXELS + ((y & TILE_MASK) << TILE_SHIFT) + (x & TILE_MASK);
+}
+
 bool initialize_window();
 void draw_pixel(int x, int y, uint32_t color);
 void draw_grid(int cell_width, int cell_height);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color);
+bool create_frame_buffers();
+bool present_frame(uint32_t clear_color);
+void flush_frames();
+void destroy_frame_buffers();
 void render_color_buffer();
 void clear_color_buffer(uint32_t color);
 void clear_z_buffer();
+size_t depth_format_size(depth_format_t format);
+const char* depth_format_name(depth_format_t format);
+bool parse_depth_format(const char* name, depth_format_t* format);
+size_t framebuffer_pixel_count();
+const char* framebuffer_layout_name(framebuffer_layout_t layout);
+bool parse_framebuffer_layout(const char* name, framebuffer_layout_t* layout);
+bool parse_display_argument(const char* arg, bool* valid);
 void destroy_window();
 
 #endif // PK_DISPLAY_H
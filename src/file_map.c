@@ -0,0 +1,106 @@
+#include "file_map.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+bool map_file(const char* path, mapped_file_t* file) {
+    memset(file, 0, sizeof(*file));
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "<!> Could not open the file '%s'.\n", path);
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        fprintf(stderr, "<!> Could not read the size of '%s'.\n", path);
+        CloseHandle(handle);
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    file->file = handle;
+    if (file->size == 0) {
+        return true;
+    }
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) {
+        fprintf(stderr, "<!> Could not map the file '%s'.\n", path);
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+        memset(file, 0, sizeof(*file));
+        return false;
+    }
+    file->mapping = mapping;
+    file->data = (const uint8_t*)data;
+    return true;
+}
+
+void unmap_file(mapped_file_t* file) {
+    if (file->data) {
+        UnmapViewOfFile(file->data);
+    }
+    if (file->mapping) {
+        CloseHandle(file->mapping);
+    }
+    if (file->file) {
+        CloseHandle(file->file);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+#else
+
+bool map_file(const char* path, mapped_file_t* file) {
+    memset(file, 0, sizeof(*file));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "<!> Could not open the file '%s'.\n", path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        fprintf(stderr, "<!> Could not read the size of '%s'.\n", path);
+        close(fd);
+        return false;
+    }
+    file->size = (size_t)info.st_size;
+    if (file->size == 0) {
+        close(fd);
+        return true;
+    }
+    // The mapping stays valid once the descriptor is closed
+    void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "<!> Could not map the file '%s'.\n", path);
+        file->size = 0;
+        return false;
+    }
+    // The whole file is about to be read, by several threads at once
+    madvise(data, file->size, MADV_WILLNEED);
+    file->data = (const uint8_t*)data;
+    return true;
+}
+
+void unmap_file(mapped_file_t* file) {
+    if (file->data) {
+        munmap((void*)file->data, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef PK_FILE_MAP_H
+#define PK_FILE_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole file mapped read-only into memory
+typedef struct {
+    const uint8_t* data;    // NULL for an empty file
+    size_t size;
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#endif
+} mapped_file_t;
+
+bool map_file(const char* path, mapped_file_t* file);
+void unmap_file(mapped_file_t* file);
+
+#endif // PK_FILE_MAP_H
@@ -0,0 +1,320 @@
+#include "frame_writer.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+bool frame_format_from_path(const char* path, frame_format_t* format) {
+    const char* extension = strrchr(path, '.');
+    if (extension == NULL) {
+        return false;
+    }
+    if (strcmp(extension, ".ppm") == 0) { *format = FRAME_FORMAT_PPM; return true; }
+    if (strcmp(extension, ".png") == 0) { *format = FRAME_FORMAT_PNG; return true; }
+    if (strcmp(extension, ".raw") == 0) { *format = FRAME_FORMAT_RAW; return true; }
+    return false;
+}
+
+bool format_frame_path(char* path, size_t size, const char* pattern, int frame) {
+    const char* percent = strchr(pattern, '%');
+    const char* conversion = percent ? percent + 1 : NULL;
+    int width = 0;
+    if (conversion) {
+        while (*conversion >= '0' && *conversion <= '9') {
+            width = width * 10 + (*conversion++ - '0');
+        }
+    }
+    if (conversion == NULL || *conversion != 'd') {
+        // No frame number: every frame goes to the same file
+        return snprintf(path, size, "%s", pattern) < (int)size;
+    }
+    int written = snprintf(path, size, "%.*s%0*d%s", (int)(percent - pattern), pattern, width, frame, conversion + 1);
+    return written >= 0 && written < (int)size;
+}
+
+static bool write_ppm(FILE* file, const uint32_t* pixels, int width, int height, int stride) {
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = (const uint8_t*)(pixels + (size_t)y * stride);
+        for (int x = 0; x < width; ++x) {
+            fwrite(row + x * 4, 1, 3, file);
+        }
+    }
+    return !ferror(file);
+}
+
+static bool write_raw(FILE* file, const uint32_t* pixels, int width, int height, int stride) {
+    for (int y = 0; y < height; ++y) {
+        fwrite(pixels + (size_t)y * stride, sizeof(uint32_t), width, file);
+    }
+    return !ferror(file);
+}
+
+/*******************************************************/
+/* PNG with a small compressor of its own: one deflate */
+/* block of fixed Huffman codes, where the only back   */
+/* references tried are the previous pixel and the one */
+/* above. Rendered frames are mostly flat runs, which  */
+/* this shrinks about as well as a general deflater.   */
+/*******************************************************/
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_DISTANCE 32768
+
+typedef struct {
+    FILE* file;
+    uint32_t crc;           // CRC-32 of the current chunk type and data
+} png_writer_t;
+
+typedef struct {
+    uint8_t* out;
+    size_t size;
+    uint64_t bits;          // Pending bits, the first one in bit 0
+    int count;
+} bit_writer_t;
+
+static uint32_t crc_table[256];
+
+// Kept between frames so writing one does not allocate once the first was written
+static uint8_t* png_rows = NULL;
+static uint8_t* png_stream = NULL;
+static size_t png_rows_capacity = 0;
+static size_t png_stream_capacity = 0;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577,
+};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static void init_crc_table() {
+    if (crc_table[1] != 0) {
+        return;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static bool reserve(uint8_t** buffer, size_t* capacity, size_t size) {
+    if (size <= *capacity) {
+        return true;
+    }
+    uint8_t* grown = memory_realloc(MEMORY_FRAME_BUFFERS, *buffer, size);
+    if (grown == NULL) {
+        return false;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return true;
+}
+
+static void png_put(png_writer_t* png, uint8_t byte) {
+    fputc(byte, png->file);
+    png->crc = crc_table[(png->crc ^ byte) & 0xFF] ^ (png->crc >> 8);
+}
+
+static void png_put_u32(png_writer_t* png, uint32_t value) {
+    png_put(png, value >> 24);
+    png_put(png, value >> 16);
+    png_put(png, value >> 8);
+    png_put(png, value);
+}
+
+static void png_begin_chunk(png_writer_t* png, const char* type, uint32_t length) {
+    // The length is not covered by the CRC
+    uint8_t bytes[4] = { length >> 24, length >> 16, length >> 8, length };
+    fwrite(bytes, 1, 4, png->file);
+    png->crc = 0xFFFFFFFFu;
+    for (int i = 0; i < 4; ++i) {
+        png_put(png, type[i]);
+    }
+}
+
+static void png_end_chunk(png_writer_t* png) {
+    uint32_t crc = png->crc ^ 0xFFFFFFFFu;
+    uint8_t bytes[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+    fwrite(bytes, 1, 4, png->file);
+}
+
+static void put_bits(bit_writer_t* writer, uint32_t value, int count) {
+    writer->bits |= (uint64_t)value << writer->count;
+    writer->count += count;
+    while (writer->count >= 8) {
+        writer->out[writer->size++] = (uint8_t)writer->bits;
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+// Huffman codes go out from their top bit, the other fields from their bottom one
+static void put_code(bit_writer_t* writer, uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i) {
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    put_bits(writer, reversed, length);
+}
+
+// A literal byte or a length symbol (256-287) of the fixed code
+static void put_symbol(bit_writer_t* writer, int symbol) {
+    if (symbol < 144) {
+        put_code(writer, 0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_code(writer, 0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        put_code(writer, symbol - 256, 7);
+    } else {
+        put_code(writer, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer_t* writer, int length, int distance) {
+    int code = 28;
+    while (length_base[code] > length) {
+        --code;
+    }
+    put_symbol(writer, 257 + code);
+    put_bits(writer, length - length_base[code], length_extra[code]);
+    code = 29;
+    while (distance_base[code] > distance) {
+        --code;
+    }
+    put_code(writer, code, 5);
+    put_bits(writer, distance - distance_base[code], distance_extra[code]);
+}
+
+static int match_length(const uint8_t* data, size_t size, size_t i, size_t distance) {
+    if (distance > i || distance > DEFLATE_MAX_DISTANCE) {
+        return 0;
+    }
+    size_t limit = size - i < DEFLATE_MAX_MATCH ? size - i : DEFLATE_MAX_MATCH;
+    size_t length = 0;
+    while (length < limit && data[i + length] == data[i + length - distance]) {
+        ++length;
+    }
+    return (int)length;
+}
+
+// zlib stream of data into png_stream, false when it can not be allocated
+static bool deflate_rows(const uint8_t* data, size_t size, size_t row_size, size_t* stream_size) {
+    // Literals take at most 9 bits, plus the zlib header, the block end and the Adler-32
+    if (!reserve(&png_stream, &png_stream_capacity, size + size / 8 + 16)) {
+        return false;
+    }
+    bit_writer_t writer = { .out = png_stream };
+    writer.out[writer.size++] = 0x78; // zlib header: deflate, 32K window, no dictionary
+    writer.out[writer.size++] = 0x01;
+    put_bits(&writer, 1, 1);          // BFINAL
+    put_bits(&writer, 1, 2);          // BTYPE = 01 (fixed Huffman codes)
+
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (size_t i = 0; i < size; ++i) {
+        adler_a = (adler_a + data[i]) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+
+    for (size_t i = 0; i < size;) {
+        int left = match_length(data, size, i, 3);
+        int up = match_length(data, size, i, row_size);
+        if (left >= 3 || up >= 3) {
+            int length = left >= up ? left : up;
+            put_match(&writer, length, left >= up ? 3 : (int)row_size);
+            i += length;
+        } else {
+            put_symbol(&writer, data[i++]);
+        }
+    }
+    put_symbol(&writer, 256);
+    put_bits(&writer, 0, 7);          // Flush the last byte
+
+    uint32_t adler = (adler_b << 16) | adler_a;
+    for (int i = 3; i >= 0; --i) {
+        writer.out[writer.size++] = (uint8_t)(adler >> (8 * i));
+    }
+    *stream_size = writer.size;
+    return true;
+}
+
+static bool write_png(FILE* file, const uint32_t* pixels, int width, int height, int stride) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    init_crc_table();
+
+    // Every row starts with its filter type byte (0: none)
+    size_t row_size = 1 + (size_t)width * 3;
+    size_t data_size = row_size * height;
+    size_t stream_size;
+    if (!reserve(&png_rows, &png_rows_capacity, data_size)) {
+        return false;
+    }
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = (const uint8_t*)(pixels + (size_t)y * stride);
+        uint8_t* out = png_rows + row_size * y;
+        *out++ = 0;
+        for (int x = 0; x < width; ++x) {
+            *out++ = row[x * 4 + 0];
+            *out++ = row[x * 4 + 1];
+            *out++ = row[x * 4 + 2];
+        }
+    }
+    if (!deflate_rows(png_rows, data_size, row_size, &stream_size)) {
+        return false;
+    }
+
+    png_writer_t png = { .file = file };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    png_begin_chunk(&png, "IHDR", 13);
+    png_put_u32(&png, width);
+    png_put_u32(&png, height);
+    png_put(&png, 8);   // Bit depth
+    png_put(&png, 2);   // Color type: RGB
+    png_put(&png, 0);   // Deflate
+    png_put(&png, 0);   // Adaptive filtering
+    png_put(&png, 0);   // No interlace
+    png_end_chunk(&png);
+
+    png_begin_chunk(&png, "IDAT", (uint32_t)stream_size);
+    for (size_t i = 0; i < stream_size; ++i) {
+        png_put(&png, png_stream[i]);
+    }
+    png_end_chunk(&png);
+
+    png_begin_chunk(&png, "IEND", 0);
+    png_end_chunk(&png);
+    return !ferror(file);
+}
+
+bool write_frame(const char* path, frame_format_t format, const uint32_t* pixels, int width, int height, int stride) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "<!> Could not open %s for writing.\n", path);
+        return false;
+    }
+
+    bool written = false;
+    switch (format) {
+        case FRAME_FORMAT_PPM: written = write_ppm(file, pixels, width, height, stride); break;
+        case FRAME_FORMAT_PNG: written = write_png(file, pixels, width, height, stride); break;
+        case FRAME_FORMAT_RAW: written = write_raw(file, pixels, width, height, stride); break;
+    }
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "<!> Could not write the frame to %s.\n", path);
+        return false;
+    }
+    return true;
+}
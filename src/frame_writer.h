@@ -0,0 +1,22 @@
+#ifndef PK_FRAME_WRITER_H
+#define PK_FRAME_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    FRAME_FORMAT_PPM, // Binary RGB portable pixmap
+    FRAME_FORMAT_PNG, // 8-bit RGB, fixed Huffman deflate of pixel runs
+    FRAME_FORMAT_RAW, // Rows of RGBA bytes, no header
+} frame_format_t;
+
+bool frame_format_from_path(const char* path, frame_format_t* format);
+
+// Expands the first "%d" or "%0Nd" of pattern with the frame number; false when it does not fit
+bool format_frame_path(char* path, size_t size, const char* pattern, int frame);
+
+// Writes a row-major image of 32-bit RGBA pixels (R, G, B, A in memory order), stride pixels per row
+bool write_frame(const char* path, frame_format_t format, const uint32_t* pixels, int width, int height, int stride);
+
+#endif // PK_FRAME_WRITER_H
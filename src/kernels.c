@@ -0,0 +1,54 @@
+#include "kernels.h"
+
+#include <SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+kernels_t kernels;
+
+/*******************************************************/
+/* Pick the widest kernels the CPU supports. The       */
+/* PIKUMA_ISA environment variable (generic, sse2,     */
+/* avx2 or avx512) overrides the choice, as long as    */
+/* the CPU can run the requested instruction set.      */
+/*******************************************************/
+bool init_kernels() {
+    const kernels_t* supported[4];
+    int num_supported = 0;
+
+    supported[num_supported++] = &kernels_generic;
+#if KERNELS_X86
+    // SDL checks both the CPUID bits and that the OS saves the wider registers
+    if (SDL_HasSSE2()) supported[num_supported++] = &kernels_sse2;
+    if (SDL_HasAVX2()) supported[num_supported++] = &kernels_avx2;
+    if (SDL_HasAVX512F()) supported[num_supported++] = &kernels_avx512;
+#endif
+
+    const kernels_t* selected = supported[num_supported - 1];
+
+    const char* requested = getenv("PIKUMA_ISA");
+    if (requested != NULL && requested[0] != '\0') {
+        const kernels_t* match = NULL;
+        for (int i = 0; i < num_supported; ++i) {
+            if (strcmp(supported[i]->name, requested) == 0) {
+                match = supported[i];
+            }
+        }
+        if (match == NULL) {
+            fprintf(stderr, "<!> PIKUMA_ISA=%s is not supported on this CPU, using %s.\n", requested, selected->name);
+        } else {
+            selected = match;
+        }
+    }
+
+    kernels = *selected;
+
+    printf("CPU kernels: %s (supported:", kernels.name);
+    for (int i = 0; i < num_supported; ++i) {
+        printf(" %s", supported[i]->name);
+    }
+    printf(")\n");
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef PK_KERNELS_H
+#define PK_KERNELS_H
+
+#include "bc1.h"
+#include "display.h"
+#include "matrix.h"
+#include "palette.h"
+#include "stats.h"
+#include "texture.h"
+#include "triangle.h"
+#include "vector.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86 1
+#else
+#define KERNELS_X86 0
+#endif
+
+#define DEPTH_U24_MAX 16777215.0f
+#define DEPTH_U16_MAX 65535.0f
+
+// Span shader bodies are specialized by inlining them with constant flags
+#if defined(_MSC_VER)
+#define KERNEL_INLINE __forceinline
+#else
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#endif
+
+// Number of set bits of a lane mask, for the pixel counters of the vector span shaders
+static inline int mask_bit_count(unsigned bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(bits);
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Depth formats as preprocessor values, to specialize the SIMD span shaders
+#define SIMD_DEPTH_F32 0
+#define SIMD_DEPTH_U24 1
+#define SIMD_DEPTH_U16 2
+
+// Widest vector the span shaders read or write past the end of a span (AVX-512: 16 lanes)
+#define KERNELS_MAX_LANES 16
+
+/*******************************************************/
+/* Hot kernels, compiled once per instruction set and  */
+/* picked at startup by init_kernels().                */
+/*******************************************************/
+typedef struct {
+    const char* name;
+
+    // Span shaders, indexed by depth_format_t; the covered ones skip the edge tests
+    span_shader_t solid_span[DEPTH_FORMAT_COUNT];
+    span_shader_t textured_span[DEPTH_FORMAT_COUNT];
+    span_shader_t solid_covered_span[DEPTH_FORMAT_COUNT];
+    span_shader_t textured_covered_span[DEPTH_FORMAT_COUNT];
+    // Textured span shaders sampling BC1 blocks (TEXTURE_FORMAT_BC1)
+    span_shader_t textured_bc1_span[DEPTH_FORMAT_COUNT];
+    span_shader_t textured_bc1_covered_span[DEPTH_FORMAT_COUNT];
+    // Textured span shaders sampling palettized texels (TEXTURE_FORMAT_PALETTE)
+    span_shader_t textured_palette_span[DEPTH_FORMAT_COUNT];
+    span_shader_t textured_palette_covered_span[DEPTH_FORMAT_COUNT];
+
+    // out[i] = m * (in[i].x, in[i].y, in[i].z, 1)
+    void (*transform_vertices)(vec4_t* out, const vec3_t* in, int count, const mat4_t* m);
+
+    // Clears
+    void (*fill_u32)(uint32_t* dst, uint32_t value, size_t count);
+
+    // Tiled framebuffer (see pixel_index()) -> row-major width x height image, dst_stride pixels per row
+    void (*detile_u32)(uint32_t* dst, int dst_stride, const uint32_t* src, int width, int height);
+} kernels_t;
+
+extern kernels_t kernels;
+
+/*******************************************************/
+/* Depth encodings, 1/w -> stored value. Closer pixels */
+/* get smaller values; the integer formats map the     */
+/* 1/w range [0, 1/znear] linearly onto [max, 0].      */
+/*******************************************************/
+static inline uint32_t depth_encode_unorm(float inv_w, float max) {
+    float depth = 1.0f - inv_w * depth_near;
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+    return (uint32_t)(depth * max);
+}
+
+static inline uint32_t depth_load_u24(int index) {
+    const uint8_t* p = (const uint8_t*)z_buffer + index * 3;
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static inline void depth_store_u24(int index, uint32_t depth) {
+    uint8_t* p = (uint8_t*)z_buffer + index * 3;
+    p[0] = depth & 0xFF;
+    p[1] = (depth >> 8) & 0xFF;
+    p[2] = (depth >> 16) & 0xFF;
+}
+
+extern const kernels_t kernels_generic;
+#if KERNELS_X86
+extern const kernels_t kernels_sse2;
+extern const kernels_t kernels_avx2;
+extern const kernels_t kernels_avx512;
+#endif
+
+// Span shaders of the overdraw debug mode (see overdraw.h), scalar only
+extern const span_shader_t overdraw_span[DEPTH_FORMAT_COUNT];
+extern const span_shader_t overdraw_covered_span[DEPTH_FORMAT_COUNT];
+
+bool init_kernels();
+
+#endif // PK_KERNELS_H
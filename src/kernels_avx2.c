@@ -0,0 +1,97 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include "display.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <immintrin.h>
+
+/*******************************************************/
+/* AVX2: 8 lanes, vector masks, masked 32-bit stores   */
+/* and hardware gathers.                               */
+/*******************************************************/
+#define LANES 8
+typedef __m256 vf;
+typedef __m256i vi;
+typedef __m256 vm;
+
+static inline vf vf_set1(float a) { return _mm256_set1_ps(a); }
+static inline vf vf_ramp(void) { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+static inline vf vf_add(vf a, vf b) { return _mm256_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b) { return _mm256_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b) { return _mm256_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b) { return _mm256_max_ps(a, b); }
+static inline vf vf_floor(vf a) { return _mm256_floor_ps(a); }
+static inline vf vf_loadu(const float* p) { return _mm256_loadu_ps(p); }
+static inline vf vf_from_vi(vi a) { return _mm256_cvtepi32_ps(a); }
+static inline vi vi_trunc(vf a) { return _mm256_cvttps_epi32(a); }
+
+static inline vi vi_set1(int a) { return _mm256_set1_epi32(a); }
+static inline vi vi_and(vi a, vi b) { return _mm256_and_si256(a, b); }
+static inline vi vi_or(vi a, vi b) { return _mm256_or_si256(a, b); }
+static inline vi vi_abs(vi a) { return _mm256_abs_epi32(a); }
+static inline vi vi_loadu(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void vi_storeu(int32_t* p, vi a) { _mm256_storeu_si256((__m256i*)p, a); }
+#define vi_srli(a, n) _mm256_srli_epi32((a), (n))
+#define vi_slli(a, n) _mm256_slli_epi32((a), (n))
+static inline vi vi_srlv(vi a, vi n) { return _mm256_srlv_epi32(a, n); }
+
+static inline vm vm_ge(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline vm vm_lt(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline vm vm_lt_i(vi a, vi b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+static inline vm vm_and(vm a, vm b) { return _mm256_and_ps(a, b); }
+static inline int vm_bits(vm m) { return _mm256_movemask_ps(m); }
+static inline int vm_any(vm m) { return !_mm256_testz_ps(m, m); }
+
+static inline void vi_store_masked(uint32_t* p, vi a, vm m) {
+    _mm256_maskstore_epi32((int*)p, _mm256_castps_si256(m), a);
+}
+
+static inline void vf_store_masked(float* p, vf a, vm m) {
+    _mm256_maskstore_ps(p, _mm256_castps_si256(m), a);
+}
+
+static inline vi vi_load_u16(const uint16_t* p) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+}
+
+static inline void vi_store_u16_masked(uint16_t* p, vi a, vm m) {
+    // Narrow both values and mask to 16 bits (packus works per 128-bit half), then blend
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    __m256i mask32 = _mm256_castps_si256(m);
+    __m128i mask = _mm_packs_epi32(_mm256_castsi256_si128(mask32), _mm256_extracti128_si256(mask32, 1));
+    __m128i old = _mm_loadu_si128((const __m128i*)p);
+    _mm_storeu_si128((__m128i*)p, _mm_blendv_epi8(old, packed, mask));
+}
+
+static inline vi vi_gather(const uint32_t* base, vi index, vm m) {
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)base, index, _mm256_castps_si256(m), 4);
+}
+
+#define DEPTH_SUFFIX f32
+#define DEPTH_ID SIMD_DEPTH_F32
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u24
+#define DEPTH_ID SIMD_DEPTH_U24
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u16
+#define DEPTH_ID SIMD_DEPTH_U16
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define KERNELS_TABLE kernels_avx2
+#define KERNELS_ISA "avx2"
+#include "kernels_common.h"
+
+#endif // KERNELS_X86
@@ -0,0 +1,81 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include "display.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <immintrin.h>
+
+/*******************************************************/
+/* AVX-512F: 16 lanes, mask registers, masked loads,   */
+/* stores and gathers for every lane width.            */
+/*******************************************************/
+#define LANES 16
+typedef __m512 vf;
+typedef __m512i vi;
+typedef __mmask16 vm;
+
+static inline vf vf_set1(float a) { return _mm512_set1_ps(a); }
+static inline vf vf_ramp(void) { return _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+static inline vf vf_add(vf a, vf b) { return _mm512_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b) { return _mm512_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b) { return _mm512_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b) { return _mm512_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b) { return _mm512_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b) { return _mm512_max_ps(a, b); }
+static inline vf vf_floor(vf a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+static inline vf vf_loadu(const float* p) { return _mm512_loadu_ps(p); }
+static inline vf vf_from_vi(vi a) { return _mm512_cvtepi32_ps(a); }
+static inline vi vi_trunc(vf a) { return _mm512_cvttps_epi32(a); }
+
+static inline vi vi_set1(int a) { return _mm512_set1_epi32(a); }
+static inline vi vi_and(vi a, vi b) { return _mm512_and_si512(a, b); }
+static inline vi vi_or(vi a, vi b) { return _mm512_or_si512(a, b); }
+static inline vi vi_abs(vi a) { return _mm512_abs_epi32(a); }
+static inline vi vi_loadu(const int32_t* p) { return _mm512_loadu_si512((const void*)p); }
+static inline void vi_storeu(int32_t* p, vi a) { _mm512_storeu_si512((void*)p, a); }
+#define vi_srli(a, n) _mm512_srli_epi32((a), (n))
+#define vi_slli(a, n) _mm512_slli_epi32((a), (n))
+static inline vi vi_srlv(vi a, vi n) { return _mm512_srlv_epi32(a, n); }
+
+static inline vm vm_ge(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+static inline vm vm_lt(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+static inline vm vm_lt_i(vi a, vi b) { return _mm512_cmplt_epi32_mask(a, b); }
+static inline vm vm_and(vm a, vm b) { return a & b; }
+static inline int vm_bits(vm m) { return m; }
+static inline int vm_any(vm m) { return m != 0; }
+
+static inline void vi_store_masked(uint32_t* p, vi a, vm m) { _mm512_mask_storeu_epi32(p, m, a); }
+static inline void vf_store_masked(float* p, vf a, vm m) { _mm512_mask_storeu_ps(p, m, a); }
+static inline vi vi_load_u16(const uint16_t* p) { return _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)p)); }
+static inline void vi_store_u16_masked(uint16_t* p, vi a, vm m) { _mm512_mask_cvtepi32_storeu_epi16(p, m, a); }
+
+static inline vi vi_gather(const uint32_t* base, vi index, vm m) {
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, index, (const void*)base, 4);
+}
+
+#define DEPTH_SUFFIX f32
+#define DEPTH_ID SIMD_DEPTH_F32
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u24
+#define DEPTH_ID SIMD_DEPTH_U24
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u16
+#define DEPTH_ID SIMD_DEPTH_U16
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define KERNELS_TABLE kernels_avx512
+#define KERNELS_ISA "avx512"
+#include "kernels_common.h"
+
+#endif // KERNELS_X86
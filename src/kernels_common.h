@@ -0,0 +1,95 @@
+/*****************************************************************/
+/* Plain C kernels and the kernel table of one instruction set.  */
+/*                                                               */
+/* This file has no include guard on purpose: every kernels_*.c  */
+/* includes it once, after its span shaders, with                */
+/*   KERNELS_TABLE   name of the kernels_t table to define       */
+/*   KERNELS_ISA     printable name of the instruction set       */
+/* The loops are written so the compiler can vectorize them for  */
+/* the instruction set the including file is compiled for.       */
+/*****************************************************************/
+
+static void transform_vertices(vec4_t* out, const vec3_t* in, int count, const mat4_t* m) {
+    const float m00 = m->m[0][0], m01 = m->m[0][1], m02 = m->m[0][2], m03 = m->m[0][3];
+    const float m10 = m->m[1][0], m11 = m->m[1][1], m12 = m->m[1][2], m13 = m->m[1][3];
+    const float m20 = m->m[2][0], m21 = m->m[2][1], m22 = m->m[2][2], m23 = m->m[2][3];
+    const float m30 = m->m[3][0], m31 = m->m[3][1], m32 = m->m[3][2], m33 = m->m[3][3];
+    for (int i = 0; i < count; ++i) {
+        const float x = in[i].x;
+        const float y = in[i].y;
+        const float z = in[i].z;
+        out[i].x = m00 * x + m01 * y + m02 * z + m03;
+        out[i].y = m10 * x + m11 * y + m12 * z + m13;
+        out[i].z = m20 * x + m21 * y + m22 * z + m23;
+        out[i].w = m30 * x + m31 * y + m32 * z + m33;
+    }
+}
+
+static void fill_u32(uint32_t* dst, uint32_t value, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = value;
+    }
+}
+
+static void detile_u32(uint32_t* dst, int dst_stride, const uint32_t* src, int width, int height) {
+    size_t tile_row_pixels = (size_t)((width + TILE_MASK) >> TILE_SHIFT) * TILE_PIXELS;
+    for (int y = 0; y < height; ++y) {
+        const uint32_t* tiles = src + (y >> TILE_SHIFT) * tile_row_pixels + ((y & TILE_MASK) << TILE_SHIFT);
+        uint32_t* out = dst + (size_t)y * dst_stride;
+        int x = 0;
+        // Fixed size copies of one tile row each, a single vector move or two
+        for (; x + TILE_SIZE <= width; x += TILE_SIZE) {
+            memcpy(out + x, tiles + (x >> TILE_SHIFT) * TILE_PIXELS, TILE_SIZE * sizeof(uint32_t));
+        }
+        if (x < width) {
+            memcpy(out + x, tiles + (x >> TILE_SHIFT) * TILE_PIXELS, (width - x) * sizeof(uint32_t));
+        }
+    }
+}
+
+const kernels_t KERNELS_TABLE = {
+    .name = KERNELS_ISA,
+    .solid_span = {
+        [DEPTH_FORMAT_F32] = solid_span_f32,
+        [DEPTH_FORMAT_U24] = solid_span_u24,
+        [DEPTH_FORMAT_U16] = solid_span_u16,
+    },
+    .textured_span = {
+        [DEPTH_FORMAT_F32] = textured_span_f32,
+        [DEPTH_FORMAT_U24] = textured_span_u24,
+        [DEPTH_FORMAT_U16] = textured_span_u16,
+    },
+    .solid_covered_span = {
+        [DEPTH_FORMAT_F32] = solid_covered_span_f32,
+        [DEPTH_FORMAT_U24] = solid_covered_span_u24,
+        [DEPTH_FORMAT_U16] = solid_covered_span_u16,
+    },
+    .textured_covered_span = {
+        [DEPTH_FORMAT_F32] = textured_covered_span_f32,
+        [DEPTH_FORMAT_U24] = textured_covered_span_u24,
+        [DEPTH_FORMAT_U16] = textured_covered_span_u16,
+    },
+    .textured_bc1_span = {
+        [DEPTH_FORMAT_F32] = textured_bc1_span_f32,
+        [DEPTH_FORMAT_U24] = textured_bc1_span_u24,
+        [DEPTH_FORMAT_U16] = textured_bc1_span_u16,
+    },
+    .textured_bc1_covered_span = {
+        [DEPTH_FORMAT_F32] = textured_bc1_covered_span_f32,
+        [DEPTH_FORMAT_U24] = textured_bc1_covered_span_u24,
+        [DEPTH_FORMAT_U16] = textured_bc1_covered_span_u16,
+    },
+    .textured_palette_span = {
+        [DEPTH_FORMAT_F32] = textured_palette_span_f32,
+        [DEPTH_FORMAT_U24] = textured_palette_span_u24,
+        [DEPTH_FORMAT_U16] = textured_palette_span_u16,
+    },
+    .textured_palette_covered_span = {
+        [DEPTH_FORMAT_F32] = textured_palette_covered_span_f32,
+        [DEPTH_FORMAT_U24] = textured_palette_covered_span_u24,
+        [DEPTH_FORMAT_U16] = textured_palette_covered_span_u16,
+    },
+    .transform_vertices = transform_vertices,
+    .fill_u32 = fill_u32,
+    .detile_u32 = detile_u32,
+};
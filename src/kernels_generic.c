@@ -0,0 +1,63 @@
+#include "kernels.h"
+#include "display.h"
+#include "light.h"
+#include "overdraw.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <stdlib.h>
+
+// Portable scalar kernels, used when no vector instruction set is available
+
+#define DEPTH_SUFFIX f32
+#define DEPTH_TYPE float
+#define DEPTH_ENCODE(inv_w) (1.0f - (inv_w))
+#define DEPTH_LOAD(i) (((float*)z_buffer)[i])
+#define DEPTH_STORE(i, d) (((float*)z_buffer)[i] = (d))
+#include "kernels_span.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_TYPE
+#undef DEPTH_ENCODE
+#undef DEPTH_LOAD
+#undef DEPTH_STORE
+
+#define DEPTH_SUFFIX u24
+#define DEPTH_TYPE uint32_t
+#define DEPTH_ENCODE(inv_w) depth_encode_unorm((inv_w), DEPTH_U24_MAX)
+#define DEPTH_LOAD(i) depth_load_u24(i)
+#define DEPTH_STORE(i, d) depth_store_u24((i), (d))
+#include "kernels_span.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_TYPE
+#undef DEPTH_ENCODE
+#undef DEPTH_LOAD
+#undef DEPTH_STORE
+
+#define DEPTH_SUFFIX u16
+#define DEPTH_TYPE uint16_t
+#define DEPTH_ENCODE(inv_w) (uint16_t)depth_encode_unorm((inv_w), DEPTH_U16_MAX)
+#define DEPTH_LOAD(i) (((uint16_t*)z_buffer)[i])
+#define DEPTH_STORE(i, d) (((uint16_t*)z_buffer)[i] = (d))
+#include "kernels_span.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_TYPE
+#undef DEPTH_ENCODE
+#undef DEPTH_LOAD
+#undef DEPTH_STORE
+
+#define KERNELS_TABLE kernels_generic
+#define KERNELS_ISA "generic"
+#include "kernels_common.h"
+
+// The overdraw debug mode is not performance critical, every instruction set uses these
+const span_shader_t overdraw_span[DEPTH_FORMAT_COUNT] = {
+    [DEPTH_FORMAT_F32] = overdraw_span_f32,
+    [DEPTH_FORMAT_U24] = overdraw_span_u24,
+    [DEPTH_FORMAT_U16] = overdraw_span_u16,
+};
+
+const span_shader_t overdraw_covered_span[DEPTH_FORMAT_COUNT] = {
+    [DEPTH_FORMAT_F32] = overdraw_covered_span_f32,
+    [DEPTH_FORMAT_U24] = overdraw_covered_span_u24,
+    [DEPTH_FORMAT_U16] = overdraw_covered_span_u16,
+};
@@ -0,0 +1,176 @@
+/*****************************************************************/
+/* Depth format specialized scalar span shaders.                 */
+/*                                                               */
+/* This file has no include guard on purpose: kernels_generic.c  */
+/* includes it once per depth format after defining              */
+/*   DEPTH_SUFFIX         name suffix of the generated kernels   */
+/*   DEPTH_TYPE           type of an encoded depth value         */
+/*   DEPTH_ENCODE(inv_w)  1/w -> stored depth value              */
+/*   DEPTH_LOAD(i)        read the stored depth of pixel i       */
+/*   DEPTH_STORE(i, d)    write the stored depth of pixel i      */
+/* so the per pixel depth test never branches on the format.     */
+/*                                                               */
+/* A span shader fills the pixels [x_start, x_end] of row y that */
+/* pass the edge tests of the setup record; they are stored from */
+/* buffer offset index on. The covered variants are used for    */
+/* spans known to be inside the triangle and skip the tests.     */
+/* The bc1 and palette variants of the textured ones sample BC1  */
+/* blocks and palettized texels.                                 */
+/* Tested and written pixels are added to frame_counters once a  */
+/* span is done.                                                 */
+/*****************************************************************/
+
+#define KERNEL_NAME__(name, suffix) name##_##suffix
+#define KERNEL_NAME_(name, suffix) KERNEL_NAME__(name, suffix)
+#define KERNEL(name) KERNEL_NAME_(name, DEPTH_SUFFIX)
+
+static KERNEL_INLINE void KERNEL(solid_span_body)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const bool covered) {
+    float fx = x_start - t->min_x;
+    float fy = y - t->min_y;
+    float e0 = plane_eq_at(t->edges[0], fx, fy);
+    float e1 = plane_eq_at(t->edges[1], fx, fy);
+    float e2 = plane_eq_at(t->edges[2], fx, fy);
+    float inv_w = plane_eq_at(t->inv_w, fx, fy);
+    int tested = 0;
+    int written = 0;
+
+    for (int x = x_start; x <= x_end; ++x, ++index) {
+        if (covered || (e0 >= 0 && e1 >= 0 && e2 >= 0)) {
+            // Only draw the pixel if it is closer than the one previously stored in the z-buffer
+            DEPTH_TYPE depth = DEPTH_ENCODE(inv_w);
+            tested++;
+            if (depth < DEPTH_LOAD(index)) {
+                color_buffer[index] = t->color;
+                DEPTH_STORE(index, depth);
+                written++;
+            }
+        }
+        e0 += t->edges[0].dx;
+        e1 += t->edges[1].dx;
+        e2 += t->edges[2].dx;
+        inv_w += t->inv_w.dx;
+    }
+    frame_counters.pixels_tested += tested;
+    frame_counters.pixels_written += written;
+}
+
+static KERNEL_INLINE void KERNEL(textured_span_body)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture, const bool covered, const texture_format_t format) {
+    float fx = x_start - t->min_x;
+    float fy = y - t->min_y;
+    float e0 = plane_eq_at(t->edges[0], fx, fy);
+    float e1 = plane_eq_at(t->edges[1], fx, fy);
+    float e2 = plane_eq_at(t->edges[2], fx, fy);
+    float inv_w = plane_eq_at(t->inv_w, fx, fy);
+    float u_over_w = plane_eq_at(t->u_over_w, fx, fy);
+    float v_over_w = plane_eq_at(t->v_over_w, fx, fy);
+    int blocks_per_row = bc1_blocks_per_row(texture_width);
+    // Palettized texels are lit by the colormap row of the triangle instead of update_color_intensity()
+    const uint32_t* colormap = format == TEXTURE_FORMAT_PALETTE ? palette_colormap_row(texture, t->light_intensity) : NULL;
+    const uint8_t* indices = format == TEXTURE_FORMAT_PALETTE ? palette_indices(texture) : NULL;
+    int tested = 0;
+    int written = 0;
+
+    for (int x = x_start; x <= x_end; ++x, ++index) {
+        if (covered || (e0 >= 0 && e1 >= 0 && e2 >= 0)) {
+            DEPTH_TYPE depth = DEPTH_ENCODE(inv_w);
+            tested++;
+            if (depth < DEPTH_LOAD(index)) {
+                // Divide back the interpolated U/w and V/w by 1/w (perspective correction)
+                float u = u_over_w / inv_w;
+                float v = v_over_w / inv_w;
+
+                // Map the UV coordinate to the full texture width and height
+                int tex_x = abs((int)(u * texture_width)) % texture_width;
+                int tex_y = abs((int)(v * texture_height)) % texture_height;
+
+                if (format == TEXTURE_FORMAT_PALETTE) {
+                    color_buffer[index] = colormap[indices[(texture_width * tex_y) + tex_x]];
+                } else {
+                    uint32_t texel = format == TEXTURE_FORMAT_BC1
+                        ? bc1_fetch(texture, blocks_per_row, tex_x, tex_y)
+                        : texture[(texture_width * tex_y) + tex_x];
+                    color_buffer[index] = update_color_intensity(texel, t->light_intensity);
+                }
+                DEPTH_STORE(index, depth);
+                written++;
+            }
+        }
+        e0 += t->edges[0].dx;
+        e1 += t->edges[1].dx;
+        e2 += t->edges[2].dx;
+        inv_w += t->inv_w.dx;
+        u_over_w += t->u_over_w.dx;
+        v_over_w += t->v_over_w.dx;
+    }
+    frame_counters.pixels_tested += tested;
+    frame_counters.pixels_written += written;
+}
+
+// Debug mode: counts the depth tests and writes of every pixel into the overdraw buffers instead of shading it
+static KERNEL_INLINE void KERNEL(overdraw_span_body)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const bool covered) {
+    float fx = x_start - t->min_x;
+    float fy = y - t->min_y;
+    float e0 = plane_eq_at(t->edges[0], fx, fy);
+    float e1 = plane_eq_at(t->edges[1], fx, fy);
+    float e2 = plane_eq_at(t->edges[2], fx, fy);
+    float inv_w = plane_eq_at(t->inv_w, fx, fy);
+
+    for (int x = x_start; x <= x_end; ++x, ++index) {
+        if (covered || (e0 >= 0 && e1 >= 0 && e2 >= 0)) {
+            DEPTH_TYPE depth = DEPTH_ENCODE(inv_w);
+            if (overdraw_tests[index] < UINT16_MAX) overdraw_tests[index]++;
+            if (depth < DEPTH_LOAD(index)) {
+                if (overdraw_writes[index] < UINT16_MAX) overdraw_writes[index]++;
+                DEPTH_STORE(index, depth);
+            }
+        }
+        e0 += t->edges[0].dx;
+        e1 += t->edges[1].dx;
+        e2 += t->edges[2].dx;
+        inv_w += t->inv_w.dx;
+    }
+}
+
+static void KERNEL(solid_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(solid_span_body)(t, y, x_start, x_end, index, false);
+}
+
+static void KERNEL(solid_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(solid_span_body)(t, y, x_start, x_end, index, true);
+}
+
+static void KERNEL(textured_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_RGBA32);
+}
+
+static void KERNEL(textured_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_RGBA32);
+}
+
+static void KERNEL(textured_bc1_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_BC1);
+}
+
+static void KERNEL(textured_bc1_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_BC1);
+}
+
+static void KERNEL(textured_palette_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_PALETTE);
+}
+
+static void KERNEL(textured_palette_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_PALETTE);
+}
+
+static void KERNEL(overdraw_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(overdraw_span_body)(t, y, x_start, x_end, index, false);
+}
+
+static void KERNEL(overdraw_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(overdraw_span_body)(t, y, x_start, x_end, index, true);
+}
+
+#undef KERNEL
+#undef KERNEL_NAME_
+#undef KERNEL_NAME__
@@ -0,0 +1,251 @@
+/*****************************************************************/
+/* Depth format specialized SIMD span shaders.                   */
+/*                                                               */
+/* This file has no include guard on purpose: every vector       */
+/* kernels_<isa>.c file includes it once per depth format after  */
+/* defining its vector primitives (vf, vi, vm, LANES, vf_add...) */
+/* and                                                           */
+/*   DEPTH_SUFFIX    name suffix of the generated kernels        */
+/*   DEPTH_ID        one of the SIMD_DEPTH_* values (kernels.h)  */
+/*                                                               */
+/* LANES pixels are shaded at once. Lanes past the end of the    */
+/* span are masked off; the z-buffer is padded so reading them   */
+/* stays in bounds, and the color buffer is only written         */
+/* through masked stores. The covered variants skip the edge     */
+/* tests of spans known to be inside the triangle. The bc1       */
+/* variants of the textured ones gather the two words of the     */
+/* sampled BC1 blocks and decode the texels in the lanes, the    */
+/* palette ones load the index bytes lane by lane and gather the */
+/* lit colors from the colormap. Tested and written pixels are   */
+/* counted from the lane masks.                                  */
+/*****************************************************************/
+
+#define KERNEL_NAME__(name, suffix) name##_##suffix
+#define KERNEL_NAME_(name, suffix) KERNEL_NAME__(name, suffix)
+#define KERNEL(name) KERNEL_NAME_(name, DEPTH_SUFFIX)
+
+// Tests LANES pixels starting at index against the z-buffer, stores the depth of
+// the pixels in mask m that are closer and returns their mask
+static inline vm KERNEL(depth_test_and_write)(int index, vf inv_w, vm m) {
+#if DEPTH_ID == SIMD_DEPTH_F32
+    float* depth_buffer = (float*)z_buffer + index;
+    vf depth = vf_sub(vf_set1(1.0f), inv_w);
+    m = vm_and(m, vm_lt(depth, vf_loadu(depth_buffer)));
+    vf_store_masked(depth_buffer, depth, m);
+#else
+    vf normalized = vf_sub(vf_set1(1.0f), vf_mul(inv_w, vf_set1(depth_near)));
+    normalized = vf_min(vf_max(normalized, vf_set1(0.0f)), vf_set1(1.0f));
+#if DEPTH_ID == SIMD_DEPTH_U16
+    uint16_t* depth_buffer = (uint16_t*)z_buffer + index;
+    vi depth = vi_trunc(vf_mul(normalized, vf_set1(DEPTH_U16_MAX)));
+    m = vm_and(m, vm_lt_i(depth, vi_load_u16(depth_buffer)));
+    vi_store_u16_masked(depth_buffer, depth, m);
+#else
+    // 3-byte depth values do not map onto vector lanes, move them one by one
+    int32_t lanes[LANES];
+    vi depth = vi_trunc(vf_mul(normalized, vf_set1(DEPTH_U24_MAX)));
+    for (int i = 0; i < LANES; ++i) {
+        lanes[i] = depth_load_u24(index + i);
+    }
+    m = vm_and(m, vm_lt_i(depth, vi_loadu(lanes)));
+    int bits = vm_bits(m);
+    if (bits) {
+        vi_storeu(lanes, depth);
+        for (int i = 0; i < LANES; ++i) {
+            if (bits & (1 << i)) {
+                depth_store_u24(index + i, lanes[i]);
+            }
+        }
+    }
+#endif
+#endif
+    return m;
+}
+
+static KERNEL_INLINE void KERNEL(solid_span_body)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const bool covered) {
+    float fy = y - t->min_y;
+    vf lane_x = vf_add(vf_set1(x_start - t->min_x), vf_ramp());
+    vf last_x = vf_set1(x_end - t->min_x);
+    vf step = vf_set1(LANES);
+    vf zero = vf_set1(0.0f);
+
+    vf e0_row = vf_set1(t->edges[0].c + t->edges[0].dy * fy), e0_dx = vf_set1(t->edges[0].dx);
+    vf e1_row = vf_set1(t->edges[1].c + t->edges[1].dy * fy), e1_dx = vf_set1(t->edges[1].dx);
+    vf e2_row = vf_set1(t->edges[2].c + t->edges[2].dy * fy), e2_dx = vf_set1(t->edges[2].dx);
+    vf w_row = vf_set1(t->inv_w.c + t->inv_w.dy * fy), w_dx = vf_set1(t->inv_w.dx);
+    vi color = vi_set1((int)t->color);
+    int tested = 0;
+    int written = 0;
+
+    for (int x = x_start; x <= x_end; x += LANES, index += LANES, lane_x = vf_add(lane_x, step)) {
+        vm m = vm_ge(last_x, lane_x);
+        if (!covered) {
+            m = vm_and(m, vm_ge(vf_add(e0_row, vf_mul(lane_x, e0_dx)), zero));
+            m = vm_and(m, vm_ge(vf_add(e1_row, vf_mul(lane_x, e1_dx)), zero));
+            m = vm_and(m, vm_ge(vf_add(e2_row, vf_mul(lane_x, e2_dx)), zero));
+            if (!vm_any(m)) continue;
+        }
+        tested += mask_bit_count(vm_bits(m));
+
+        vf inv_w = vf_add(w_row, vf_mul(lane_x, w_dx));
+        m = KERNEL(depth_test_and_write)(index, inv_w, m);
+        if (!vm_any(m)) continue;
+        written += mask_bit_count(vm_bits(m));
+
+        vi_store_masked(color_buffer + index, color, m);
+    }
+    frame_counters.pixels_tested += tested;
+    frame_counters.pixels_written += written;
+}
+
+// An 8-bit BC1 channel of the lanes, from its field in the c0 (low) and c1 (high) halves of the endpoints
+// words. Masked in place, the field is a multiple of its lowest bit: scaling it by expand / lowest bit is
+// the top bits repeated into the bottom ones once floored (8.25 for 5 bits, 4.0625 for 6 bits). The
+// blend is floor((c0 * (3 - thirds) + c1 * thirds) / 3), as bc1_fetch() does in integers: the sum is an
+// integer, so a third of it plus a sixth is at least a sixth away from the next integer.
+static inline vf KERNEL(bc1_channel)(vi c0_word, vi c1_word, vi field_mask, vf expand, vf c0_thirds, vf c1_thirds) {
+    vf c0 = vf_floor(vf_mul(vf_from_vi(vi_and(c0_word, field_mask)), expand));
+    vf c1 = vf_floor(vf_mul(vf_from_vi(vi_and(c1_word, field_mask)), expand));
+    vf sum = vf_add(vf_mul(c0, c0_thirds), vf_mul(c1, c1_thirds));
+    return vf_floor(vf_mul(vf_add(sum, vf_set1(0.5f)), vf_set1(1.0f / 3.0f)));
+}
+
+static KERNEL_INLINE void KERNEL(textured_span_body)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture, const bool covered, const texture_format_t format) {
+    float fy = y - t->min_y;
+    vf lane_x = vf_add(vf_set1(x_start - t->min_x), vf_ramp());
+    vf last_x = vf_set1(x_end - t->min_x);
+    vf step = vf_set1(LANES);
+    vf zero = vf_set1(0.0f);
+
+    vf e0_row = vf_set1(t->edges[0].c + t->edges[0].dy * fy), e0_dx = vf_set1(t->edges[0].dx);
+    vf e1_row = vf_set1(t->edges[1].c + t->edges[1].dy * fy), e1_dx = vf_set1(t->edges[1].dx);
+    vf e2_row = vf_set1(t->edges[2].c + t->edges[2].dy * fy), e2_dx = vf_set1(t->edges[2].dx);
+    vf w_row = vf_set1(t->inv_w.c + t->inv_w.dy * fy), w_dx = vf_set1(t->inv_w.dx);
+    vf u_row = vf_set1(t->u_over_w.c + t->u_over_w.dy * fy), u_dx = vf_set1(t->u_over_w.dx);
+    vf v_row = vf_set1(t->v_over_w.c + t->v_over_w.dy * fy), v_dx = vf_set1(t->v_over_w.dx);
+
+    vf tex_w = vf_set1(texture_width);
+    vf tex_h = vf_set1(texture_height);
+    vf tex_w_max = vf_set1(texture_width - 1);
+    vf tex_h_max = vf_set1(texture_height - 1);
+    vf block_row_words = vf_set1(2 * bc1_blocks_per_row(texture_width));
+    const uint32_t* colormap = format == TEXTURE_FORMAT_PALETTE ? palette_colormap_row(texture, t->light_intensity) : NULL;
+    const uint8_t* indices = format == TEXTURE_FORMAT_PALETTE ? palette_indices(texture) : NULL;
+
+    float light_intensity = t->light_intensity;
+    if (light_intensity < 0) light_intensity = 0;
+    if (light_intensity > 1) light_intensity = 1;
+    vf intensity = vf_set1(light_intensity);
+    vi channel_mask = vi_set1(0xFF);
+    vi three = vi_set1(3);
+    // BC1 texels are opaque
+    vi bc1_alpha = vi_set1((int)((uint32_t)(255 * light_intensity) << 24));
+    int tested = 0;
+    int written = 0;
+
+    for (int x = x_start; x <= x_end; x += LANES, index += LANES, lane_x = vf_add(lane_x, step)) {
+        vm m = vm_ge(last_x, lane_x);
+        if (!covered) {
+            m = vm_and(m, vm_ge(vf_add(e0_row, vf_mul(lane_x, e0_dx)), zero));
+            m = vm_and(m, vm_ge(vf_add(e1_row, vf_mul(lane_x, e1_dx)), zero));
+            m = vm_and(m, vm_ge(vf_add(e2_row, vf_mul(lane_x, e2_dx)), zero));
+            if (!vm_any(m)) continue;
+        }
+        tested += mask_bit_count(vm_bits(m));
+
+        vf inv_w = vf_add(w_row, vf_mul(lane_x, w_dx));
+        m = KERNEL(depth_test_and_write)(index, inv_w, m);
+        if (!vm_any(m)) continue;
+        written += mask_bit_count(vm_bits(m));
+
+        // Divide back the interpolated U/w and V/w by 1/w (perspective correction)
+        vf u = vf_div(vf_add(u_row, vf_mul(lane_x, u_dx)), inv_w);
+        vf v = vf_div(vf_add(v_row, vf_mul(lane_x, v_dx)), inv_w);
+
+        // abs((int)(u * width)) % width, with the modulo done in float (exact below 2^24)
+        vf tex_x = vf_from_vi(vi_abs(vi_trunc(vf_mul(u, tex_w))));
+        vf tex_y = vf_from_vi(vi_abs(vi_trunc(vf_mul(v, tex_h))));
+        tex_x = vf_sub(tex_x, vf_mul(vf_floor(vf_div(tex_x, tex_w)), tex_w));
+        tex_y = vf_sub(tex_y, vf_mul(vf_floor(vf_div(tex_y, tex_h)), tex_h));
+        tex_x = vf_min(vf_max(tex_x, zero), tex_w_max);
+        tex_y = vf_min(vf_max(tex_y, zero), tex_h_max);
+        if (format == TEXTURE_FORMAT_PALETTE) {
+            // Already lit: the colormap row replaces the per channel scaling
+            int32_t lane_texel_index[LANES], lane_indices[LANES];
+            vi_storeu(lane_texel_index, vi_trunc(vf_add(vf_mul(tex_y, tex_w), tex_x)));
+            palette_fetch_lanes(lane_indices, indices, lane_texel_index, LANES, vm_bits(m));
+            vi_store_masked(color_buffer + index, vi_gather(colormap, vi_loadu(lane_indices), m), m);
+            continue;
+        }
+        if (format == TEXTURE_FORMAT_BC1) {
+            // The endpoints and indices words of the sampled blocks, then the 2-bit index of every texel
+            vi texel_x = vi_trunc(tex_x);
+            vi texel_y = vi_trunc(tex_y);
+            vi word = vi_trunc(vf_add(vf_mul(vf_from_vi(vi_srli(texel_y, 2)), block_row_words), vf_from_vi(vi_slli(vi_srli(texel_x, 2), 1))));
+            vi endpoints = vi_gather(texture, word, m);
+            vi shift = vi_or(vi_slli(vi_and(texel_y, three), 3), vi_slli(vi_and(texel_x, three), 1));
+            vi selector = vi_and(vi_srlv(vi_gather(texture + 1, word, m), shift), three);
+            vf c1_thirds = vf_from_vi(vi_and(vi_srlv(vi_set1(BC1_C1_THIRDS), vi_slli(selector, 1)), three));
+            vf c0_thirds = vf_sub(vf_set1(3.0f), c1_thirds);
+            vi c1_word = vi_srli(endpoints, 16);
+
+            // The top 5 bits of an RGB565 color decode into byte 0 of the texel (see bc1_fetch())
+            vf b_channel = KERNEL(bc1_channel)(endpoints, c1_word, vi_set1(0xF800), vf_set1(8.25f / 2048), c0_thirds, c1_thirds);
+            vf g_channel = KERNEL(bc1_channel)(endpoints, c1_word, vi_set1(0x07E0), vf_set1(4.0625f / 32), c0_thirds, c1_thirds);
+            vf r_channel = KERNEL(bc1_channel)(endpoints, c1_word, vi_set1(0x001F), vf_set1(8.25f), c0_thirds, c1_thirds);
+            vi r = vi_slli(vi_trunc(vf_mul(r_channel, intensity)), 16);
+            vi g = vi_slli(vi_trunc(vf_mul(g_channel, intensity)), 8);
+            vi b = vi_trunc(vf_mul(b_channel, intensity));
+            vi_store_masked(color_buffer + index, vi_or(vi_or(bc1_alpha, r), vi_or(g, b)), m);
+            continue;
+        }
+        vi texel_index = vi_trunc(vf_add(vf_mul(tex_y, tex_w), tex_x));
+        vi texel = vi_gather(texture, texel_index, m);
+
+        // Scale every channel by the light intensity, as update_color_intensity() does
+        vi a = vi_slli(vi_trunc(vf_mul(vf_from_vi(vi_and(vi_srli(texel, 24), channel_mask)), intensity)), 24);
+        vi r = vi_slli(vi_trunc(vf_mul(vf_from_vi(vi_and(vi_srli(texel, 16), channel_mask)), intensity)), 16);
+        vi g = vi_slli(vi_trunc(vf_mul(vf_from_vi(vi_and(vi_srli(texel, 8), channel_mask)), intensity)), 8);
+        vi b = vi_trunc(vf_mul(vf_from_vi(vi_and(texel, channel_mask)), intensity));
+
+        vi_store_masked(color_buffer + index, vi_or(vi_or(a, r), vi_or(g, b)), m);
+    }
+    frame_counters.pixels_tested += tested;
+    frame_counters.pixels_written += written;
+}
+
+static void KERNEL(solid_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(solid_span_body)(t, y, x_start, x_end, index, false);
+}
+
+static void KERNEL(solid_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(solid_span_body)(t, y, x_start, x_end, index, true);
+}
+
+static void KERNEL(textured_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_RGBA32);
+}
+
+static void KERNEL(textured_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_RGBA32);
+}
+
+static void KERNEL(textured_bc1_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_BC1);
+}
+
+static void KERNEL(textured_bc1_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_BC1);
+}
+
+static void KERNEL(textured_palette_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, false, TEXTURE_FORMAT_PALETTE);
+}
+
+static void KERNEL(textured_palette_covered_span)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture) {
+    KERNEL(textured_span_body)(t, y, x_start, x_end, index, texture, true, TEXTURE_FORMAT_PALETTE);
+}
+
+#undef KERNEL
+#undef KERNEL_NAME_
+#undef KERNEL_NAME__
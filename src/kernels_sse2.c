@@ -0,0 +1,134 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include "display.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <emmintrin.h>
+
+/*******************************************************/
+/* SSE2: 4 lanes, vector masks, no masked stores or    */
+/* gathers (those go lane by lane).                    */
+/*******************************************************/
+#define LANES 4
+typedef __m128 vf;
+typedef __m128i vi;
+typedef __m128 vm;
+
+static inline vf vf_set1(float a) { return _mm_set1_ps(a); }
+static inline vf vf_ramp(void) { return _mm_setr_ps(0, 1, 2, 3); }
+static inline vf vf_add(vf a, vf b) { return _mm_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b) { return _mm_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b) { return _mm_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b) { return _mm_max_ps(a, b); }
+static inline vf vf_loadu(const float* p) { return _mm_loadu_ps(p); }
+static inline vf vf_from_vi(vi a) { return _mm_cvtepi32_ps(a); }
+static inline vi vi_trunc(vf a) { return _mm_cvttps_epi32(a); }
+
+static inline vf vf_floor(vf a) {
+    // SSE2 has no rounding instruction: truncate, then step down where that rounded up
+    vf t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+
+static inline vi vi_set1(int a) { return _mm_set1_epi32(a); }
+static inline vi vi_and(vi a, vi b) { return _mm_and_si128(a, b); }
+static inline vi vi_or(vi a, vi b) { return _mm_or_si128(a, b); }
+static inline vi vi_loadu(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vi_storeu(int32_t* p, vi a) { _mm_storeu_si128((__m128i*)p, a); }
+#define vi_srli(a, n) _mm_srli_epi32((a), (n))
+#define vi_slli(a, n) _mm_slli_epi32((a), (n))
+
+// No per lane shift counts before AVX2: shifts lane by lane
+static inline vi vi_srlv(vi a, vi n) {
+    uint32_t values[LANES];
+    int32_t counts[LANES];
+    _mm_storeu_si128((__m128i*)values, a);
+    _mm_storeu_si128((__m128i*)counts, n);
+    for (int i = 0; i < LANES; ++i) {
+        values[i] >>= counts[i];
+    }
+    return _mm_loadu_si128((const __m128i*)values);
+}
+
+static inline vi vi_abs(vi a) {
+    vi sign = _mm_srai_epi32(a, 31);
+    return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+}
+
+static inline vm vm_ge(vf a, vf b) { return _mm_cmpge_ps(a, b); }
+static inline vm vm_lt(vf a, vf b) { return _mm_cmplt_ps(a, b); }
+static inline vm vm_lt_i(vi a, vi b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+static inline vm vm_and(vm a, vm b) { return _mm_and_ps(a, b); }
+static inline int vm_bits(vm m) { return _mm_movemask_ps(m); }
+static inline int vm_any(vm m) { return _mm_movemask_ps(m) != 0; }
+
+static inline void vi_store_masked(uint32_t* p, vi a, vm m) {
+    int bits = vm_bits(m);
+    if (bits == 0xF) {
+        _mm_storeu_si128((__m128i*)p, a);
+        return;
+    }
+    uint32_t lanes[LANES];
+    _mm_storeu_si128((__m128i*)lanes, a);
+    for (int i = 0; i < LANES; ++i) {
+        if (bits & (1 << i)) p[i] = lanes[i];
+    }
+}
+
+static inline void vf_store_masked(float* p, vf a, vm m) {
+    // The z-buffer is padded, so a read-modify-write of the whole vector stays in bounds
+    _mm_storeu_ps(p, _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, _mm_loadu_ps(p))));
+}
+
+static inline vi vi_load_u16(const uint16_t* p) {
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+static inline void vi_store_u16_masked(uint16_t* p, vi a, vm m) {
+    // Narrow with signed saturation around a 0x8000 bias, then blend into the old values
+    vi bias = _mm_set1_epi32(0x8000);
+    vi packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_setzero_si128()), _mm_set1_epi16((short)0x8000));
+    vi mask = _mm_packs_epi32(_mm_castps_si128(m), _mm_setzero_si128());
+    vi old = _mm_loadl_epi64((const __m128i*)p);
+    _mm_storel_epi64((__m128i*)p, _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, old)));
+}
+
+static inline vi vi_gather(const uint32_t* base, vi index, vm m) {
+    int32_t indices[LANES];
+    int32_t lanes[LANES] = { 0 };
+    int bits = vm_bits(m);
+    _mm_storeu_si128((__m128i*)indices, index);
+    for (int i = 0; i < LANES; ++i) {
+        if (bits & (1 << i)) lanes[i] = base[indices[i]];
+    }
+    return _mm_loadu_si128((const __m128i*)lanes);
+}
+
+#define DEPTH_SUFFIX f32
+#define DEPTH_ID SIMD_DEPTH_F32
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u24
+#define DEPTH_ID SIMD_DEPTH_U24
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define DEPTH_SUFFIX u16
+#define DEPTH_ID SIMD_DEPTH_U16
+#include "kernels_span_simd.h"
+#undef DEPTH_SUFFIX
+#undef DEPTH_ID
+
+#define KERNELS_TABLE kernels_sse2
+#define KERNELS_ISA "sse2"
+#include "kernels_common.h"
+
+#endif // KERNELS_X86
@@ -0,0 +1,103 @@
+#include "loader.h"
+#include "memory.h"
+#include "mesh.h"
+#include "trace.h"
+
+#include <SDL.h>
+#include <stdio.h>
+
+// Who owns staged_model: the loader thread while idle or loading, the render thread while ready
+typedef enum {
+    LOADER_IDLE,
+    LOADER_READY,       // staged_model holds a loaded model
+    LOADER_RETIRED,     // staged_model holds the model swapped out, to be released
+} loader_state_t;
+
+static SDL_Thread* loader_thread = NULL;
+static SDL_sem* loader_wake = NULL;
+static SDL_atomic_t loader_state;
+static SDL_atomic_t requested_model;    // Index in model_paths, -1: none
+static SDL_atomic_t loader_quit;
+static model_data_t staged_model;
+
+static int loader_main(void* data) {
+    (void)data;
+    // Loads run beside the frames, their allocations are not the frames'
+    exclude_thread_from_frames();
+    trace_thread_name("loader");
+    for (;;) {
+        SDL_SemWait(loader_wake);
+        if (SDL_AtomicGet(&loader_state) == LOADER_RETIRED) {
+            release_model_data(&staged_model);
+            SDL_AtomicSet(&loader_state, LOADER_IDLE);
+        }
+        if (SDL_AtomicGet(&loader_quit)) {
+            break;
+        }
+        if (SDL_AtomicGet(&loader_state) != LOADER_IDLE) {
+            continue;
+        }
+        int index = SDL_AtomicSet(&requested_model, -1);
+        if (index < 0) {
+            continue;
+        }
+        uint64_t start = SDL_GetPerformanceCounter();
+        load_model_data(index, &staged_model);
+        printf("Loaded %s in the background in %.2f ms\n", model_paths[index],
+            (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+        SDL_AtomicSet(&loader_state, LOADER_READY);
+    }
+    return 0;
+}
+
+bool start_loader() {
+    SDL_AtomicSet(&loader_state, LOADER_IDLE);
+    SDL_AtomicSet(&requested_model, -1);
+    SDL_AtomicSet(&loader_quit, 0);
+    loader_wake = SDL_CreateSemaphore(0);
+    if (!loader_wake) {
+        fprintf(stderr, "<!> Could not create the loader semaphore: %s\n", SDL_GetError());
+        return false;
+    }
+    loader_thread = SDL_CreateThread(loader_main, "loader", NULL);
+    if (!loader_thread) {
+        fprintf(stderr, "<!> Could not start the loader thread: %s\n", SDL_GetError());
+        SDL_DestroySemaphore(loader_wake);
+        loader_wake = NULL;
+        return false;
+    }
+    return true;
+}
+
+void stop_loader() {
+    if (!loader_thread) {
+        return;
+    }
+    SDL_AtomicSet(&loader_quit, 1);
+    SDL_SemPost(loader_wake);
+    SDL_WaitThread(loader_thread, NULL);
+    loader_thread = NULL;
+    SDL_DestroySemaphore(loader_wake);
+    loader_wake = NULL;
+    // A model loaded but never published
+    release_model_data(&staged_model);
+}
+
+void request_next_model() {
+    if (!loader_thread) {
+        load_next_obj_file_data();
+        return;
+    }
+    SDL_AtomicSet(&requested_model, next_model_index());
+    SDL_SemPost(loader_wake);
+}
+
+bool publish_loaded_model() {
+    if (!loader_thread || SDL_AtomicGet(&loader_state) != LOADER_READY) {
+        return false;
+    }
+    swap_model_data(&staged_model);
+    SDL_AtomicSet(&loader_state, LOADER_RETIRED);
+    SDL_SemPost(loader_wake);
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef PK_LOADER_H
+#define PK_LOADER_H
+
+#include <stdbool.h>
+
+/*******************************************************/
+/* Background model loading: a loader thread loads the */
+/* requested model beside the one in use, the render   */
+/* thread swaps it in between two frames and hands the */
+/* previous one back to the loader thread to be kept   */
+/* resident or freed.                                  */
+/* Nothing in use is touched while a load runs.        */
+/*******************************************************/
+bool start_loader();
+// Waits for a running load, frees what the loader thread still holds
+void stop_loader();
+
+// Loads the next model of model_paths in the background; only the last of several requests is loaded
+void request_next_model();
+// Between two frames on the render thread: puts a loaded model in use, true when it did
+bool publish_loaded_model();
+
+#endif // PK_LOADER_H
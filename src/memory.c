@@ -0,0 +1,157 @@
+#include "memory.h"
+#include "thread_local.h"
+
+#include <SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frames after a restart that may still allocate: the first frame sizes the stage outputs,
+// and every frame buffer set makes its first trip through the clear worker
+#define ALLOCATION_WARMUP_FRAMES 4
+
+// Keeps the block behind it aligned like malloc's
+typedef union {
+    struct {
+        size_t size;
+        memory_tag_t tag;
+    } info;
+    long double align;
+} memory_header_t;
+
+bool allocation_guard = false;
+
+static memory_usage_t usage[MEMORY_TAG_COUNT];
+static SDL_SpinLock usage_lock;
+
+static SDL_atomic_t steady_frame;
+static int warmup_frames_left = ALLOCATION_WARMUP_FRAMES;
+static uint64_t frame_number = 0;
+static uint64_t steady_allocations = 0;
+static THREAD_LOCAL bool thread_off_frame = false;
+
+static const char* tag_names[MEMORY_TAG_COUNT] = {
+    "arrays", "frame_buffers", "textures", "png", "debug",
+};
+
+const char* memory_tag_name(memory_tag_t tag) {
+    return tag_names[tag];
+}
+
+// Counts a block of size bytes replacing one of old_size bytes (0: a new block)
+static void count_allocation(memory_tag_t tag, size_t size, size_t old_size) {
+    SDL_AtomicLock(&usage_lock);
+    memory_usage_t* u = &usage[tag];
+    u->bytes += size - old_size;
+    if (u->bytes > u->peak_bytes) {
+        u->peak_bytes = u->bytes;
+    }
+    u->allocations++;
+    bool steady = !thread_off_frame && SDL_AtomicGet(&steady_frame) != 0;
+    if (steady) {
+        steady_allocations++;
+    }
+    SDL_AtomicUnlock(&usage_lock);
+
+    if (steady && allocation_guard) {
+        fprintf(stderr, "<!> Allocation of %zu bytes (%s) in steady state frame %llu.\n",
+            size, tag_names[tag], (unsigned long long)frame_number);
+        abort();
+    }
+}
+
+void* memory_alloc(memory_tag_t tag, size_t size) {
+    memory_header_t* header = (memory_header_t*)malloc(sizeof(memory_header_t) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.tag = tag;
+    count_allocation(tag, size, 0);
+    return header + 1;
+}
+
+void* memory_calloc(memory_tag_t tag, size_t count, size_t size) {
+    if (size != 0 && count > ((size_t)-1 - sizeof(memory_header_t)) / size) {
+        return NULL;
+    }
+    void* block = memory_alloc(tag, count * size);
+    if (block) {
+        memset(block, 0, count * size);
+    }
+    return block;
+}
+
+void* memory_realloc(memory_tag_t tag, void* block, size_t size) {
+    if (!block) {
+        return memory_alloc(tag, size);
+    }
+    memory_header_t* header = (memory_header_t*)block - 1;
+    size_t old_size = header->info.size;
+    memory_tag_t old_tag = header->info.tag;
+    header = (memory_header_t*)realloc(header, sizeof(memory_header_t) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->info.size = size;
+    count_allocation(old_tag, size, old_size);
+    return header + 1;
+}
+
+void memory_free(void* block) {
+    if (!block) {
+        return;
+    }
+    memory_header_t* header = (memory_header_t*)block - 1;
+    SDL_AtomicLock(&usage_lock);
+    usage[header->info.tag].bytes -= header->info.size;
+    usage[header->info.tag].frees++;
+    SDL_AtomicUnlock(&usage_lock);
+    free(header);
+}
+
+memory_usage_t memory_usage(memory_tag_t tag) {
+    SDL_AtomicLock(&usage_lock);
+    memory_usage_t u = usage[tag];
+    SDL_AtomicUnlock(&usage_lock);
+    return u;
+}
+
+void begin_allocation_frame() {
+    frame_number++;
+    if (warmup_frames_left > 0) {
+        warmup_frames_left--;
+        return;
+    }
+    SDL_AtomicSet(&steady_frame, 1);
+}
+
+void end_allocation_frame() {
+    SDL_AtomicSet(&steady_frame, 0);
+}
+
+void exclude_thread_from_frames() {
+    thread_off_frame = true;
+}
+
+void restart_allocation_warmup() {
+    warmup_frames_left = ALLOCATION_WARMUP_FRAMES;
+}
+
+uint64_t steady_frame_allocations() {
+    SDL_AtomicLock(&usage_lock);
+    uint64_t count = steady_allocations;
+    SDL_AtomicUnlock(&usage_lock);
+    return count;
+}
+
+void print_memory_report() {
+    printf("Memory          live KB     peak KB  allocations      frees\n");
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        memory_usage_t u = memory_usage(tag);
+        printf("%-13s %9.1f %11.1f %12llu %10llu\n", tag_names[tag], u.bytes / 1024.0, u.peak_bytes / 1024.0,
+            (unsigned long long)u.allocations, (unsigned long long)u.frees);
+    }
+    printf("Steady state frame allocations: %llu\n", (unsigned long long)steady_frame_allocations());
+}
@@ -0,0 +1,58 @@
+#ifndef PK_MEMORY_H
+#define PK_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Owners of the allocations, counted separately
+typedef enum {
+    MEMORY_ARRAYS,          // Stretchy arrays: meshes and the per-stage outputs
+    MEMORY_FRAME_BUFFERS,   // Color and depth buffers, detile buffer
+    MEMORY_TEXTURES,        // Textures converted to the color buffer layout
+    MEMORY_PNG,             // upng decoder buffers
+    MEMORY_DEBUG,           // Trace ring buffers, overdraw buffers
+    MEMORY_TAG_COUNT,
+} memory_tag_t;
+
+typedef struct {
+    size_t bytes;           // Live
+    size_t peak_bytes;
+    uint64_t allocations;   // Calls that returned memory, reallocs included
+    uint64_t frees;
+} memory_usage_t;
+
+/*******************************************************/
+/* Thin layer over malloc: every block carries its     */
+/* size and tag in a small header, so the usage of     */
+/* each tag is known at any time.                      */
+/*******************************************************/
+void* memory_alloc(memory_tag_t tag, size_t size);
+void* memory_calloc(memory_tag_t tag, size_t count, size_t size);
+// A block keeps the tag it was allocated with, tag only applies to a NULL block
+void* memory_realloc(memory_tag_t tag, void* block, size_t size);
+void memory_free(void* block);
+
+memory_usage_t memory_usage(memory_tag_t tag);
+const char* memory_tag_name(memory_tag_t tag);
+
+/*******************************************************/
+/* Steady state: the frames after a short warmup must  */
+/* not allocate. Allocations from any thread between   */
+/* begin and end of such a frame are counted, and      */
+/* abort the program when allocation_guard is set.     */
+/*******************************************************/
+extern bool allocation_guard;
+
+void begin_allocation_frame();
+void end_allocation_frame();
+// Allocations of the calling thread are never counted as a frame's, for threads working beside the frames
+void exclude_thread_from_frames();
+// Loading a mesh or changing the draw mode may allocate, the next frames are warmup again
+void restart_allocation_warmup();
+uint64_t steady_frame_allocations();
+
+// Usage per tag and the steady state allocations, to stdout
+void print_memory_report();
+
+#endif // PK_MEMORY_H
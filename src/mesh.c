@@ -1,9 +1,15 @@
 #include "mesh.h"
 #include "array.h"
+#include "asset_cache.h"
+#include "memory.h"
+#include "obj.h"
+#include "resident.h"
 #include "texture.h"
+#include "trace.h"
 #include "triangle.h"
 #include "vector.h"
 
+#include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,7 +33,7 @@ vec3_t cube_vertices[N_CUBE_VERTICES] = {
     { .x = -1, .y = -1, .z =  1 }, // 8
 };
 
-face_t cube_faces[N_CUBE_FACES] = {
+cube_face_t cube_faces[N_CUBE_FACES] = {
     // front
     { .a = 1, .b = 2, .c = 3, .a_uv = { 0, 0 }, .b_uv = { 0, 1 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
     { .a = 1, .b = 3, .c = 4, .a_uv = { 0, 0 }, .b_uv = { 1, 1 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
@@ -48,77 +54,105 @@ face_t cube_faces[N_CUBE_FACES] = {
     { .a = 6, .b = 1, .c = 4, .a_uv = { 0, 0 }, .b_uv = { 1, 1 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF }
 };
 
+void free_mesh_geometry(mesh_t* target) {
+    if (target->cache.data) {
+        unmap_file(&target->cache);
+    } else {
+        array_free(target->vertices);
+        array_free(target->tex_coords);
+        array_free(target->normals);
+        array_free(target->faces);
+    }
+    target->vertices = NULL;
+    target->tex_coords = NULL;
+    target->normals = NULL;
+    target->faces = NULL;
+    target->source[0] = '\0';
+}
+
+void free_mesh_data() {
+    free_mesh_geometry(&mesh);
+}
+
 void load_cube_mesh_data() {
-    array_free(mesh.vertices); mesh.vertices = NULL;
-    array_free(mesh.faces); mesh.faces = NULL;
+    free_mesh_data();
 
-    for (int i = 0; i < N_CUBE_VERTICES; ++i) {
-        array_push(mesh.vertices, cube_vertices[i]);
-    }
+    // Every corner gets its own vertex, the texture coordinates differ from face to face
     for (int i = 0; i < N_CUBE_FACES; ++i) {
-        array_push(mesh.faces, cube_faces[i]);
+        const cube_face_t* cube_face = &cube_faces[i];
+        int corners[3] = { cube_face->a, cube_face->b, cube_face->c };
+        tex2_t uvs[3] = { cube_face->a_uv, cube_face->b_uv, cube_face->c_uv };
+        for (int k = 0; k < 3; ++k) {
+            vec3_t normal = { 0, 0, 0 };
+            array_push(mesh.vertices, cube_vertices[corners[k] - 1]);
+            array_push(mesh.tex_coords, uvs[k]);
+            array_push(mesh.normals, normal);
+        }
+        face_t face = { .a = i * 3, .b = i * 3 + 1, .c = i * 3 + 2, .color = cube_face->color };
+        array_push(mesh.faces, face);
     }
 }
 
-void load_obj_file_data(const char* path) {
-    FILE* fd;
-    fd = fopen(path, "r");
-    if (fd == NULL) {
-        fprintf(stderr, "Could not open the file '%s'", path);
+// A stored face pointing outside the vertices would be read unchecked by the pipeline every frame
+static bool faces_in_range(const face_t* faces, int face_count, int vertex_count) {
+    for (int i = 0; i < face_count; ++i) {
+        if ((unsigned)faces[i].a >= (unsigned)vertex_count || (unsigned)faces[i].b >= (unsigned)vertex_count ||
+            (unsigned)faces[i].c >= (unsigned)vertex_count) {
+            return false;
+        }
     }
+    return true;
+}
 
-    array_free(mesh.vertices); mesh.vertices = NULL;
-    array_free(mesh.faces); mesh.faces = NULL;
-
-    const size_t buffer_length = 1024;
-    char buffer[1024];
-    size_t read_len;
-
-    tex2_t* tex_coords = NULL;
-    while (fgets(buffer, buffer_length, fd)) {
-
-        // Vertices
-        if (strncmp(buffer, "v ", 2) == 0) {
-            vec3_t vertex;
-            sscanf(buffer, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh.vertices, vertex);
-            continue;
-        }
+static bool load_mesh_cache(const char* path, mesh_t* target) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (!open_asset_cache(path, ASSET_CACHE_MESH, &target->cache)) {
+        return false;
+    }
+    asset_cache_section_t vertices = asset_cache_section(&target->cache, 0);
+    asset_cache_section_t tex_coords = asset_cache_section(&target->cache, 1);
+    asset_cache_section_t normals = asset_cache_section(&target->cache, 2);
+    asset_cache_section_t faces = asset_cache_section(&target->cache, 3);
+    target->vertices = array_from_stored(vertices.data, vertices.size, sizeof(vec3_t));
+    target->tex_coords = array_from_stored(tex_coords.data, tex_coords.size, sizeof(tex2_t));
+    target->normals = array_from_stored(normals.data, normals.size, sizeof(vec3_t));
+    target->faces = array_from_stored(faces.data, faces.size, sizeof(face_t));
+    int vertex_count = array_length(target->vertices);
+    if (!target->vertices || !target->faces || array_length(target->tex_coords) != vertex_count || array_length(target->normals) != vertex_count ||
+        !faces_in_range(target->faces, array_length(target->faces), vertex_count)) {
+        fprintf(stderr, "<!> The cache of %s is damaged, it will be rebuilt.\n", path);
+        free_mesh_geometry(target);
+        return false;
+    }
+    printf("Loaded %d vertices and %d triangles from the cache in %.2f ms\n", vertex_count, array_length(target->faces),
+        (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+    return true;
+}
 
-        // Texture coordinates
-        if (strncmp(buffer, "vt ", 3) == 0) {
-            tex2_t tex_coord = { .u = 0, .v = 0 };
-            sscanf(buffer, "vt %f %f", &tex_coord.u, &tex_coord.v);
-            array_push(tex_coords, tex_coord);
-            continue;
-        }
+static void write_mesh_cache(const char* path, const mesh_t* source) {
+    asset_cache_section_t sections[4];
+    sections[0].data = array_stored(source->vertices, sizeof(vec3_t), &sections[0].size);
+    sections[1].data = array_stored(source->tex_coords, sizeof(tex2_t), &sections[1].size);
+    sections[2].data = array_stored(source->normals, sizeof(vec3_t), &sections[2].size);
+    sections[3].data = array_stored(source->faces, sizeof(face_t), &sections[3].size);
+    write_asset_cache(path, ASSET_CACHE_MESH, NULL, sections, 4);
+}
 
-        // Faces
-        if (strncmp(buffer, "f ", 2) == 0) {
-            int _;
-            int face_index_a, face_index_b, face_index_c;
-            int tex_index_a, tex_index_b, tex_index_c;
-            sscanf(buffer, "f %d/%d/%d %d/%d/%d %d/%d/%d", 
-                &face_index_a, &tex_index_a, &_,
-                &face_index_b, &tex_index_b, &_,
-                &face_index_c, &tex_index_c, &_
-            );
-            face_t face = {
-                .color = 0xFFEEEEEE,
-            
-                .a = face_index_a - 1,
-                .b = face_index_b - 1,
-                .c = face_index_c - 1,
-
-                .a_uv = tex_coords[tex_index_a - 1],
-                .b_uv = tex_coords[tex_index_b - 1],
-                .c_uv = tex_coords[tex_index_c - 1],
-            };
-            array_push(mesh.faces, face);
-            continue;
-        }
+bool load_mesh_geometry(const char* path, mesh_t* target) {
+    snprintf(target->source, sizeof(target->source), "%s", path);
+    if (load_mesh_cache(path, target)) {
+        return true;
+    }
+    if (!load_obj_file(path, target)) {
+        return false;
     }
-    array_free(tex_coords);
+    write_mesh_cache(path, target);
+    return true;
+}
+
+void load_obj_file_data(const char* path) {
+    free_mesh_data();
+    load_mesh_geometry(path, &mesh);
 }
 
 const char* model_paths[] = {
@@ -137,16 +171,63 @@ const char* model_paths[] = {
     NULL
 };
 int  current_model_index = 0;
-void load_next_obj_file_data() {
+
+int next_model_index() {
     if (model_paths[current_model_index] == NULL) {
         current_model_index = 0;
     }
+    return current_model_index++;
+}
+
+void load_model_data(int index, model_data_t* model) {
+    load_named_model_data(model_paths[index], model);
+}
+
+// Touches nothing in use, so it may run on any thread
+void load_named_model_data(const char* name, model_data_t* model) {
+    memset(model, 0, sizeof(*model));
     char file_path[1024];
-    sprintf(file_path, "./assets/models/%s.obj", model_paths[current_model_index]);
+    snprintf(file_path, sizeof(file_path), "./assets/models/%s.obj", name);
     fprintf(stdout, "Model loading from: %s\n", file_path);
-    load_obj_file_data(file_path);
+    uint64_t load_start = trace_begin();
+    if (!take_resident_mesh(file_path, &model->geometry)) {
+        load_mesh_geometry(file_path, &model->geometry);
+    }
+    trace_end("load_obj", load_start);
 
-    sprintf(file_path, "./assets/models/%s.png", model_paths[current_model_index]);
-    load_png_texture_data(file_path);
-    ++current_model_index;
+    snprintf(file_path, sizeof(file_path), "./assets/models/%s.png", name);
+    load_start = trace_begin();
+    if (!take_resident_texture(file_path, &model->texture)) {
+        load_texture(file_path, &model->texture);
+    }
+    trace_end("load_png", load_start);
+}
+
+void swap_model_data(model_data_t* model) {
+    mesh_t previous = mesh;
+    mesh.vertices = model->geometry.vertices;
+    mesh.tex_coords = model->geometry.tex_coords;
+    mesh.normals = model->geometry.normals;
+    mesh.faces = model->geometry.faces;
+    mesh.cache = model->geometry.cache;
+    memcpy(mesh.source, model->geometry.source, sizeof(mesh.source));
+    model->geometry = previous;
+    if (model->texture.pixels) {
+        swap_texture(&model->texture);
+    }
+
+    // The next frames size the stage outputs for the new mesh
+    restart_allocation_warmup();
+}
+
+void release_model_data(model_data_t* model) {
+    keep_resident_mesh(&model->geometry);
+    keep_resident_texture(&model->texture);
+}
+
+void load_next_obj_file_data() {
+    model_data_t model;
+    load_model_data(next_model_index(), &model);
+    swap_model_data(&model);
+    release_model_data(&model);
 }
@@ -1,15 +1,24 @@
 #ifndef PK_MESH_H
 #define PK_MESH_H
 
-#include "vector.h"
+#include "file_map.h"
+#include "texture.h"
 #include "triangle.h"
+#include "vector.h"
+
+#include <stdbool.h>
 
 #define N_CUBE_VERTICES 8
 #define N_CUBE_FACES (6 * 2) // 6 cube faces, 2 triangles per face
 
+// Indexed vertices: a position, texture coordinates and a normal each
 typedef struct {
     vec3_t* vertices;
+    tex2_t* tex_coords;
+    vec3_t* normals;    // Zero when the model has none
     face_t* faces;
+    mapped_file_t cache;    // Backing of the arrays when they were loaded from the cache
+    char source[256];       // File loaded from, empty for a built in mesh
     vec3_t rotation;
     vec3_t scale;
     vec3_t translation;
@@ -17,12 +26,40 @@ typedef struct {
 
 extern mesh_t mesh;
 
+// A cube face: corners index cube_vertices from 1, with their texture coordinates
+typedef struct {
+    int a, b, c;
+    tex2_t a_uv, b_uv, c_uv;
+    uint32_t color;
+} cube_face_t;
+
 extern vec3_t cube_vertices[N_CUBE_VERTICES];
-extern face_t cube_faces[N_CUBE_FACES];
+extern cube_face_t cube_faces[N_CUBE_FACES];
 void load_cube_mesh_data();
 void load_obj_file_data(const char* path);
+void free_mesh_data();
+
+// Maps the cache of the OBJ file when it is up to date, parses the file and writes the cache otherwise;
+// only the geometry of target is set
+bool load_mesh_geometry(const char* path, mesh_t* target);
+void free_mesh_geometry(mesh_t* target);
+
+// A model of model_paths, loaded beside the one in use or out of use
+typedef struct {
+    mesh_t geometry;
+    texture_t texture;      // No pixels when the model has no texture
+} model_data_t;
 
 extern const char* model_paths[];
 extern int current_model_index;
+// Index in model_paths of the model after the last one loaded
+int next_model_index();
+void load_model_data(int index, model_data_t* model);
+// The model in assets/models/<name>.obj and .png, whether it is in model_paths or not
+void load_named_model_data(const char* name, model_data_t* model);
+// Puts the model in use, the previous texture stays when it has none; model gets what was in use
+void swap_model_data(model_data_t* model);
+// Gives what model holds to the resident assets
+void release_model_data(model_data_t* model);
 void load_next_obj_file_data();
 #endif // PK_MESH_H
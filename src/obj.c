@@ -0,0 +1,562 @@
+#include "obj.h"
+#include "array.h"
+#include "file_map.h"
+
+#include <SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Bytes per chunk below which more threads do not pay off, and the most chunks of a file
+#define OBJ_CHUNK_SIZE (256 * 1024)
+#define OBJ_MAX_CHUNKS 32
+
+typedef enum {
+    OBJ_PASS_COUNT,     // Count the lines of each kind and the face corners
+    OBJ_PASS_PARSE,     // Parse them into the arrays, at the offsets of the chunk
+} obj_pass_t;
+
+// Corner of a face: 0-based indices into the v, vt and vn lines, -1 when missing
+typedef struct {
+    int position;
+    int tex_coord;
+    int normal;
+} obj_corner_t;
+
+typedef struct obj_parse_t obj_parse_t;
+
+typedef struct {
+    obj_parse_t* parse;
+    const char* begin;      // Whole lines, begin to end
+    const char* end;
+    int position_count;
+    int tex_coord_count;
+    int normal_count;
+    int face_count;
+    int corner_count;
+    int first_position;     // Where the lines of the chunk go in the arrays
+    int first_tex_coord;
+    int first_normal;
+    int first_face;
+    int first_corner;
+    const char* error;      // First problem found, NULL when there is none
+    const char* error_at;   // Line of the problem
+} obj_chunk_t;
+
+struct obj_parse_t {
+    obj_pass_t pass;
+    vec3_t* positions;
+    tex2_t* tex_coords;
+    vec3_t* normals;
+    obj_corner_t* corners;
+    int* face_sizes;        // Corners of every face, they follow each other in corners
+    int position_count;
+    int tex_coord_count;
+    int normal_count;
+    int face_count;
+    int corner_count;
+    int chunk_count;
+    obj_chunk_t chunks[OBJ_MAX_CHUNKS];
+};
+
+typedef enum {
+    LINE_OTHER,
+    LINE_POSITION,
+    LINE_TEX_COORD,
+    LINE_NORMAL,
+    LINE_FACE,
+} line_type_t;
+
+/*******************************************************/
+/* Scanner: every function reads within the line, up   */
+/* to line_end, and moves the cursor past what it has  */
+/* read.                                               */
+/*******************************************************/
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_digit(char c) {
+    return (unsigned)(c - '0') < 10;
+}
+
+static inline const char* skip_blanks(const char* p, const char* line_end) {
+    while (p < line_end && is_blank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static inline const char* find_line_end(const char* p, const char* end) {
+    const char* line_end = (const char*)memchr(p, '\n', end - p);
+    return line_end ? line_end : end;
+}
+
+// Classifies the line and moves the cursor past its keyword
+static inline line_type_t read_line_type(const char** cursor, const char* line_end) {
+    const char* p = skip_blanks(*cursor, line_end);
+    line_type_t type = LINE_OTHER;
+    if (line_end - p >= 2 && p[0] == 'v' && is_blank(p[1])) {
+        type = LINE_POSITION;
+        p += 2;
+    } else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 't' && is_blank(p[2])) {
+        type = LINE_TEX_COORD;
+        p += 3;
+    } else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 'n' && is_blank(p[2])) {
+        type = LINE_NORMAL;
+        p += 3;
+    } else if (line_end - p >= 2 && p[0] == 'f' && is_blank(p[1])) {
+        type = LINE_FACE;
+        p += 2;
+    }
+    *cursor = p;
+    return type;
+}
+
+// Exact powers of ten as doubles, a division by one of them rounds correctly
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// [+-]digits[.digits][(e|E)[+-]digits], followed by a blank or the end of the line
+static bool read_float(const char** cursor, const char* line_end, float* value) {
+    const char* p = skip_blanks(*cursor, line_end);
+    bool negative = false;
+    if (p < line_end && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    // Up to 19 significant digits are kept, the rest only move the exponent
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; p < line_end && is_digit(*p); ++p, ++digits) {
+        if (mantissa < 1000000000000000000ull) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (p < line_end && *p == '.') {
+        for (++p; p < line_end && is_digit(*p); ++p, ++digits) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (p < line_end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negative_exponent = false;
+        if (p < line_end && (*p == '-' || *p == '+')) {
+            negative_exponent = *p++ == '-';
+        }
+        if (p == line_end || !is_digit(*p)) {
+            return false;
+        }
+        int e = 0;
+        for (; p < line_end && is_digit(*p); ++p) {
+            if (e < 10000) {
+                e = e * 10 + (*p - '0');
+            }
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+    if (p < line_end && !is_blank(*p)) {
+        return false;
+    }
+
+    double result = (double)mantissa;
+    if (mantissa != 0) {
+        if (exponent < 0) {
+            result = exponent >= -22 ? result / powers_of_ten[-exponent] : result * pow(10.0, exponent);
+        } else if (exponent > 0) {
+            result = exponent <= 22 ? result * powers_of_ten[exponent] : result * pow(10.0, exponent);
+        }
+    }
+    *value = (float)(negative ? -result : result);
+    *cursor = p;
+    return true;
+}
+
+// Signed decimal index, no delimiter check: a face corner goes on with '/'
+static bool read_index(const char** cursor, const char* line_end, int* value) {
+    const char* p = *cursor;
+    bool negative = p < line_end && *p == '-';
+    if (negative) {
+        ++p;
+    }
+    if (p == line_end || !is_digit(*p)) {
+        return false;
+    }
+    int index = 0;
+    for (; p < line_end && is_digit(*p); ++p) {
+        if (index > (INT32_MAX - 9) / 10) {
+            return false;
+        }
+        index = index * 10 + (*p - '0');
+    }
+    *value = negative ? -index : index;
+    *cursor = p;
+    return true;
+}
+
+// Turns a 1-based index, or a negative one counting back from the last line read, into a
+// 0-based one; false when it is 0 or out of range
+static inline bool resolve_index(int index, int read, int total, int* resolved) {
+    *resolved = index > 0 ? index - 1 : read + index;
+    return index != 0 && *resolved >= 0 && *resolved < total;
+}
+
+// One corner of a face: v, v/vt, v//vn or v/vt/vn
+static bool read_face_corner(const char** cursor, const char* line_end, int* position, int* tex_coord, int* normal) {
+    const char* p = *cursor;
+    *tex_coord = 0;
+    *normal = 0;
+    if (!read_index(&p, line_end, position)) {
+        return false;
+    }
+    if (p < line_end && *p == '/') {
+        ++p;
+        if (p < line_end && *p != '/' && !read_index(&p, line_end, tex_coord)) {
+            return false;
+        }
+        if (p < line_end && *p == '/') {
+            ++p;
+            if (!read_index(&p, line_end, normal)) {
+                return false;
+            }
+        }
+    }
+    if (p < line_end && !is_blank(*p)) {
+        return false;
+    }
+    *cursor = p;
+    return true;
+}
+
+// Number of blank separated words up to the end of the line
+static inline int count_words(const char* p, const char* line_end) {
+    int count = 0;
+    while ((p = skip_blanks(p, line_end)) < line_end) {
+        count++;
+        while (p < line_end && !is_blank(*p)) {
+            ++p;
+        }
+    }
+    return count;
+}
+
+/*******************************************************/
+/* Passes, each one runs on every chunk at once        */
+/*******************************************************/
+static void count_chunk(obj_chunk_t* chunk) {
+    for (const char* line = chunk->begin; line < chunk->end; ) {
+        const char* line_end = find_line_end(line, chunk->end);
+        const char* cursor = line;
+        switch (read_line_type(&cursor, line_end)) {
+            case LINE_POSITION: chunk->position_count++; break;
+            case LINE_TEX_COORD: chunk->tex_coord_count++; break;
+            case LINE_NORMAL: chunk->normal_count++; break;
+            case LINE_FACE:
+                chunk->face_count++;
+                chunk->corner_count += count_words(cursor, line_end);
+                break;
+            case LINE_OTHER: break;
+        }
+        line = line_end + 1;
+    }
+}
+
+static void parse_chunk(obj_chunk_t* chunk) {
+    obj_parse_t* parse = chunk->parse;
+    vec3_t* position = parse->positions + chunk->first_position;
+    tex2_t* tex_coord = parse->tex_coords + chunk->first_tex_coord;
+    vec3_t* normal = parse->normals + chunk->first_normal;
+    obj_corner_t* corner = parse->corners + chunk->first_corner;
+    int* face_size = parse->face_sizes + chunk->first_face;
+
+    for (const char* line = chunk->begin; line < chunk->end; ) {
+        const char* line_end = find_line_end(line, chunk->end);
+        const char* cursor = line;
+        const char* error = NULL;
+        switch (read_line_type(&cursor, line_end)) {
+            case LINE_POSITION:
+                // A fourth coordinate or a vertex color may follow, it is not used
+                if (!read_float(&cursor, line_end, &position->x) ||
+                    !read_float(&cursor, line_end, &position->y) ||
+                    !read_float(&cursor, line_end, &position->z)) {
+                    error = "malformed vertex";
+                }
+                position++;
+                break;
+            case LINE_TEX_COORD:
+                tex_coord->v = 0;
+                if (!read_float(&cursor, line_end, &tex_coord->u) ||
+                    (skip_blanks(cursor, line_end) < line_end && !read_float(&cursor, line_end, &tex_coord->v))) {
+                    error = "malformed texture coordinate";
+                }
+                tex_coord++;
+                break;
+            case LINE_NORMAL:
+                if (!read_float(&cursor, line_end, &normal->x) ||
+                    !read_float(&cursor, line_end, &normal->y) ||
+                    !read_float(&cursor, line_end, &normal->z)) {
+                    error = "malformed normal";
+                }
+                normal++;
+                break;
+            case LINE_FACE: {
+                // Negative indices count back from the lines read so far, in the whole file
+                int positions_read = (int)(position - parse->positions);
+                int tex_coords_read = (int)(tex_coord - parse->tex_coords);
+                int normals_read = (int)(normal - parse->normals);
+                int size = 0;
+                while ((cursor = skip_blanks(cursor, line_end)) < line_end) {
+                    int p, t, n;
+                    if (!read_face_corner(&cursor, line_end, &p, &t, &n)) {
+                        error = "malformed face";
+                        break;
+                    }
+                    if (!resolve_index(p, positions_read, parse->position_count, &corner->position)) {
+                        error = "vertex index out of range";
+                        break;
+                    }
+                    // Some exporters write normal indices into files without normals, they are dropped
+                    corner->tex_coord = -1;
+                    corner->normal = -1;
+                    if ((t && !resolve_index(t, tex_coords_read, parse->tex_coord_count, &corner->tex_coord)) ||
+                        (n && parse->normal_count && !resolve_index(n, normals_read, parse->normal_count, &corner->normal))) {
+                        error = "texture coordinate or normal index out of range";
+                        break;
+                    }
+                    corner++;
+                    size++;
+                }
+                if (!error && size < 3) {
+                    error = "face with less than 3 vertices";
+                }
+                *face_size++ = size;
+                break;
+            }
+            case LINE_OTHER:
+                break;
+        }
+        if (error) {
+            chunk->error = error;
+            chunk->error_at = line;
+            return;
+        }
+        line = line_end + 1;
+    }
+}
+
+static int run_chunk(void* data) {
+    obj_chunk_t* chunk = (obj_chunk_t*)data;
+    switch (chunk->parse->pass) {
+        case OBJ_PASS_COUNT: count_chunk(chunk); break;
+        case OBJ_PASS_PARSE: parse_chunk(chunk); break;
+    }
+    return 0;
+}
+
+// Runs the pass on a thread per chunk, the first chunk on the calling thread
+static void run_pass(obj_parse_t* parse, obj_pass_t pass) {
+    parse->pass = pass;
+    SDL_Thread* threads[OBJ_MAX_CHUNKS] = { NULL };
+    for (int i = 1; i < parse->chunk_count; ++i) {
+        threads[i] = SDL_CreateThread(run_chunk, "obj", &parse->chunks[i]);
+        if (!threads[i]) {
+            run_chunk(&parse->chunks[i]);
+        }
+    }
+    run_chunk(&parse->chunks[0]);
+    for (int i = 1; i < parse->chunk_count; ++i) {
+        if (threads[i]) {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+}
+
+// Prints the first problem of the pass, false when there is one
+static bool check_pass(const obj_parse_t* parse, const char* path, const char* data) {
+    for (int i = 0; i < parse->chunk_count; ++i) {
+        const obj_chunk_t* chunk = &parse->chunks[i];
+        if (!chunk->error) {
+            continue;
+        }
+        int line = 1;
+        for (const char* p = data; (p = memchr(p, '\n', chunk->error_at - p)) != NULL; ++p) {
+            line++;
+        }
+        fprintf(stderr, "<!> %s:%d: %s.\n", path, line, chunk->error);
+        return false;
+    }
+    return true;
+}
+
+// Cuts the file into chunk_count pieces of about the same size that end after a newline
+static void split_chunks(obj_parse_t* parse, const char* data, size_t size) {
+    int chunk_count = (int)(size / OBJ_CHUNK_SIZE);
+    int cpu_count = SDL_GetCPUCount();
+    if (chunk_count > cpu_count) chunk_count = cpu_count;
+    if (chunk_count > OBJ_MAX_CHUNKS) chunk_count = OBJ_MAX_CHUNKS;
+    if (chunk_count < 1) chunk_count = 1;
+
+    const char* end = data + size;
+    const char* begin = data;
+    for (int i = 0; i < chunk_count; ++i) {
+        const char* chunk_end = end;
+        if (i < chunk_count - 1) {
+            chunk_end = data + size * (i + 1) / chunk_count;
+            if (chunk_end < begin) {
+                chunk_end = begin;
+            }
+            const char* newline = chunk_end < end ? (const char*)memchr(chunk_end, '\n', end - chunk_end) : NULL;
+            chunk_end = newline ? newline + 1 : end;
+        }
+        parse->chunks[i] = (obj_chunk_t){ .parse = parse, .begin = begin, .end = chunk_end };
+        begin = chunk_end;
+    }
+    parse->chunk_count = chunk_count;
+}
+
+static inline uint32_t hash_corner(const obj_corner_t* corner) {
+    uint32_t hash = (uint32_t)corner->position * 0x9E3779B1u;
+    hash ^= (uint32_t)corner->tex_coord * 0x85EBCA77u;
+    hash ^= (uint32_t)corner->normal * 0xC2B2AE3Du;
+    return hash ^ (hash >> 15);
+}
+
+static inline bool same_corner(const obj_corner_t* a, const obj_corner_t* b) {
+    return a->position == b->position && a->tex_coord == b->tex_coord && a->normal == b->normal;
+}
+
+/*******************************************************/
+/* Welding: every distinct (v, vt, vn) of the corners  */
+/* becomes one mesh vertex, and the faces are fanned   */
+/* into triangles over the vertex indices.             */
+/*******************************************************/
+static void weld_corners(const obj_parse_t* parse, mesh_t* mesh) {
+    // Open addressing, at most half full; a slot keeps its corner to compare without a second lookup
+    typedef struct {
+        obj_corner_t corner;
+        int vertex;     // -1 when the slot is empty
+    } weld_slot_t;
+    int table_size = 16;
+    while (table_size < parse->corner_count * 2) {
+        table_size *= 2;
+    }
+    weld_slot_t* table = array_hold(NULL, table_size, sizeof(weld_slot_t));
+    memset(table, 0xFF, table_size * sizeof(weld_slot_t));
+    int* corner_vertices = array_hold(NULL, parse->corner_count, sizeof(int));
+    int* first_corners = array_hold(NULL, parse->corner_count, sizeof(int));
+    int vertex_count = 0;
+
+    for (int i = 0; i < parse->corner_count; ++i) {
+        const obj_corner_t* corner = &parse->corners[i];
+        uint32_t slot = hash_corner(corner) & (table_size - 1);
+        while (table[slot].vertex >= 0 && !same_corner(&table[slot].corner, corner)) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot].vertex < 0) {
+            table[slot].corner = *corner;
+            table[slot].vertex = vertex_count;
+            first_corners[vertex_count++] = i;
+        }
+        corner_vertices[i] = table[slot].vertex;
+    }
+
+    mesh->vertices = array_hold(NULL, vertex_count, sizeof(vec3_t));
+    mesh->tex_coords = array_hold(NULL, vertex_count, sizeof(tex2_t));
+    mesh->normals = array_hold(NULL, vertex_count, sizeof(vec3_t));
+    for (int i = 0; i < vertex_count; ++i) {
+        const obj_corner_t* corner = &parse->corners[first_corners[i]];
+        mesh->vertices[i] = parse->positions[corner->position];
+        mesh->tex_coords[i] = corner->tex_coord >= 0 ? parse->tex_coords[corner->tex_coord] : (tex2_t){ 0, 0 };
+        mesh->normals[i] = corner->normal >= 0 ? parse->normals[corner->normal] : (vec3_t){ 0, 0, 0 };
+    }
+
+    // A face of n corners makes n - 2 triangles, all sharing its first corner
+    mesh->faces = array_hold(NULL, parse->corner_count - 2 * parse->face_count, sizeof(face_t));
+    face_t* triangle = mesh->faces;
+    const int* corner = corner_vertices;
+    for (int f = 0; f < parse->face_count; ++f) {
+        int size = parse->face_sizes[f];
+        for (int k = 1; k < size - 1; ++k) {
+            *triangle++ = (face_t){ .a = corner[0], .b = corner[k], .c = corner[k + 1], .color = 0xFFEEEEEE };
+        }
+        corner += size;
+    }
+
+    array_free(table);
+    array_free(corner_vertices);
+    array_free(first_corners);
+}
+
+bool load_obj_file(const char* path, mesh_t* mesh) {
+    mesh->vertices = NULL;
+    mesh->tex_coords = NULL;
+    mesh->normals = NULL;
+    mesh->faces = NULL;
+
+    mapped_file_t file;
+    if (!map_file(path, &file)) {
+        return false;
+    }
+    uint64_t start = SDL_GetPerformanceCounter();
+    const char* data = (const char*)file.data;
+
+    obj_parse_t parse;
+    memset(&parse, 0, sizeof(parse));
+    split_chunks(&parse, data, file.size);
+    run_pass(&parse, OBJ_PASS_COUNT);
+
+    // Every chunk writes its lines right after those of the chunks before it
+    for (int i = 0; i < parse.chunk_count; ++i) {
+        obj_chunk_t* chunk = &parse.chunks[i];
+        chunk->first_position = parse.position_count;
+        chunk->first_tex_coord = parse.tex_coord_count;
+        chunk->first_normal = parse.normal_count;
+        chunk->first_face = parse.face_count;
+        chunk->first_corner = parse.corner_count;
+        parse.position_count += chunk->position_count;
+        parse.tex_coord_count += chunk->tex_coord_count;
+        parse.normal_count += chunk->normal_count;
+        parse.face_count += chunk->face_count;
+        parse.corner_count += chunk->corner_count;
+    }
+    parse.positions = array_hold(NULL, parse.position_count, sizeof(vec3_t));
+    parse.tex_coords = array_hold(NULL, parse.tex_coord_count, sizeof(tex2_t));
+    parse.normals = array_hold(NULL, parse.normal_count, sizeof(vec3_t));
+    parse.corners = array_hold(NULL, parse.corner_count, sizeof(obj_corner_t));
+    parse.face_sizes = array_hold(NULL, parse.face_count, sizeof(int));
+
+    run_pass(&parse, OBJ_PASS_PARSE);
+    bool loaded = check_pass(&parse, path, data);
+    if (loaded) {
+        weld_corners(&parse, mesh);
+    }
+
+    size_t size = file.size;
+    array_free(parse.positions);
+    array_free(parse.tex_coords);
+    array_free(parse.normals);
+    array_free(parse.corners);
+    array_free(parse.face_sizes);
+    unmap_file(&file);
+    if (!loaded) {
+        return false;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    printf("Loaded %d vertices and %d triangles, %.1f KB in %.2f ms on %d threads (%.0f MB/s)\n",
+        array_length(mesh->vertices), array_length(mesh->faces), size / 1024.0, seconds * 1000.0, parse.chunk_count,
+        seconds > 0 ? size / seconds / (1024.0 * 1024.0) : 0.0);
+    return true;
+}
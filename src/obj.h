@@ -0,0 +1,21 @@
+#ifndef PK_OBJ_H
+#define PK_OBJ_H
+
+#include "mesh.h"
+
+#include <stdbool.h>
+
+/*******************************************************/
+/* Wavefront OBJ loader: the file is memory-mapped,    */
+/* split into line-aligned chunks and parsed on one    */
+/* thread per chunk, straight into arrays sized by a   */
+/* first counting pass. Reads "v", "vt", "vn" and "f"  */
+/* lines, the rest is skipped. Polygons are fanned     */
+/* into triangles, and every distinct v/vt/vn of the   */
+/* faces becomes one indexed vertex.                   */
+/*******************************************************/
+
+// Fills the vertex and face arrays of the mesh with new ones, all NULL when the file can not be loaded
+bool load_obj_file(const char* path, mesh_t* mesh);
+
+#endif // PK_OBJ_H
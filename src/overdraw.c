@@ -0,0 +1,110 @@
+#include "overdraw.h"
+#include "display.h"
+#include "memory.h"
+#include "overlay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint16_t* overdraw_tests = NULL;
+uint16_t* overdraw_writes = NULL;
+
+static size_t overdraw_pixels = 0;
+static bool overdraw_rendered = false;
+
+// Blue for one test up to red and white for the most, black where nothing was drawn
+#define HEATMAP_LEVELS 9
+static const uint32_t heatmap_colors[HEATMAP_LEVELS] = {
+    0xFF000000, // 0
+    0xFF800000, // 1: blue (the color buffer is R, G, B, A in memory)
+    0xFFFF8000, // 2
+    0xFF00C000, // 3
+    0xFF00FFC0, // 4
+    0xFF00FFFF, // 5
+    0xFF0080FF, // 6
+    0xFF0000FF, // 7
+    0xFFFFFFFF, // 8 and more
+};
+
+// Rows of the printed histogram, the last one counts the pixels at or above it
+#define HISTOGRAM_ROWS 16
+
+bool begin_overdraw_frame() {
+    size_t pixels = framebuffer_pixel_count();
+    if (overdraw_pixels != pixels) {
+        free_overdraw_buffers();
+        overdraw_tests = (uint16_t*)memory_alloc(MEMORY_DEBUG, pixels * sizeof(uint16_t));
+        overdraw_writes = (uint16_t*)memory_alloc(MEMORY_DEBUG, pixels * sizeof(uint16_t));
+        if (!overdraw_tests || !overdraw_writes) {
+            fprintf(stderr, "<!> Could not allocate the overdraw buffers.\n");
+            free_overdraw_buffers();
+            return false;
+        }
+        overdraw_pixels = pixels;
+    }
+    memset(overdraw_tests, 0, pixels * sizeof(uint16_t));
+    memset(overdraw_writes, 0, pixels * sizeof(uint16_t));
+    overdraw_rendered = true;
+    return true;
+}
+
+void draw_overdraw_heatmap() {
+    for (int y = 0; y < win_height; ++y) {
+        for (int x = 0; x < win_width; ++x) {
+            int index = pixel_index(x, y);
+            int level = overdraw_tests[index] < HEATMAP_LEVELS ? overdraw_tests[index] : HEATMAP_LEVELS - 1;
+            color_buffer[index] = heatmap_colors[level];
+        }
+    }
+
+    // Legend: one swatch per level along the bottom
+    int legend_y = win_height - FONT_HEIGHT - 6;
+    for (int level = 0; level < HEATMAP_LEVELS; ++level) {
+        int legend_x = 4 + level * 20;
+        char label[8];
+        snprintf(label, sizeof(label), level == HEATMAP_LEVELS - 1 ? "%d+" : "%d", level);
+        draw_rect(legend_x, legend_y, 8, FONT_HEIGHT, heatmap_colors[level]);
+        draw_text(legend_x + 10, legend_y, label, 0xFFFFFFFF);
+    }
+}
+
+void print_overdraw_histogram() {
+    if (!overdraw_rendered) {
+        return;
+    }
+    uint64_t tests[HISTOGRAM_ROWS] = { 0 };
+    uint64_t writes[HISTOGRAM_ROWS] = { 0 };
+    uint64_t total_tests = 0, total_writes = 0, covered = 0, written = 0;
+    for (int y = 0; y < win_height; ++y) {
+        for (int x = 0; x < win_width; ++x) {
+            int index = pixel_index(x, y);
+            int t = overdraw_tests[index], w = overdraw_writes[index];
+            tests[t < HISTOGRAM_ROWS ? t : HISTOGRAM_ROWS - 1]++;
+            writes[w < HISTOGRAM_ROWS ? w : HISTOGRAM_ROWS - 1]++;
+            total_tests += t;
+            total_writes += w;
+            covered += t > 0;
+            written += w > 0;
+        }
+    }
+
+    double per_covered = covered ? 1.0 / covered : 0.0;
+    printf("Overdraw: %d pixels, %llu covered\n", win_width * win_height, (unsigned long long)covered);
+    printf("  %.2f depth tests and %.2f writes per covered pixel, %.1f%% of the writes overwritten\n",
+        total_tests * per_covered, total_writes * per_covered,
+        total_writes ? 100.0 * (total_writes - written) / total_writes : 0.0);
+    printf("  %6s %10s %10s\n", "count", "tests", "writes");
+    for (int row = 0; row < HISTOGRAM_ROWS; ++row) {
+        printf("  %5d%s %10llu %10llu\n", row, row == HISTOGRAM_ROWS - 1 ? "+" : " ",
+            (unsigned long long)tests[row], (unsigned long long)writes[row]);
+    }
+}
+
+void free_overdraw_buffers() {
+    memory_free(overdraw_tests);
+    memory_free(overdraw_writes);
+    overdraw_tests = NULL;
+    overdraw_writes = NULL;
+    overdraw_pixels = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef PK_OVERDRAW_H
+#define PK_OVERDRAW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Depth tests and depth writes of every pixel of the frame, indexed like the color buffer
+extern uint16_t* overdraw_tests;
+extern uint16_t* overdraw_writes;
+
+/*******************************************************/
+/* Overdraw debug mode: triangles only count their     */
+/* depth tests and writes, and the frame shows the     */
+/* depth complexity as a heatmap instead of shading.   */
+/*******************************************************/
+bool begin_overdraw_frame();
+void draw_overdraw_heatmap();
+// Histogram of the last overdraw frame, to stdout
+void print_overdraw_histogram();
+void free_overdraw_buffers();
+
+#endif // PK_OVERDRAW_H
@@ -0,0 +1,158 @@
+#include "overlay.h"
+#include "display.h"
+#include "stats.h"
+
+#include <SDL.h>
+#include <stdio.h>
+
+/*******************************************************/
+/* 5x7 bitmap font for ' ' to '_', one byte per row,   */
+/* bit 4 is the leftmost pixel. Glyphs the overlay     */
+/* does not need are left blank.                       */
+/*******************************************************/
+static const uint8_t font_glyphs[64][FONT_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '!'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '"'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '#'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '$'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '&'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '''
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '*'
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ','
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // '.'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // '0'
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // '1'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // '2'
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // '3'
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // '4'
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // '5'
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // '6'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // '8'
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // '9'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // ':'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ';'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '<'
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // '='
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '>'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '?'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '@'
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'A'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // 'B'
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // 'C'
+    { 0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E }, // 'D'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // 'E'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // 'F'
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // 'G'
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'H'
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // 'L'
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'O'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // 'P'
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // 'Q'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // 'R'
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // 'S'
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // 'W'
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // 'X'
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 }, // 'Y'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // 'Z'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '['
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '\\'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ']'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, // '_'
+};
+
+#define FONT_ADVANCE (FONT_WIDTH + 1)
+#define LINE_ADVANCE (FONT_HEIGHT + 2)
+
+void draw_text(int x, int y, const char* text, uint32_t color) {
+    int pen_x = x;
+    for (; *text; ++text) {
+        char c = *text;
+        if (c == '\n') {
+            pen_x = x;
+            y += LINE_ADVANCE;
+            continue;
+        }
+        if (c >= 'a' && c <= 'z') {
+            c -= 'a' - 'A';
+        }
+        if (c >= ' ' && c <= '_') {
+            const uint8_t* glyph = font_glyphs[c - ' '];
+            for (int row = 0; row < FONT_HEIGHT; ++row) {
+                for (int column = 0; column < FONT_WIDTH; ++column) {
+                    if (glyph[row] & (0x10 >> column)) {
+                        draw_pixel(pen_x + column, y + row, color);
+                    }
+                }
+            }
+        }
+        pen_x += FONT_ADVANCE;
+    }
+}
+
+// Stage times are averaged over half a second so they can be read
+#define OVERLAY_REFRESH_MS 500
+
+void draw_stats_overlay() {
+    static frame_stats_t previous;
+    static uint64_t previous_ticks = 0;
+    static double stage_ms[STAGE_COUNT];
+    static double frame_ms = 0;
+
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (previous_ticks == 0 || frame_stats.frames < previous.frames) {
+        // First frame, or the totals were reset
+        previous = frame_stats;
+        previous_ticks = now;
+    }
+    if (stats_ticks_to_ms(now - previous_ticks) >= OVERLAY_REFRESH_MS && frame_stats.frames > previous.frames) {
+        double frames = (double)(frame_stats.frames - previous.frames);
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            stage_ms[stage] = stats_ticks_to_ms(frame_stats.stage_ticks[stage] - previous.stage_ticks[stage]) / frames;
+        }
+        frame_ms = stats_ticks_to_ms(now - previous_ticks) / frames;
+        previous = frame_stats;
+        previous_ticks = now;
+    }
+
+    const pipeline_counters_t* c = &frame_counters;
+    char text[512];
+    snprintf(text, sizeof(text),
+        "FPS %.1f  FRAME %.2f MS\n"
+        "XFORM %.2f CULL %.2f CLIP %.2f SETUP %.2f\n"
+        "RASTER %.2f CLEAR %.2f PRESENT %.2f\n"
+        "FACES %llu CULLED %llu CLIPPED %llu\n"
+        "PLANES L%llu R%llu T%llu B%llu N%llu F%llu\n"
+        "CLIP TRIS %llu DROPPED %llu\n"
+        "PIXELS TESTED %llu WRITTEN %llu",
+        frame_ms > 0 ? 1000.0 / frame_ms : 0.0, frame_ms,
+        stage_ms[STAGE_TRANSFORM], stage_ms[STAGE_CULL], stage_ms[STAGE_CLIP], stage_ms[STAGE_SETUP],
+        stage_ms[STAGE_RASTER], stage_ms[STAGE_CLEAR], stage_ms[STAGE_PRESENT],
+        (unsigned long long)c->faces, (unsigned long long)c->faces_culled, (unsigned long long)c->faces_clipped,
+        (unsigned long long)c->clip_plane_hits[LEFT_FRUSTUM_PLANE], (unsigned long long)c->clip_plane_hits[RIGHT_FRUSTUM_PLANE],
+        (unsigned long long)c->clip_plane_hits[TOP_FRUSTUM_PLANE], (unsigned long long)c->clip_plane_hits[BOTTOM_FRUSTUM_PLANE],
+        (unsigned long long)c->clip_plane_hits[NEAR_FRUSTUM_PLANE], (unsigned long long)c->clip_plane_hits[FAR_FRUSTUM_PLANE],
+        (unsigned long long)c->clip_triangles, (unsigned long long)c->triangles_dropped,
+        (unsigned long long)c->pixels_tested, (unsigned long long)c->pixels_written
+    );
+
+    // Drop shadow, so the text stays readable over any model
+    draw_text(5, 5, text, 0xFF000000);
+    draw_text(4, 4, text, 0xFF00FF00);
+}
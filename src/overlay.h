@@ -0,0 +1,15 @@
+#ifndef PK_OVERLAY_H
+#define PK_OVERLAY_H
+
+#include <stdint.h>
+
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+
+// Draws text with the built-in 5x7 font, lowercase as uppercase, '\n' starts a new line
+void draw_text(int x, int y, const char* text, uint32_t color);
+
+// Frame rate, stage times and the pipeline counters of the current frame, drawn into color_buffer
+void draw_stats_overlay();
+
+#endif // PK_OVERLAY_H
@@ -0,0 +1,228 @@
+#include "palette.h"
+#include "light.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Colors are binned by their top 5 bits of R, G and B for the median cut
+#define PALETTE_BINS 32768
+// Open addressing table of the exact colors, twice the palette so probes stay short
+#define PALETTE_EXACT_SLOTS 512
+
+typedef struct {
+    uint32_t count;
+    uint32_t sums[4];       // Per channel, in the byte order of the texels
+} palette_bin_t;
+
+typedef struct {
+    int begin;              // Range of the occupied bins list
+    int end;
+    int channel;            // Widest channel and its range, in bin units
+    int range;
+    uint32_t count;         // Texels in the box
+} palette_box_t;
+
+size_t palette_size(int width, int height) {
+    return PALETTE_LIGHT_LEVELS * PALETTE_COLORS * sizeof(uint32_t) + (size_t)width * height;
+}
+
+static inline int bin_of(uint32_t texel) {
+    return (int)(((texel >> 3) & 31) << 10 | ((texel >> 11) & 31) << 5 | ((texel >> 19) & 31));
+}
+
+static inline int bin_channel(int bin, int channel) {
+    return (bin >> (10 - 5 * channel)) & 31;
+}
+
+static int compare_channel_0(const void* a, const void* b) { return bin_channel(*(const uint16_t*)a, 0) - bin_channel(*(const uint16_t*)b, 0); }
+static int compare_channel_1(const void* a, const void* b) { return bin_channel(*(const uint16_t*)a, 1) - bin_channel(*(const uint16_t*)b, 1); }
+static int compare_channel_2(const void* a, const void* b) { return bin_channel(*(const uint16_t*)a, 2) - bin_channel(*(const uint16_t*)b, 2); }
+
+static void measure_box(palette_box_t* box, const uint16_t* occupied, const palette_bin_t* bins) {
+    int low[3] = { 31, 31, 31 };
+    int high[3] = { 0, 0, 0 };
+    box->count = 0;
+    for (int i = box->begin; i < box->end; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            int value = bin_channel(occupied[i], c);
+            if (value < low[c]) low[c] = value;
+            if (value > high[c]) high[c] = value;
+        }
+        box->count += bins[occupied[i]].count;
+    }
+    box->channel = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (high[c] - low[c] > high[box->channel] - low[box->channel]) {
+            box->channel = c;
+        }
+    }
+    box->range = high[box->channel] - low[box->channel];
+}
+
+/*******************************************************/
+/* Median cut: the box with the most texels times its  */
+/* widest range is split at the median texel of that   */
+/* channel, until there are 256 boxes or none can be   */
+/* split. A box becomes the mean of its texels.        */
+/*******************************************************/
+static int median_cut(uint32_t palette[PALETTE_COLORS], uint8_t* bin_index, const palette_bin_t* bins, uint16_t* occupied,
+    int occupied_count) {
+    static int (*const compare[3])(const void*, const void*) = { compare_channel_0, compare_channel_1, compare_channel_2 };
+    palette_box_t boxes[PALETTE_COLORS];
+    int box_count = 1;
+    boxes[0].begin = 0;
+    boxes[0].end = occupied_count;
+    measure_box(&boxes[0], occupied, bins);
+
+    while (box_count < PALETTE_COLORS) {
+        int widest = -1;
+        uint64_t widest_score = 0;
+        for (int i = 0; i < box_count; ++i) {
+            uint64_t score = (uint64_t)boxes[i].count * boxes[i].range;
+            if (boxes[i].end - boxes[i].begin > 1 && score > widest_score) {
+                widest_score = score;
+                widest = i;
+            }
+        }
+        if (widest < 0) {
+            break;
+        }
+
+        palette_box_t* box = &boxes[widest];
+        qsort(occupied + box->begin, box->end - box->begin, sizeof(uint16_t), compare[box->channel]);
+        uint32_t half = box->count / 2;
+        uint32_t below = 0;
+        int split = box->begin + 1;
+        for (int i = box->begin; i < box->end - 1; ++i) {
+            below += bins[occupied[i]].count;
+            split = i + 1;
+            if (below >= half) {
+                break;
+            }
+        }
+        palette_box_t* other = &boxes[box_count++];
+        other->begin = split;
+        other->end = box->end;
+        box->end = split;
+        measure_box(box, occupied, bins);
+        measure_box(other, occupied, bins);
+    }
+
+    for (int i = 0; i < box_count; ++i) {
+        uint64_t sums[4] = { 0, 0, 0, 0 };
+        for (int j = boxes[i].begin; j < boxes[i].end; ++j) {
+            for (int c = 0; c < 4; ++c) {
+                sums[c] += bins[occupied[j]].sums[c];
+            }
+        }
+        uint32_t count = boxes[i].count;
+        palette[i] = 0;
+        for (int c = 0; c < 4; ++c) {
+            palette[i] |= (uint32_t)((sums[c] + count / 2) / count) << (8 * c);
+        }
+    }
+
+    // Every bin takes the palette color nearest to its mean, which is not always the one of its box
+    for (int i = 0; i < occupied_count; ++i) {
+        const palette_bin_t* bin = &bins[occupied[i]];
+        int mean[4];
+        for (int c = 0; c < 4; ++c) {
+            mean[c] = (int)((bin->sums[c] + bin->count / 2) / bin->count);
+        }
+        int nearest = 0;
+        int nearest_distance = INT32_MAX;
+        for (int p = 0; p < box_count; ++p) {
+            int distance = 0;
+            for (int c = 0; c < 4; ++c) {
+                int d = mean[c] - (int)((palette[p] >> (8 * c)) & 0xFF);
+                distance += d * d;
+            }
+            if (distance < nearest_distance) {
+                nearest_distance = distance;
+                nearest = p;
+            }
+        }
+        bin_index[occupied[i]] = (uint8_t)nearest;
+    }
+    return box_count;
+}
+
+static bool reduce_colors(uint32_t palette[PALETTE_COLORS], uint8_t* indices, const uint32_t* pixels, size_t count,
+    int* colors) {
+    palette_bin_t* bins = memory_calloc(MEMORY_TEXTURES, PALETTE_BINS, sizeof(palette_bin_t));
+    uint16_t* occupied = memory_alloc(MEMORY_TEXTURES, PALETTE_BINS * sizeof(uint16_t));
+    uint8_t* bin_index = memory_alloc(MEMORY_TEXTURES, PALETTE_BINS);
+    if (bins == NULL || occupied == NULL || bin_index == NULL) {
+        memory_free(bins);
+        memory_free(occupied);
+        memory_free(bin_index);
+        return false;
+    }
+
+    int occupied_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        palette_bin_t* bin = &bins[bin_of(pixels[i])];
+        if (bin->count++ == 0) {
+            occupied[occupied_count++] = (uint16_t)(bin - bins);
+        }
+        for (int c = 0; c < 4; ++c) {
+            bin->sums[c] += (pixels[i] >> (8 * c)) & 0xFF;
+        }
+    }
+    *colors = median_cut(palette, bin_index, bins, occupied, occupied_count);
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = bin_index[bin_of(pixels[i])];
+    }
+
+    memory_free(bins);
+    memory_free(occupied);
+    memory_free(bin_index);
+    return true;
+}
+
+// Indexes the pixels with their own colors, false when there are more than 256 of them
+static bool exact_colors(uint32_t palette[PALETTE_COLORS], uint8_t* indices, const uint32_t* pixels, size_t count,
+    int* colors) {
+    uint32_t keys[PALETTE_EXACT_SLOTS];
+    uint8_t values[PALETTE_EXACT_SLOTS];
+    bool used[PALETTE_EXACT_SLOTS] = { false };
+    int color_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot = (pixels[i] * 2654435761u) >> 23;
+        while (used[slot] && keys[slot] != pixels[i]) {
+            slot = (slot + 1) & (PALETTE_EXACT_SLOTS - 1);
+        }
+        if (!used[slot]) {
+            if (color_count == PALETTE_COLORS) {
+                return false;
+            }
+            used[slot] = true;
+            keys[slot] = pixels[i];
+            values[slot] = (uint8_t)color_count;
+            palette[color_count++] = pixels[i];
+        }
+        indices[i] = values[slot];
+    }
+    *colors = color_count;
+    return true;
+}
+
+bool palette_encode(uint32_t* texture, const uint32_t* pixels, int width, int height, int* colors) {
+    uint32_t palette[PALETTE_COLORS] = { 0 };
+    uint8_t* indices = (uint8_t*)palette_indices(texture);
+    size_t count = (size_t)width * height;
+    if (!exact_colors(palette, indices, pixels, count, colors) &&
+        !reduce_colors(palette, indices, pixels, count, colors)) {
+        return false;
+    }
+
+    for (int level = 0; level < PALETTE_LIGHT_LEVELS; ++level) {
+        float intensity = (float)level / (PALETTE_LIGHT_LEVELS - 1);
+        uint32_t* row = texture + level * PALETTE_COLORS;
+        for (int i = 0; i < PALETTE_COLORS; ++i) {
+            row[i] = update_color_intensity(palette[i], intensity);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef PK_PALETTE_H
+#define PK_PALETTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************/
+/* Palettized textures: every texel is a byte index    */
+/* into the 256 colors of its texture. The colors are  */
+/* stored pre-lit, one row per light level: sampling   */
+/* picks the row of the triangle once, then a texel is */
+/* an index load and a row load, no per channel scale. */
+/*                                                     */
+/* Layout of a palettized texture, in 32-bit words:    */
+/*   colormap  PALETTE_LIGHT_LEVELS rows of 256 RGBA32 */
+/*   indices   width x height bytes, in rows           */
+/*******************************************************/
+
+#define PALETTE_COLORS 256
+// Row l holds the colors at intensity l / (PALETTE_LIGHT_LEVELS - 1): 32 KB per texture
+#define PALETTE_LIGHT_LEVELS 32
+
+size_t palette_size(int width, int height);
+// texture: palette_size(width, height) bytes; *colors gets the number of palette entries used.
+// Textures of up to 256 colors keep them exactly, others are reduced by median cut
+bool palette_encode(uint32_t* texture, const uint32_t* pixels, int width, int height, int* colors);
+
+static inline const uint8_t* palette_indices(const uint32_t* texture) {
+    return (const uint8_t*)(texture + PALETTE_LIGHT_LEVELS * PALETTE_COLORS);
+}
+
+// The colors of texture lit at light_intensity, clamped to [0, 1] as update_color_intensity() does
+static inline const uint32_t* palette_colormap_row(const uint32_t* texture, float light_intensity) {
+    if (light_intensity < 0) light_intensity = 0;
+    if (light_intensity > 1) light_intensity = 1;
+    return texture + (int)(light_intensity * (PALETTE_LIGHT_LEVELS - 1) + 0.5f) * PALETTE_COLORS;
+}
+
+// The palette indices of the texels of the lanes set in mask, for the vector span shaders
+static inline void palette_fetch_lanes(int32_t* out, const uint8_t* indices, const int32_t* texel_index, int lanes,
+    unsigned mask) {
+    for (int i = 0; i < lanes; ++i) {
+        out[i] = (mask & (1u << i)) ? indices[texel_index[i]] : 0;
+    }
+}
+
+#endif // PK_PALETTE_H
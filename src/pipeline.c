@@ -0,0 +1,368 @@
+#include "pipeline.h"
+#include "array.h"
+#include "camera.h"
+#include "clipping.h"
+#include "config.h"
+#include "display.h"
+#include "kernels.h"
+#include "light.h"
+#include "matrix.h"
+#include "memory.h"
+#include "mesh.h"
+#include "overdraw.h"
+#include "overlay.h"
+#include "resident.h"
+#include "stats.h"
+#include "texture.h"
+#include "trace.h"
+#include "triangle.h"
+#include "upng.h"
+#include "vector.h"
+
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_TRIANGLES_PER_MESH 10000
+triangle_setup_t triangles_to_render[MAX_TRIANGLES_PER_MESH];
+size_t num_triangles_to_render = 0;
+
+mat4_t world_matrix;
+mat4_t proj_matrix;
+mat4_t view_matrix;
+
+// A face that survived back-face culling
+typedef struct {
+    int face;
+    float light_intensity;
+} visible_face_t;
+
+// Per stage outputs, reused from frame to frame
+static vec4_t* camera_space_vertices = NULL;
+static visible_face_t* visible_faces = NULL;
+static triangle_t* clipped_triangles = NULL;
+
+bool setup() {
+    if (!create_frame_buffers()) {
+        return false;
+    }
+
+    // Init projection matrix
+    float aspectx = (float)win_width / (float)win_height;
+    float aspecty = (float)win_height / (float)win_width;
+    float fovy = M_PI / 3.0f; // 60deg
+    float fovx = atan(tan(fovy / 2) * aspectx) * 2.0f;
+    float znear = 0.1f;
+    float zfar = 100.0f;
+    proj_matrix = mat4_make_perspective(fovy, aspecty, znear, zfar);
+
+    // The integer depth formats are normalized against the near plane
+    depth_near = znear;
+    printf("Depth format: %s\n", depth_format_name(depth_format));
+    printf("Framebuffer layout: %s\n", framebuffer_layout_name(framebuffer_layout));
+    printf("Texture format: %s\n", texture_format_name(texture_format));
+    printf("Frame buffers: %d%s\n", frame_buffer_count, zero_copy && !headless ? " (zero-copy)" : "");
+
+    // Init frustum planes
+    init_frustum_planes(fovx, fovy, znear, zfar);
+
+    // Load texture (manually)
+    // mesh_texture = (uint32_t*)REDBRICK_TEXTURE;
+
+    // Load the mesh
+    //load_cube_mesh_data();
+    //load_obj_file_data("./assets/models/f22.obj");
+    //load_obj_file_data("./assets/models/cube.obj");
+    //load_png_texture_data("./assets/models/cube.png");
+
+    load_next_obj_file_data();
+    return true;
+}
+
+// Sizes the stage outputs for the worst case of the mesh, so steady frames do not allocate
+static void reserve_stage_outputs() {
+    int num_faces = array_length(mesh.faces);
+    int num_vertices = array_length(mesh.vertices);
+    if (array_length(camera_space_vertices) < num_vertices) {
+        camera_space_vertices = array_hold(camera_space_vertices, num_vertices - array_length(camera_space_vertices), sizeof(vec4_t));
+    }
+    visible_faces = array_reserve(visible_faces, num_faces, sizeof(visible_face_t));
+    clipped_triangles = array_reserve(clipped_triangles, num_faces * MAX_NUM_POLYGON_TRIANGLES, sizeof(triangle_t));
+}
+
+void update(float dt) {
+    begin_allocation_frame();
+    uint64_t update_start = trace_begin();
+    reserve_stage_outputs();
+    num_triangles_to_render = 0;
+    memset(&frame_counters, 0, sizeof(frame_counters));
+
+    //mesh.rotation.x += 0.01;
+    /*mesh.rotation.y = fmod(mesh.rotation.y + 0.01, M_PI_2 * 4.0f);
+    mesh.rotation.z = fmod(mesh.rotation.z + 0.01, M_PI_2 * 4.0f);
+    mesh.rotation.z += 0.01;*/
+
+    //camera.position.x = (cos(SDL_GetTicks() / 1000.0f) * 3.0f) * dt;
+    //camera.position.y = (sin(SDL_GetTicks() / 1000.0f) * 3.0f) * dt;
+
+    //mesh.scale.x = (sin(SDL_GetTicks() / 1000.0f) + 1.0f) / 2.0f;
+    //mesh.scale.y = mesh.scale.x;
+    //mesh.scale.z = mesh.scale.x;
+
+    //mesh.translation.x += 0.03;
+    //if (mesh.translation.x >= 5) {
+    //    mesh.translation.x = -5;
+    //}
+    mesh.translation.z = 5.0;
+
+    // Create the view matrix looking at a hardcoded target point
+    view_matrix = mat4_get_yxz_view(camera.position, camera.rotation);
+
+    // Create a scale matrix
+    mat4_t scale_matrix = mat4_make_scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
+
+    // Create a translation matrix
+    mat4_t translation_matrix = mat4_make_translation(
+        mesh.translation.x,
+        mesh.translation.y,
+        mesh.translation.z
+    );
+
+    // Create a rotation matrix
+    mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh.rotation.x);
+    mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh.rotation.y);
+    mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh.rotation.z);
+
+    // Creating a world matrix (combined transformation matrix)
+    world_matrix = mat4_identity();
+
+    // Order is important: scale > rotate > translate (t * r * s) * v
+    world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
+    world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
+    world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
+    world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
+    world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
+
+    uint64_t stage_start = SDL_GetPerformanceCounter();
+
+    // Transform every mesh vertex once to camera space (world, then view)
+    mat4_t world_view_matrix = mat4_mul_mat4(view_matrix, world_matrix);
+    int num_vertices = array_length(mesh.vertices);
+    kernels.transform_vertices(camera_space_vertices, mesh.vertices, num_vertices, &world_view_matrix);
+    stats_stage_end(STAGE_TRANSFORM, &stage_start);
+
+    // Keep the faces that look at the camera, with their light intensity
+    array_clear(visible_faces);
+    frame_counters.faces = array_length(mesh.faces);
+    for (int i = 0; i < array_length(mesh.faces); ++i) {
+        face_t mesh_face = mesh.faces[i];
+
+        // Backface culling
+        vec3_t vec_a = vec3_from_vec4(camera_space_vertices[mesh_face.a]); /*   A   */
+        vec3_t vec_b = vec3_from_vec4(camera_space_vertices[mesh_face.b]); /*  / \  */
+        vec3_t vec_c = vec3_from_vec4(camera_space_vertices[mesh_face.c]); /* B---C */
+
+        vec3_t vec_ab = vec3_sub(vec_b, vec_a);
+        vec3_t vec_ac = vec3_sub(vec_c, vec_a);
+        vec3_normalize(&vec_ab);
+        vec3_normalize(&vec_ac);
+
+        // Calculate the face normal (according to left handed coordinate system)
+        vec3_t face_normal = vec3_cross(vec_ab, vec_ac);
+        vec3_normalize(&face_normal);
+
+        // Find the vectpr between a point in the triangle and the camera origin
+        vec3_t origin = {0, 0, 0};
+        vec3_t camera_ray = vec3_sub(origin, vec_a);
+
+        // Calculate the dot product of the camera and the camera ray
+        float dot_of_the_face_normal_and_the_camera_ray = vec3_dot(face_normal, camera_ray);
+
+        if (is_backface_culling_enabled()) {
+            if (dot_of_the_face_normal_and_the_camera_ray < 0) {
+                frame_counters.faces_culled++;
+                continue;
+            }
+        }
+
+        // Calculate the light instensity for the face
+        visible_face_t visible = { i, -vec3_dot(face_normal, sun_light.direction) };
+        array_push(visible_faces, visible);
+    }
+    stats_stage_end(STAGE_CULL, &stage_start);
+
+    // Clip the visible faces against the frustum
+    array_clear(clipped_triangles);
+    for (int i = 0; i < array_length(visible_faces); ++i) {
+        face_t mesh_face = mesh.faces[visible_faces[i].face];
+
+        // Create a polygon from the original transformed triangle to clip
+        polygon_t polygon = create_polygon_from_triangle(
+            vec3_from_vec4(camera_space_vertices[mesh_face.a]),
+            vec3_from_vec4(camera_space_vertices[mesh_face.b]),
+            vec3_from_vec4(camera_space_vertices[mesh_face.c]),
+            mesh.tex_coords[mesh_face.a],
+            mesh.tex_coords[mesh_face.b],
+            mesh.tex_coords[mesh_face.c]
+        );
+
+        // Clip the polygon and return a new polygon with potential new vertices
+        // (only the calls that cut something are traced, the others are trivial)
+        uint64_t clip_start = trace_begin();
+        int planes_hit = clip_polygon(&polygon);
+        if (planes_hit) {
+            trace_end("clip_polygon", clip_start);
+            frame_counters.faces_clipped++;
+            for (int plane = 0; plane < NUM_PLANES; ++plane) {
+                frame_counters.clip_plane_hits[plane] += (planes_hit >> plane) & 1;
+            }
+        }
+
+        // Triangulate the polygon
+        triangle_t triangles_from_clipped_polygon[MAX_NUM_POLYGON_TRIANGLES];
+        int num_triangles_from_clipped_polygon = 0;
+
+        // Get new triangles from clipped polygon
+        triangles_from_polygon(&polygon, triangles_from_clipped_polygon, &num_triangles_from_clipped_polygon);
+
+        for (int t = 0; t < num_triangles_from_clipped_polygon; ++t) {
+            triangle_t triangle = triangles_from_clipped_polygon[t];
+            triangle.color = mesh_face.color;
+            triangle.light_intensity = visible_faces[i].light_intensity;
+            array_push(clipped_triangles, triangle);
+        }
+    }
+    frame_counters.clip_triangles = array_length(clipped_triangles);
+    stats_stage_end(STAGE_CLIP, &stage_start);
+
+    // Loop all the assembled triangles after clipping
+    for (int t = 0; t < array_length(clipped_triangles); ++t) {
+        const triangle_t* triangle = &clipped_triangles[t];
+
+        // Projection
+        vec4_t projected_points[3];
+        for (size_t j = 0; j < 3; j++) {
+            // Project the current vertex
+            projected_points[j] = mat4_mul_vec4_project(proj_matrix,  triangle->points[j]);
+
+            // Flip the object y to correct the orientation of the object according to screen space coordinates (screen y grows from up to bottom)
+            projected_points[j].y *= -1;
+
+            // Scale and translate the projected points to the middle of the screen
+            projected_points[j].x *= win_width / 2.0f;
+            projected_points[j].y *= win_height / 2.0f;
+
+            // Translate he projected points to the middle of the screen
+            projected_points[j].x += win_width / 2.0f;
+            projected_points[j].y += win_height / 2.0f;
+        }
+
+        // Triangle setup: compute the edge equations, attribute gradients and bounding box.
+        // Degenerate triangles and slivers that do not cover any pixel center are not filled,
+        // they are only kept for the wireframe and vertex points
+        if (num_triangles_to_render < MAX_TRIANGLES_PER_MESH) {
+            bool covers_pixels = setup_triangle(
+                &triangles_to_render[num_triangles_to_render],
+                projected_points[0], projected_points[1], projected_points[2],
+                triangle->texcoords[0], triangle->texcoords[1], triangle->texcoords[2],
+                update_color_intensity(triangle->color, triangle->light_intensity),
+                triangle->light_intensity
+            );
+            if (covers_pixels || is_wireframe_enabled() || is_vertex_point_enabled()) {
+                num_triangles_to_render += 1;
+            }
+        } else {
+            frame_counters.triangles_dropped++;
+        }
+    }
+    stats_stage_end(STAGE_SETUP, &stage_start);
+    trace_end("update", update_start);
+}
+
+bool render() {
+    uint64_t stage_start = SDL_GetPerformanceCounter();
+
+    // draw_grid(100, 100);
+
+    // The overdraw mode replaces the whole frame with its heatmap
+    bool overdraw = is_overdraw_enabled() && begin_overdraw_frame();
+
+    for (int i = 0; i < num_triangles_to_render; ++i) {
+        const triangle_setup_t* triangle = &triangles_to_render[i];
+        if (overdraw) {
+            if (triangle->covers_pixels) {
+                rasterize_overdraw_triangle(triangle);
+            }
+            continue;
+        }
+
+        if (triangle->covers_pixels && is_solid_enabled() && !is_textured_enabled()) {
+            rasterize_solid_triangle(triangle);
+        }
+
+        if (triangle->covers_pixels && is_textured_enabled()) {
+            rasterize_textured_triangle(triangle, mesh_texture);
+        }
+
+        if (is_vertex_point_enabled()) {
+            for (int j = 0; j < 3; ++j) {
+                draw_rect(
+                    triangle->x[j]-2,
+                    triangle->y[j]-1,
+                    3,
+                    3,
+                    0xFFFFFF00
+                );
+            }
+        }
+        if (is_wireframe_enabled()) {
+            draw_triangle(
+                triangle->x[0], triangle->y[0],
+                triangle->x[1], triangle->y[1],
+                triangle->x[2], triangle->y[2],
+                0xFFFFFFFF
+            );
+        }
+
+    }
+
+    if (overdraw) {
+        draw_overdraw_heatmap();
+    }
+
+    frame_stats.triangles += num_triangles_to_render;
+    num_triangles_to_render = 0;
+    stats_stage_end(STAGE_RASTER, &stage_start);
+
+    // The overlay and the CSV row are not part of the measured stages
+    add_pipeline_counters(&frame_stats.counters, &frame_counters);
+    write_counters_csv();
+    if (is_stats_overlay_enabled()) {
+        draw_stats_overlay();
+    }
+    stage_start = SDL_GetPerformanceCounter();
+
+    // Clear and present are timed where they run, see present_frame()
+    bool presented = present_frame(0xFF111111);
+    frame_stats.present_wait_ticks += SDL_GetPerformanceCounter() - stage_start;
+    trace_end("present_frame", stage_start);
+    frame_stats.frames++;
+    end_allocation_frame();
+    return presented;
+}
+
+void free_resources() {
+    free_mesh_data();
+    array_free(camera_space_vertices);
+    array_free(visible_faces);
+    array_free(clipped_triangles);
+    destroy_frame_buffers();
+    free_png_texture_data();
+    free_resident_assets();
+    close_counters_csv();
+    free_overdraw_buffers();
+}
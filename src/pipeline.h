@@ -0,0 +1,16 @@
+#ifndef PK_PIPELINE_H
+#define PK_PIPELINE_H
+
+#include <stdbool.h>
+
+/*******************************************************/
+/* The frame pipeline shared by the viewer and the     */
+/* benchmark: setup() once after initialize_window(),  */
+/* then update() and render() every frame.             */
+/*******************************************************/
+bool setup();
+void update(float dt);
+bool render();
+void free_resources();
+
+#endif // PK_PIPELINE_H
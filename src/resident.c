@@ -0,0 +1,181 @@
+#include "resident.h"
+#include "array.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    bool used;
+    bool is_texture;
+    mesh_t geometry;
+    texture_t texture;
+    size_t bytes;
+    uint64_t last_used;
+} resident_asset_t;
+
+size_t resident_budget = (size_t)256 << 20;
+
+static resident_asset_t assets[RESIDENT_MAX_ASSETS];
+static size_t resident_bytes = 0;
+static uint64_t use_clock = 0;
+static uint64_t hits = 0;
+static uint64_t misses = 0;
+static uint64_t evictions = 0;
+
+static size_t mesh_bytes(mesh_t* geometry) {
+    if (geometry->cache.data) {
+        return geometry->cache.size;
+    }
+    return (size_t)array_capacity(geometry->vertices) * sizeof(vec3_t) +
+        (size_t)array_capacity(geometry->tex_coords) * sizeof(tex2_t) +
+        (size_t)array_capacity(geometry->normals) * sizeof(vec3_t) +
+        (size_t)array_capacity(geometry->faces) * sizeof(face_t);
+}
+
+static size_t texture_bytes(const texture_t* texture) {
+    if (texture->cache.data) {
+        return texture->cache.size;
+    }
+    return texture->converted ? texture_data_size(texture_format, texture->width, texture->height) : 0;
+}
+
+static const char* asset_source(const resident_asset_t* asset) {
+    return asset->is_texture ? asset->texture.source : asset->geometry.source;
+}
+
+static resident_asset_t* find_asset(bool is_texture, const char* source) {
+    for (int i = 0; i < RESIDENT_MAX_ASSETS; ++i) {
+        if (assets[i].used && assets[i].is_texture == is_texture && strcmp(asset_source(&assets[i]), source) == 0) {
+            return &assets[i];
+        }
+    }
+    return NULL;
+}
+
+static void free_asset(resident_asset_t* asset) {
+    if (asset->is_texture) {
+        free_texture(&asset->texture);
+    } else {
+        free_mesh_geometry(&asset->geometry);
+    }
+    resident_bytes -= asset->bytes;
+    memset(asset, 0, sizeof(*asset));
+}
+
+static resident_asset_t* least_recently_used() {
+    resident_asset_t* oldest = NULL;
+    for (int i = 0; i < RESIDENT_MAX_ASSETS; ++i) {
+        if (assets[i].used && (!oldest || assets[i].last_used < oldest->last_used)) {
+            oldest = &assets[i];
+        }
+    }
+    return oldest;
+}
+
+// A slot for a new asset of size bytes, after evicting what it takes to stay in the budget
+static resident_asset_t* make_room(size_t bytes) {
+    resident_asset_t* slot = NULL;
+    for (int i = 0; i < RESIDENT_MAX_ASSETS && !slot; ++i) {
+        if (!assets[i].used) {
+            slot = &assets[i];
+        }
+    }
+    while (!slot || resident_bytes + bytes > resident_budget) {
+        resident_asset_t* oldest = least_recently_used();
+        if (!oldest) {
+            break;
+        }
+        free_asset(oldest);
+        evictions++;
+        if (!slot) {
+            slot = oldest;
+        }
+    }
+    return slot;
+}
+
+static void take_asset(resident_asset_t* asset) {
+    hits++;
+    resident_bytes -= asset->bytes;
+    memset(asset, 0, sizeof(*asset));
+}
+
+bool take_resident_mesh(const char* source, mesh_t* target) {
+    resident_asset_t* asset = find_asset(false, source);
+    if (!asset) {
+        misses++;
+        return false;
+    }
+    *target = asset->geometry;
+    take_asset(asset);
+    return true;
+}
+
+bool take_resident_texture(const char* source, texture_t* target) {
+    resident_asset_t* asset = find_asset(true, source);
+    if (!asset) {
+        misses++;
+        return false;
+    }
+    *target = asset->texture;
+    take_asset(asset);
+    return true;
+}
+
+void keep_resident_mesh(mesh_t* geometry) {
+    size_t bytes = mesh_bytes(geometry);
+    resident_asset_t* previous = geometry->faces && geometry->source[0] ? find_asset(false, geometry->source) : NULL;
+    if (previous) {
+        free_asset(previous);
+    }
+    resident_asset_t* slot = geometry->faces && geometry->source[0] && bytes <= resident_budget ? make_room(bytes) : NULL;
+    if (!slot) {
+        free_mesh_geometry(geometry);
+        return;
+    }
+    slot->used = true;
+    slot->is_texture = false;
+    slot->geometry = *geometry;
+    slot->bytes = bytes;
+    slot->last_used = ++use_clock;
+    resident_bytes += bytes;
+    memset(geometry, 0, sizeof(*geometry));
+}
+
+void keep_resident_texture(texture_t* texture) {
+    size_t bytes = texture_bytes(texture);
+    resident_asset_t* previous = texture->pixels && texture->source[0] ? find_asset(true, texture->source) : NULL;
+    if (previous) {
+        free_asset(previous);
+    }
+    resident_asset_t* slot = texture->pixels && texture->source[0] && bytes <= resident_budget ? make_room(bytes) : NULL;
+    if (!slot) {
+        free_texture(texture);
+        return;
+    }
+    slot->used = true;
+    slot->is_texture = true;
+    slot->texture = *texture;
+    slot->bytes = bytes;
+    slot->last_used = ++use_clock;
+    resident_bytes += bytes;
+    memset(texture, 0, sizeof(*texture));
+}
+
+void free_resident_assets() {
+    for (int i = 0; i < RESIDENT_MAX_ASSETS; ++i) {
+        if (assets[i].used) {
+            free_asset(&assets[i]);
+        }
+    }
+}
+
+void print_resident_report() {
+    int kept = 0;
+    for (int i = 0; i < RESIDENT_MAX_ASSETS; ++i) {
+        kept += assets[i].used ? 1 : 0;
+    }
+    printf("Resident assets: %llu hits, %llu misses, %llu evicted, %d kept in %.1f of %.1f MB\n",
+        (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)evictions, kept,
+        resident_bytes / (1024.0 * 1024.0), resident_budget / (1024.0 * 1024.0));
+}
@@ -0,0 +1,33 @@
+#ifndef PK_RESIDENT_H
+#define PK_RESIDENT_H
+
+#include "mesh.h"
+#include "texture.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************/
+/* Meshes and textures kept in memory once out of use, */
+/* keyed by the file they were loaded from, so going   */
+/* back to a model does not load it again. The least   */
+/* recently used ones are freed over the byte budget.  */
+/* Used by one thread at a time: the loader thread, or */
+/* the render thread when there is none.               */
+/*******************************************************/
+#define RESIDENT_MAX_ASSETS 32
+
+extern size_t resident_budget;
+
+// Moves the asset loaded from source out of the cache into target, false when it is not resident
+bool take_resident_mesh(const char* source, mesh_t* target);
+bool take_resident_texture(const char* source, texture_t* target);
+// Gives an asset out of use to the cache, which leaves the argument empty
+void keep_resident_mesh(mesh_t* geometry);
+void keep_resident_texture(texture_t* texture);
+void free_resident_assets();
+
+// Hits, misses, evictions and the bytes kept, to stdout
+void print_resident_report();
+
+#endif // PK_RESIDENT_H
@@ -0,0 +1,81 @@
+#include "stats.h"
+
+#include <SDL.h>
+
+#include <stdio.h>
+#include <string.h>
+
+frame_stats_t frame_stats;
+pipeline_counters_t frame_counters;
+
+static FILE* counters_csv = NULL;
+static uint64_t counters_csv_frame = 0;
+
+void reset_frame_stats() {
+    memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+void add_pipeline_counters(pipeline_counters_t* total, const pipeline_counters_t* counters) {
+    total->faces += counters->faces;
+    total->faces_culled += counters->faces_culled;
+    total->faces_clipped += counters->faces_clipped;
+    for (int plane = 0; plane < NUM_PLANES; ++plane) {
+        total->clip_plane_hits[plane] += counters->clip_plane_hits[plane];
+    }
+    total->clip_triangles += counters->clip_triangles;
+    total->triangles_dropped += counters->triangles_dropped;
+    total->pixels_tested += counters->pixels_tested;
+    total->pixels_written += counters->pixels_written;
+}
+
+double stats_ticks_to_ms(uint64_t ticks) {
+    return ticks * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+const char* pipeline_stage_name(pipeline_stage_t stage) {
+    switch (stage) {
+        case STAGE_TRANSFORM: return "transform";
+        case STAGE_CULL:      return "cull";
+        case STAGE_CLIP:      return "clip";
+        case STAGE_SETUP:     return "setup";
+        case STAGE_RASTER:    return "raster";
+        case STAGE_CLEAR:     return "clear";
+        case STAGE_PRESENT:   return "present";
+        default:              return "unknown";
+    }
+}
+
+bool open_counters_csv(const char* path) {
+    counters_csv = fopen(path, "w");
+    if (counters_csv == NULL) {
+        fprintf(stderr, "<!> Could not open %s for writing.\n", path);
+        return false;
+    }
+    counters_csv_frame = 0;
+    fprintf(counters_csv, "frame,faces,faces_culled,faces_clipped,"
+        "clip_left,clip_right,clip_top,clip_bottom,clip_near,clip_far,"
+        "clip_triangles,triangles_dropped,pixels_tested,pixels_written\n");
+    return true;
+}
+
+void write_counters_csv() {
+    if (counters_csv == NULL) {
+        return;
+    }
+    const pipeline_counters_t* c = &frame_counters;
+    fprintf(counters_csv, "%llu,%llu,%llu,%llu", (unsigned long long)counters_csv_frame++,
+        (unsigned long long)c->faces, (unsigned long long)c->faces_culled, (unsigned long long)c->faces_clipped);
+    for (int plane = 0; plane < NUM_PLANES; ++plane) {
+        fprintf(counters_csv, ",%llu", (unsigned long long)c->clip_plane_hits[plane]);
+    }
+    fprintf(counters_csv, ",%llu,%llu,%llu,%llu\n",
+        (unsigned long long)c->clip_triangles, (unsigned long long)c->triangles_dropped,
+        (unsigned long long)c->pixels_tested, (unsigned long long)c->pixels_written);
+}
+
+void close_counters_csv() {
+    if (counters_csv) {
+        fclose(counters_csv);
+        counters_csv = NULL;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef PK_STATS_H
+#define PK_STATS_H
+
+#include "clipping.h"
+#include "trace.h"
+
+#include <SDL.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pipeline stages, in the order a frame goes through them
+typedef enum {
+    STAGE_TRANSFORM,    // Model to camera space, all vertices
+    STAGE_CULL,         // Back-face culling and face lighting
+    STAGE_CLIP,         // Frustum clipping and triangulation
+    STAGE_SETUP,        // Projection and triangle setup
+    STAGE_RASTER,       // Span shading, wireframe and vertex points
+    STAGE_CLEAR,        // Color and z-buffer clears
+    STAGE_PRESENT,      // Detile, upload and present (or frame write when headless)
+    STAGE_COUNT,
+} pipeline_stage_t;
+
+// Work done by one frame, reset by update()
+typedef struct {
+    uint64_t faces;                         // Mesh faces processed
+    uint64_t faces_culled;                  // Back-face culled
+    uint64_t faces_clipped;                 // Cut or dropped by at least one frustum plane
+    uint64_t clip_plane_hits[NUM_PLANES];   // Faces cut or dropped, per plane
+    uint64_t clip_triangles;                // Triangles emitted by clipping
+    uint64_t triangles_dropped;             // Over the MAX_TRIANGLES_PER_MESH cap
+    uint64_t pixels_tested;                 // Inside a triangle, depth-tested
+    uint64_t pixels_written;                // Passed the depth test
+} pipeline_counters_t;
+
+extern pipeline_counters_t frame_counters;
+
+/*******************************************************/
+/* Totals since the last reset_frame_stats(). Stage    */
+/* times are in performance counter ticks; clear and   */
+/* present are measured on the thread that runs them.  */
+/*******************************************************/
+typedef struct {
+    uint64_t stage_ticks[STAGE_COUNT];
+    uint64_t present_wait_ticks;    // Render thread in present_frame(): waiting for a free buffer, or presenting with one
+    uint64_t frames;
+    uint64_t triangles;             // Triangles handed to the rasterizer
+    pipeline_counters_t counters;
+} frame_stats_t;
+
+extern frame_stats_t frame_stats;
+
+const char* pipeline_stage_name(pipeline_stage_t stage);
+
+// Adds the time since *start to a stage and restarts *start, so stages can be timed back to back.
+// The stage is a trace span too.
+static inline void stats_stage_end(pipeline_stage_t stage, uint64_t* start) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    frame_stats.stage_ticks[stage] += now - *start;
+    if (trace_enabled) {
+        trace_record(pipeline_stage_name(stage), *start, now);
+    }
+    *start = now;
+}
+
+void reset_frame_stats();
+void add_pipeline_counters(pipeline_counters_t* total, const pipeline_counters_t* counters);
+double stats_ticks_to_ms(uint64_t ticks);
+
+// One CSV row of frame_counters per frame, written by render() while open
+bool open_counters_csv(const char* path);
+void write_counters_csv();
+void close_counters_csv();
+
+#endif // PK_STATS_H
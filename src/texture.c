@@ -1,9 +1,15 @@
 #include "texture.h"
 #include "array.h"
+#include "asset_cache.h"
+#include "bc1.h"
+#include "memory.h"
+#include "palette.h"
 #include "upng.h"
+#include <SDL.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <io.h>
@@ -14,46 +20,198 @@
 #endif
 
 uint32_t* mesh_texture = NULL;
-upng_t* png_texture = NULL;
+
+// The texture mesh_texture points into
+static texture_t current_texture;
 
 int texture_width = 64;
 int texture_height = 64;
 
-void load_png_texture_data(const char* filename) {
-    if (access(filename, F_OK) != 0) {
-        fprintf(stderr, "ERROR: [Not exists] Texture could not be loaded from %s\n", filename);
-        return;
+texture_format_t texture_format = TEXTURE_FORMAT_RGBA32;
+
+const char* texture_format_name(texture_format_t format) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:     return "bc1";
+        case TEXTURE_FORMAT_PALETTE: return "palette";
+        default:                     return "rgba32";
+    }
+}
+
+bool parse_texture_format(const char* name, texture_format_t* format) {
+    if (strcmp(name, "rgba32") == 0) { *format = TEXTURE_FORMAT_RGBA32; return true; }
+    if (strcmp(name, "bc1") == 0) { *format = TEXTURE_FORMAT_BC1; return true; }
+    if (strcmp(name, "palette") == 0) { *format = TEXTURE_FORMAT_PALETTE; return true; }
+    return false;
+}
+
+size_t texture_data_size(texture_format_t format, int width, int height) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:     return bc1_size(width, height);
+        case TEXTURE_FORMAT_PALETTE: return palette_size(width, height);
+        default:                     return (size_t)width * height * sizeof(uint32_t);
+    }
+}
+
+// The cache holds the texels in the format they were loaded in: another format is encoded again
+static bool load_texture_cache(const char* filename, texture_t* texture) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (!open_asset_cache(filename, ASSET_CACHE_TEXTURE, &texture->cache)) {
+        return false;
+    }
+    const asset_cache_header_t* header = asset_cache_header(&texture->cache);
+    asset_cache_section_t texels = asset_cache_section(&texture->cache, 0);
+    int width = (int)header->params[0];
+    int height = (int)header->params[1];
+    if (header->params[2] != (uint32_t)texture_format) {
+        printf("Cache of %s holds %s texels, it will be rebuilt\n", filename, texture_format_name((texture_format_t)header->params[2]));
+        unmap_file(&texture->cache);
+        return false;
+    }
+    if (width <= 0 || height <= 0 || texels.size != texture_data_size(texture_format, width, height)) {
+        fprintf(stderr, "<!> The cache of %s is damaged, it will be rebuilt.\n", filename);
+        unmap_file(&texture->cache);
+        return false;
     }
-    upng_t* temp = png_texture;
-    png_texture = upng_new_from_file(filename);
-    if (png_texture == NULL) {
+
+    texture->pixels = (uint32_t*)texels.data;
+    texture->width = width;
+    texture->height = height;
+    printf("Loaded the %dx%d %s texture %s from the cache in %.2f ms\n", width, height, texture_format_name(texture_format), filename,
+        (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+    return true;
+}
+
+static void write_texture_cache(const char* filename, const texture_t* texture) {
+    uint32_t params[4] = { (uint32_t)texture->width, (uint32_t)texture->height, (uint32_t)texture_format, 0 };
+    asset_cache_section_t texels = { texture->pixels, texture_data_size(texture_format, texture->width, texture->height) };
+    write_asset_cache(filename, ASSET_CACHE_TEXTURE, params, &texels, 1);
+}
+
+static bool decode_png_texture(const char* filename, texture_t* texture) {
+    upng_t* png = upng_new_from_file(filename);
+    if (png == NULL) {
         fprintf(stderr, "ERROR: Texture could not be loaded from %s\n", filename);
-        png_texture = temp;
-        return;
+        return false;
+    }
+
+    int result = upng_header(png);
+    if (result != UPNG_EOK) {
+        fprintf(stderr, "ERROR: [%d] Texture could not be loaded from %s\n", result, filename);
+        upng_free(png);
+        return false;
     }
-    
-    
-    int result = upng_decode(png_texture);
+
+    int width = upng_get_width(png);
+    int height = upng_get_height(png);
+    size_t pixel_count = (size_t)width * height;
+    // Every format is widened to the RGBA32 layout of the color buffer while it is decoded, row by row
+    texture->converted = memory_alloc(MEMORY_TEXTURES, pixel_count * sizeof(uint32_t));
+    result = texture->converted
+        ? upng_decode_rgba(png, (unsigned char*)texture->converted, pixel_count * sizeof(uint32_t))
+        : UPNG_ENOMEM;
     if (result != UPNG_EOK) {
         fprintf(stderr, "ERROR: [%d] Texture could not be loaded from %s\n", result, filename);
-        png_texture = temp;
-        return;
+        memory_free(texture->converted);
+        texture->converted = NULL;
+        upng_free(png);
+        return false;
     }
 
     printf("########\n");
     printf("Texture : %s\n", filename);
-    printf("BPP     : %d\n", upng_get_bpp(png_texture));
-    printf("Depth   : %d\n", upng_get_bitdepth(png_texture));
-    printf("Size    : %d\n", upng_get_size(png_texture));
-    printf("Width   : %d\n", upng_get_width(png_texture));
-    printf("Height  : %d\n", upng_get_height(png_texture));
-    printf("Format  : %d\n", upng_get_format(png_texture));
-    printf("PixelSz : %d\n", upng_get_pixelsize(png_texture));
+    printf("BPP     : %d\n", upng_get_bpp(png));
+    printf("Depth   : %d\n", upng_get_bitdepth(png));
+    printf("Size    : %d\n", (int)(pixel_count * sizeof(uint32_t)));
+    printf("Width   : %d\n", width);
+    printf("Height  : %d\n", height);
+    printf("Format  : %d\n", upng_get_format(png));
+    printf("PixelSz : %d\n", upng_get_pixelsize(png));
     printf("########\n");
+    upng_free(png);
+
+    texture->width = width;
+    texture->height = height;
+    texture->pixels = texture->converted;
+    return true;
+}
+
+// Replaces the decoded RGBA32 pixels of texture with their texture_format encoding
+static bool compress_texture(texture_t* texture) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    size_t size = texture_data_size(texture_format, texture->width, texture->height);
+    uint32_t* data = memory_alloc(MEMORY_TEXTURES, size);
+    int colors = 0;
+    bool encoded = data != NULL;
+    if (encoded && texture_format == TEXTURE_FORMAT_BC1) {
+        bc1_encode(data, texture->pixels, texture->width, texture->height);
+    } else if (encoded) {
+        encoded = palette_encode(data, texture->pixels, texture->width, texture->height, &colors);
+    }
+    if (!encoded) {
+        fprintf(stderr, "<!> Could not allocate the %s texels of %s.\n", texture_format_name(texture_format), texture->source);
+        memory_free(data);
+        free_texture(texture);
+        return false;
+    }
+    memory_free(texture->converted);
+    texture->converted = data;
+    texture->pixels = data;
+    double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    if (texture_format == TEXTURE_FORMAT_BC1) {
+        printf("Compressed the %dx%d texture %s to BC1 in %.2f ms\n", texture->width, texture->height, texture->source, ms);
+    } else {
+        printf("Palettized the %dx%d texture %s to %d colors in %.2f ms\n", texture->width, texture->height, texture->source,
+            colors, ms);
+    }
+    return true;
+}
+
+bool load_texture(const char* filename, texture_t* texture) {
+    memset(texture, 0, sizeof(*texture));
+    snprintf(texture->source, sizeof(texture->source), "%s", filename);
+    if (access(filename, F_OK) != 0) {
+        fprintf(stderr, "ERROR: [Not exists] Texture could not be loaded from %s\n", filename);
+        return false;
+    }
+    if (load_texture_cache(filename, texture)) {
+        return true;
+    }
+    if (!decode_png_texture(filename, texture)) {
+        return false;
+    }
+    if (texture_format != TEXTURE_FORMAT_RGBA32 && !compress_texture(texture)) {
+        return false;
+    }
+    write_texture_cache(filename, texture);
+    return true;
+}
+
+void free_texture(texture_t* texture) {
+    memory_free(texture->converted);
+    unmap_file(&texture->cache);
+    memset(texture, 0, sizeof(*texture));
+}
+
+void swap_texture(texture_t* texture) {
+    texture_t previous = current_texture;
+    current_texture = *texture;
+    *texture = previous;
+    mesh_texture = current_texture.pixels;
+    texture_width = current_texture.width;
+    texture_height = current_texture.height;
+}
+
+void load_png_texture_data(const char* filename) {
+    texture_t texture;
+    if (load_texture(filename, &texture)) {
+        swap_texture(&texture);
+        free_texture(&texture);
+    }
+}
 
-    mesh_texture = (uint32_t*)upng_get_buffer(png_texture);
-    texture_width = upng_get_width(png_texture);
-    texture_height = upng_get_height(png_texture);
+void free_png_texture_data() {
+    free_texture(&current_texture);
+    mesh_texture = NULL;
 }
 
 tex2_t tex2_clone(tex2_t* t) {
@@ -1,21 +1,53 @@
 #ifndef PK_TEXTURE_H
 #define PK_TEXTURE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include "upng.h"
+#include "file_map.h"
 
 typedef struct {
     float u;
     float v;
 } tex2_t;
 
+// In-memory layout of the loaded textures, the span shaders sample it as it is
+typedef enum {
+    TEXTURE_FORMAT_RGBA32,  // The layout of the color buffer
+    TEXTURE_FORMAT_BC1,     // 4x4 texel blocks of 8 bytes (see bc1.h), decoded when sampled
+    TEXTURE_FORMAT_PALETTE, // Byte indices into pre-lit colors (see palette.h)
+} texture_format_t;
+
+extern texture_format_t texture_format;
+
+const char* texture_format_name(texture_format_t format);
+bool parse_texture_format(const char* name, texture_format_t* format);
+size_t texture_data_size(texture_format_t format, int width, int height);
+
+// A loaded texture and whatever its pixels point into
+typedef struct {
+    uint32_t* pixels;       // In texture_format, NULL when nothing is loaded
+    int width;
+    int height;
+    uint32_t* converted;    // Owned pixels, decoded from the PNG, compressed or palettized
+    mapped_file_t cache;    // Backing of a texture loaded from its cache
+    char source[256];       // File loaded from
+} texture_t;
+
 extern uint32_t* mesh_texture;
-extern upng_t* png_texture;
 
 extern int texture_width;
 extern int texture_height;
 
+// Loads a PNG file (or its cache) into texture in texture_format, texture is left empty on failure
+bool load_texture(const char* filename, texture_t* texture);
+void free_texture(texture_t* texture);
+// Makes texture the one sampled through mesh_texture; texture gets the previous one
+void swap_texture(texture_t* texture);
+
+// A texture that can not be loaded keeps the previous one in use
 void load_png_texture_data(const char* filename);
+void free_png_texture_data();
 
 tex2_t tex2_clone(tex2_t* t);
 
@@ -0,0 +1,11 @@
+#ifndef PK_THREAD_LOCAL_H
+#define PK_THREAD_LOCAL_H
+
+// Storage class of variables that every thread has its own copy of
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#endif // PK_THREAD_LOCAL_H
@@ -0,0 +1,129 @@
+#include "trace.h"
+#include "memory.h"
+#include "thread_local.h"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t* events;  // TRACE_EVENTS_PER_THREAD entries
+    uint64_t count;         // Spans recorded, the ring holds the last ones
+    const char* name;
+} trace_buffer_t;
+
+bool trace_enabled = false;
+
+static const char* trace_path = NULL;
+static uint64_t trace_origin = 0;
+static trace_buffer_t trace_buffers[TRACE_MAX_THREADS];
+static SDL_atomic_t trace_thread_count;
+static THREAD_LOCAL trace_buffer_t* thread_buffer = NULL;
+
+// Hands the calling thread its ring buffer on its first span, NULL when there are too many threads
+static trace_buffer_t* get_thread_buffer() {
+    if (thread_buffer) {
+        return thread_buffer;
+    }
+    int index = SDL_AtomicAdd(&trace_thread_count, 1);
+    if (index >= TRACE_MAX_THREADS) {
+        return NULL;
+    }
+    trace_buffer_t* buffer = &trace_buffers[index];
+    buffer->events = (trace_event_t*)memory_alloc(MEMORY_DEBUG, TRACE_EVENTS_PER_THREAD * sizeof(trace_event_t));
+    if (!buffer->events) {
+        return NULL;
+    }
+    thread_buffer = buffer;
+    return buffer;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end) {
+    trace_buffer_t* buffer = get_thread_buffer();
+    if (!buffer) {
+        return;
+    }
+    trace_event_t* event = &buffer->events[buffer->count++ % TRACE_EVENTS_PER_THREAD];
+    event->name = name;
+    event->start = start;
+    event->end = end;
+}
+
+void trace_thread_name(const char* name) {
+    if (!trace_enabled) {
+        return;
+    }
+    trace_buffer_t* buffer = get_thread_buffer();
+    if (buffer) {
+        buffer->name = name;
+    }
+}
+
+void start_trace(const char* path) {
+    trace_path = path;
+    trace_origin = SDL_GetPerformanceCounter();
+    trace_enabled = true;
+}
+
+static double trace_us(uint64_t ticks) {
+    return ticks * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+bool stop_trace() {
+    if (!trace_enabled) {
+        return true;
+    }
+    trace_enabled = false;
+
+    FILE* file = fopen(trace_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "<!> Could not open %s for writing.\n", trace_path);
+        return false;
+    }
+
+    int threads = SDL_AtomicGet(&trace_thread_count);
+    if (threads > TRACE_MAX_THREADS) {
+        threads = TRACE_MAX_THREADS;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int i = 0; i < threads; ++i) {
+        trace_buffer_t* buffer = &trace_buffers[i];
+        if (!buffer->events) {
+            continue;
+        }
+        if (buffer->name) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", i + 1, buffer->name);
+            first = false;
+        }
+        uint64_t begin = buffer->count > TRACE_EVENTS_PER_THREAD ? buffer->count - TRACE_EVENTS_PER_THREAD : 0;
+        for (uint64_t e = begin; e < buffer->count; ++e) {
+            const trace_event_t* event = &buffer->events[e % TRACE_EVENTS_PER_THREAD];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", event->name, i + 1,
+                trace_us(event->start - trace_origin), trace_us(event->end - event->start));
+            first = false;
+        }
+        if (buffer->count > TRACE_EVENTS_PER_THREAD) {
+            fprintf(stderr, "<!> Trace: the first %llu spans of thread %s were overwritten.\n",
+                (unsigned long long)(buffer->count - TRACE_EVENTS_PER_THREAD), buffer->name ? buffer->name : "?");
+        }
+        memory_free(buffer->events);
+        buffer->events = NULL;
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "<!> Could not write the trace to %s.\n", trace_path);
+        return false;
+    }
+    printf("Trace: %s\n", trace_path);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef PK_TRACE_H
+#define PK_TRACE_H
+
+#include <SDL.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Spans kept per thread; once full the oldest ones are overwritten
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+#define TRACE_MAX_THREADS 8
+
+extern bool trace_enabled;
+
+/*******************************************************/
+/* Span tracing into per-thread ring buffers, exported */
+/* as Chrome trace-event JSON (chrome://tracing,       */
+/* Perfetto). A span is taken as                       */
+/*   uint64_t start = trace_begin();                   */
+/*   ...                                               */
+/*   trace_end("name", start);                         */
+/* and stored once, as a complete event, when it ends. */
+/* Both calls cost a branch while tracing is off.      */
+/*******************************************************/
+static inline uint64_t trace_begin() {
+    return trace_enabled ? SDL_GetPerformanceCounter() : 0;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end);
+
+// name must outlive the trace, string literals in practice
+static inline void trace_end(const char* name, uint64_t start) {
+    if (trace_enabled) {
+        trace_record(name, start, SDL_GetPerformanceCounter());
+    }
+}
+
+void start_trace(const char* path);
+// Names the calling thread in the exported trace
+void trace_thread_name(const char* name);
+// Writes the trace to the path given to start_trace(), once every traced thread is done
+bool stop_trace();
+
+#endif // PK_TRACE_H
@@ -1,11 +1,16 @@
 #include "triangle.h"
 #include "array.h"
 #include "display.h"
+#include "kernels.h"
 #include "light.h"
 #include "swap.h"
 #include "texture.h"
 #include "vector.h"
 
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
 /*************************************/
 /* Return the barycentric weights    */
 /* alpha, beta, and gamma for point p*/
@@ -74,87 +79,308 @@ void draw_texel(
 
 }
 
-void draw_triangle_pixel(
-    int x, int y, uint32_t color,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c
-) {
-    // Create three vec2 to find the interpolation
-    vec2_t p = { x, y };
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
-
-    // Calculate the barycentric coordinates of our point 'p' inside the triangle
-    vec3_t weights = barycentric_weights(a, b, c, p);
+// Vertices are snapped to 1/16 of a pixel so shared edges are evaluated alike by both triangles
+#define SUBPIXEL_STEPS 16.0f
 
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
-    
-    // Interpolate the value of 1/w for the current pixel
-    float interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+// Edge values at pixel centers are multiples of 1/256 after snapping; half of that
+// turns the strict "> 0" test of the non top-left edges into ">= 0"
+#define EDGE_BIAS (1.0f / 512.0f)
 
-    // Adjust 1/w so the pixels that are closer to the camera have smaller values
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
+static inline float snap_to_subpixel(float value) {
+    return roundf(value * SUBPIXEL_STEPS) / SUBPIXEL_STEPS;
+}
 
-    // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-    if (interpolated_reciprocal_w < z_buffer[(win_width * y) + x]) {
-        // Draw a pixel at position (x,y) with a solid color
-        draw_pixel(x, y, color);
+static inline plane_eq_t attribute_plane(
+    float a0, float a1, float a2,
+    float x0, float y0, float x1, float y1, float x2, float y2,
+    float inv_area, float origin_x, float origin_y
+) {
+    plane_eq_t eq;
+    eq.dx = ((a1 - a0) * (y2 - y0) - (a2 - a0) * (y1 - y0)) * inv_area;
+    eq.dy = ((a2 - a0) * (x1 - x0) - (a1 - a0) * (x2 - x0)) * inv_area;
+    eq.c = a0 + eq.dx * (origin_x - x0) + eq.dy * (origin_y - y0);
+    return eq;
+}
 
-        // Update the z-buffer value with the 1/w of this current pixel
-        z_buffer[(win_width * y) + x] = interpolated_reciprocal_w;
+/*******************************************************/
+/* Edge function of the edge (xi,yi)->(xj,yj):         */
+/*   E(x,y) = (xj - xi) * (y - yi) - (yj - yi) * (x - xi)*/
+/* It is positive on the inside of a triangle with a   */
+/* positive area. Pixels exactly on an edge belong to  */
+/* the triangle only for top and left edges.           */
+/*******************************************************/
+static inline plane_eq_t edge_plane(float xi, float yi, float xj, float yj, float origin_x, float origin_y) {
+    float dx = xj - xi;
+    float dy = yj - yi;
+    bool is_top_left = (dy == 0 && dx > 0) || dy < 0;
+    plane_eq_t eq = {
+        .dx = -dy,
+        .dy = dx,
+        .c = dx * (origin_y - yi) - dy * (origin_x - xi),
+    };
+    if (!is_top_left) {
+        eq.c -= EDGE_BIAS;
     }
+    return eq;
 }
 
-void draw_texel_perspective_correct(
-    int x, int y, uint32_t* texture, float light_intensity,
+bool setup_triangle(
+    triangle_setup_t* setup,
     vec4_t point_a, vec4_t point_b, vec4_t point_c,
-    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv
+    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv,
+    uint32_t color,
+    float light_intensity
 ) {
-    vec2_t p = { x, y };
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
+    float x0 = snap_to_subpixel(point_a.x), y0 = snap_to_subpixel(point_a.y);
+    float x1 = snap_to_subpixel(point_b.x), y1 = snap_to_subpixel(point_b.y);
+    float x2 = snap_to_subpixel(point_c.x), y2 = snap_to_subpixel(point_c.y);
+    float w0 = point_a.w, w1 = point_b.w, w2 = point_c.w;
+    setup->x[0] = point_a.x; setup->y[0] = point_a.y;
+    setup->x[1] = point_b.x; setup->y[1] = point_b.y;
+    setup->x[2] = point_c.x; setup->y[2] = point_c.y;
+    setup->covers_pixels = false;
+
+    // Twice the signed area; zero for degenerate triangles (repeated or collinear vertices)
+    float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if (area == 0 || w0 <= 0 || w1 <= 0 || w2 <= 0) {
+        return false;
+    }
 
-    vec3_t weights = barycentric_weights(a, b, c, p);
+    // Rasterize every triangle with the same winding
+    if (area < 0) {
+        float_swap(&x1, &x2);
+        float_swap(&y1, &y2);
+        float_swap(&w1, &w2);
+        tex2_t uv = b_uv;
+        b_uv = c_uv;
+        c_uv = uv;
+        area = -area;
+    }
 
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
+    // Bounding box of the pixel centers (x + 0.5, y + 0.5) covered by the triangle, clamped to the screen
+    float fmin_x = fminf(x0, fminf(x1, x2));
+    float fmax_x = fmaxf(x0, fmaxf(x1, x2));
+    float fmin_y = fminf(y0, fminf(y1, y2));
+    float fmax_y = fmaxf(y0, fmaxf(y1, y2));
+    int min_x = (int)fmaxf(ceilf(fmin_x - 0.5f), 0);
+    int min_y = (int)fmaxf(ceilf(fmin_y - 0.5f), 0);
+    int max_x = (int)fminf(floorf(fmax_x - 0.5f), win_width - 1);
+    int max_y = (int)fminf(floorf(fmax_y - 0.5f), win_height - 1);
+
+    // Slivers that fall between pixel centers do not cover any pixel
+    if (min_x > max_x || min_y > max_y) {
+        return false;
+    }
 
-    // Variables to store the interpolated values of U, V, and also 1/w for the current pixel
-    float interpolated_u;
-    float interpolated_v;
-    float interpolated_reciprocal_w;
+    // Planes are evaluated relative to the center of the top left pixel of the bounding box
+    float origin_x = min_x + 0.5f;
+    float origin_y = min_y + 0.5f;
 
-    // Perform the interpolation of all U/w and V/w values using barycentric weights and a factor of 1/w
-    interpolated_u = (a_uv.u / point_a.w) * alpha + (b_uv.u / point_b.w) * beta + (c_uv.u / point_c.w) * gamma;
-    interpolated_v = (a_uv.v / point_a.w) * alpha + (b_uv.v / point_b.w) * beta + (c_uv.v / point_c.w) * gamma;
+    setup->edges[0] = edge_plane(x1, y1, x2, y2, origin_x, origin_y);
+    setup->edges[1] = edge_plane(x2, y2, x0, y0, origin_x, origin_y);
+    setup->edges[2] = edge_plane(x0, y0, x1, y1, origin_x, origin_y);
 
-    // Also interpolate the value of 1/w for the current pixel
-    interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+    // A triangle whose bounding box holds a single pixel center must contain that center
+    if (min_x == max_x && min_y == max_y) {
+        if (setup->edges[0].c < 0 || setup->edges[1].c < 0 || setup->edges[2].c < 0) {
+            return false;
+        }
+    }
 
-    // Now we can divide back both interpolated values by 1/w
-    interpolated_u /= interpolated_reciprocal_w;
-    interpolated_v /= interpolated_reciprocal_w;
+    // Interpolate 1/w, and U/w and V/w for perspective correct texturing (V grows downwards)
+    float inv_area = 1.0f / area;
+    float inv_w0 = 1.0f / w0, inv_w1 = 1.0f / w1, inv_w2 = 1.0f / w2;
+    setup->inv_w = attribute_plane(
+        inv_w0, inv_w1, inv_w2,
+        x0, y0, x1, y1, x2, y2, inv_area, origin_x, origin_y
+    );
+    setup->u_over_w = attribute_plane(
+        a_uv.u * inv_w0, b_uv.u * inv_w1, c_uv.u * inv_w2,
+        x0, y0, x1, y1, x2, y2, inv_area, origin_x, origin_y
+    );
+    setup->v_over_w = attribute_plane(
+        (1 - a_uv.v) * inv_w0, (1 - b_uv.v) * inv_w1, (1 - c_uv.v) * inv_w2,
+        x0, y0, x1, y1, x2, y2, inv_area, origin_x, origin_y
+    );
+
+    setup->min_x = min_x;
+    setup->min_y = min_y;
+    setup->max_x = max_x;
+    setup->max_y = max_y;
+    setup->color = color;
+    setup->light_intensity = light_intensity;
+    setup->covers_pixels = true;
+    return true;
+}
 
-    // Map the UV coordinate to the full texture width and height
-    int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-    int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
+/*******************************************************/
+/* Conservative span of row y: each edge bounds the    */
+/* row on one side, so the pixels where all edges can  */
+/* pass are narrowed down to [start, end] (one extra   */
+/* pixel on each side). Returns false for empty rows.  */
+/*******************************************************/
+static inline bool row_span(const triangle_setup_t* t, int y, int* start, int* end) {
+    float fy = y - t->min_y;
+    float span_start = 0;
+    float span_end = t->max_x - t->min_x;
+
+    for (int i = 0; i < 3; ++i) {
+        float e = t->edges[i].c + t->edges[i].dy * fy;
+        float step = t->edges[i].dx;
+        if (step > 0) {
+            span_start = fmaxf(span_start, ceilf(-e / step) - 1);
+        } else if (step < 0) {
+            span_end = fminf(span_end, floorf(e / -step) + 1);
+        } else if (e < 0) {
+            span_end = -1;
+        }
+    }
 
-    // Adjust 1/w so the pixels that are closer to the camera have smaller values
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
+    if (span_start > span_end) {
+        return false;
+    }
+    *start = t->min_x + (int)span_start;
+    *end = t->min_x + (int)span_end;
+    return true;
+}
 
-    int zindex = (win_width * y + x) % (win_width * win_height);
-    if (zindex < 0) return;
-    if (interpolated_reciprocal_w < z_buffer[zindex]) {
-        int color_index = (texture_width * tex_y) + tex_x;
-        draw_pixel(x, y, update_color_intensity(texture[color_index], light_intensity));
-        // Update the z-buffer value with the 1/w of this current pixel
-        z_buffer[zindex] = interpolated_reciprocal_w;
+typedef enum {
+    BLOCK_OUTSIDE,
+    BLOCK_PARTIAL,
+    BLOCK_INSIDE,
+} block_coverage_t;
+
+/*******************************************************/
+/* Classify the pixel rectangle [x0, x1] x [y0, y1]    */
+/* against the triangle. An edge function is linear,   */
+/* so its extremes over the rectangle are at corners   */
+/* picked by the signs of its slopes.                  */
+/*******************************************************/
+static inline block_coverage_t classify_block(const triangle_setup_t* t, int x0, int y0, int x1, int y1) {
+    float fx = x0 - t->min_x;
+    float fy = y0 - t->min_y;
+    block_coverage_t coverage = BLOCK_INSIDE;
+    for (int i = 0; i < 3; ++i) {
+        plane_eq_t e = t->edges[i];
+        float corner = plane_eq_at(e, fx, fy);
+        float step_x = e.dx * (x1 - x0);
+        float step_y = e.dy * (y1 - y0);
+        float lowest = corner + fminf(step_x, 0) + fminf(step_y, 0);
+        float highest = corner + fmaxf(step_x, 0) + fmaxf(step_y, 0);
+        if (highest < 0) {
+            return BLOCK_OUTSIDE;
+        }
+        if (lowest < 0) {
+            coverage = BLOCK_PARTIAL;
+        }
     }
+    return coverage;
+}
+
+/*******************************************************/
+/* Walk the bounding box one row of 8x8 blocks at a    */
+/* time. Blocks inside the triangle are filled by the  */
+/* covered shader without edge tests; only the rest    */
+/* go through the per pixel tests of the span shader.  */
+/*******************************************************/
+static void rasterize_triangle(const triangle_setup_t* t, span_shader_t shader, span_shader_t covered_shader, const uint32_t* texture) {
+    bool tiled = framebuffer_layout == FRAMEBUFFER_TILED;
+
+    for (int block_y = t->min_y & ~TILE_MASK; block_y <= t->max_y; block_y += TILE_SIZE) {
+        int first_y = block_y > t->min_y ? block_y : t->min_y;
+        int last_y = block_y + TILE_MASK < t->max_y ? block_y + TILE_MASK : t->max_y;
+
+        // Spans of the rows of this block row, and the blocks they reach
+        int starts[TILE_SIZE], ends[TILE_SIZE];
+        int min_x = t->max_x + 1, max_x = t->min_x - 1;
+        for (int y = first_y; y <= last_y; ++y) {
+            int r = y - block_y;
+            if (!row_span(t, y, &starts[r], &ends[r])) {
+                starts[r] = 1;
+                ends[r] = 0;
+                continue;
+            }
+            if (starts[r] < min_x) min_x = starts[r];
+            if (ends[r] > max_x) max_x = ends[r];
+        }
+
+        if (tiled) {
+            // Tile by tile, so every tile is finished while its pixels are in cache
+            for (int block_x = min_x & ~TILE_MASK; block_x <= max_x; block_x += TILE_SIZE) {
+                int first_x = block_x > min_x ? block_x : min_x;
+                int last_x = block_x + TILE_MASK < max_x ? block_x + TILE_MASK : max_x;
+                block_coverage_t coverage = classify_block(t, first_x, first_y, last_x, last_y);
+                if (coverage == BLOCK_OUTSIDE) {
+                    continue;
+                }
+                for (int y = first_y; y <= last_y; ++y) {
+                    if (coverage == BLOCK_INSIDE) {
+                        covered_shader(t, y, first_x, last_x, pixel_index(first_x, y), texture);
+                        continue;
+                    }
+                    int r = y - block_y;
+                    int start = starts[r] > first_x ? starts[r] : first_x;
+                    int end = ends[r] < last_x ? ends[r] : last_x;
+                    if (start <= end) {
+                        shader(t, y, start, end, pixel_index(start, y), texture);
+                    }
+                }
+            }
+            continue;
+        }
 
+        // The blocks inside a convex triangle are consecutive; rows keep one span for them
+        int covered_start = max_x + 1, covered_end = min_x - 1;
+        for (int block_x = min_x & ~TILE_MASK; block_x <= max_x; block_x += TILE_SIZE) {
+            int first_x = block_x > min_x ? block_x : min_x;
+            int last_x = block_x + TILE_MASK < max_x ? block_x + TILE_MASK : max_x;
+            if (classify_block(t, first_x, first_y, last_x, last_y) == BLOCK_INSIDE) {
+                if (covered_start > covered_end) covered_start = first_x;
+                covered_end = last_x;
+            } else if (covered_start <= covered_end) {
+                break;
+            }
+        }
+
+        for (int y = first_y; y <= last_y; ++y) {
+            int r = y - block_y;
+            int row = y * buffer_stride;
+            if (starts[r] > ends[r]) {
+                continue;
+            }
+            if (covered_start > covered_end) {
+                shader(t, y, starts[r], ends[r], row + starts[r], texture);
+                continue;
+            }
+            // Inside pixels pass the edge tests, so the covered run lies within the row span
+            if (starts[r] < covered_start) {
+                shader(t, y, starts[r], covered_start - 1, row + starts[r], texture);
+            }
+            covered_shader(t, y, covered_start, covered_end, row + covered_start, texture);
+            if (ends[r] > covered_end) {
+                shader(t, y, covered_end + 1, ends[r], row + covered_end + 1, texture);
+            }
+        }
+    }
+}
+
+void rasterize_solid_triangle(const triangle_setup_t* triangle) {
+    rasterize_triangle(triangle, kernels.solid_span[depth_format], kernels.solid_covered_span[depth_format], NULL);
+}
+
+void rasterize_textured_triangle(const triangle_setup_t* triangle, const uint32_t* texture) {
+    if (texture_format == TEXTURE_FORMAT_BC1) {
+        rasterize_triangle(triangle, kernels.textured_bc1_span[depth_format], kernels.textured_bc1_covered_span[depth_format], texture);
+    } else if (texture_format == TEXTURE_FORMAT_PALETTE) {
+        rasterize_triangle(triangle, kernels.textured_palette_span[depth_format], kernels.textured_palette_covered_span[depth_format],
+            texture);
+    } else {
+        rasterize_triangle(triangle, kernels.textured_span[depth_format], kernels.textured_covered_span[depth_format], texture);
+    }
+}
+
+void rasterize_overdraw_triangle(const triangle_setup_t* triangle) {
+    rasterize_triangle(triangle, overdraw_span[depth_format], overdraw_covered_span[depth_format], NULL);
 }
 
 /*************************************/
@@ -296,95 +522,17 @@ void draw_filled_triangle_with_z(
     uint32_t color,
     float light_intensity
 ) {
-
-    if (y0 > y1) {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-    }
-    if (y1 > y2) {
-        int_swap(&y1, &y2);
-        int_swap(&x1, &x2);
-        float_swap(&z1, &z2);
-        float_swap(&w1, &w2);
-    }
-    if (y0 > y1) {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-    }
-
-    // New triangle points after sorting them
     vec4_t point_a = { x0, y0, z0, w0 };
     vec4_t point_b = { x1, y1, z1, w1 };
     vec4_t point_c = { x2, y2, z2, w2 };
+    tex2_t uv = { 0, 0 };
 
-    /*******************************************************/
-    /* Render the upper part of the triangle (float-bottom)*/
-    /*******************************************************/
-    float inv_slope_1 = 0;
-    float inv_slope_2 = 0;
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; ++y) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // Swap if x_start is to the right of the x_end
-            }
-
-            for (int x = x_start; x < x_end; ++x) {
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
-            }
-        }
-    }
-
-    /*******************************************************/
-    /* Render the bottom part of the triangle (float-top)  */
-    /*******************************************************/
-    inv_slope_1 = 0;
-    inv_slope_2 = 0;
-    if (y2 - y1 != 0) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; ++y) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // Swap if x_start is to the right of the x_end
-            }
-
-            for (int x = x_start; x < x_end; ++x) {
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
-            }
-        }
+    triangle_setup_t setup;
+    if (setup_triangle(&setup, point_a, point_b, point_c, uv, uv, uv, color, light_intensity)) {
+        rasterize_solid_triangle(&setup);
     }
 }
 
-/*************************************/
-/*                                   */
-/*        v0                         */
-/*        /\                         */
-/*       /  \                        */
-/*      /    \                       */
-/*     /      \                      */
-/*   v1--------\                     */
-/*     \_       \                    */
-/*        \_     \                   */
-/*           \_   \                  */
-/*              \_ \                 */
-/*                 \\                */
-/*                   \               */
-/*                    v2             */
-/*                                   */
-/*************************************/
 void draw_textured_triangle(
     int x0, int y0, float z0, float w0, float u0, float v0,
     int x1, int y1, float z1, float w1, float u1, float v1,
@@ -392,100 +540,15 @@ void draw_textured_triangle(
     uint32_t* texture,
     float light_intensity
 ) {
-
-    if (y0 > y1) {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-        float_swap(&u0, &u1);
-        float_swap(&v0, &v1);
-    }
-    if (y1 > y2) {
-        int_swap(&y1, &y2);
-        int_swap(&x1, &x2);
-        float_swap(&z1, &z2);
-        float_swap(&w1, &w2);
-        float_swap(&u1, &u2);
-        float_swap(&v1, &v2);
-    }
-    if (y0 > y1) {
-        int_swap(&y0, &y1);
-        int_swap(&x0, &x1);
-        float_swap(&z0, &z1);
-        float_swap(&w0, &w1);
-        float_swap(&u0, &u1);
-        float_swap(&v0, &v1);
-    }
-
-    // Fliped the V component to account for inverted UV coordinates (V grows downwards)
-    v0 = 1 - v0;
-    v1 = 1 - v1;
-    v2 = 1 - v2;
-
-    // New triangle points after sorting them
     vec4_t point_a = { x0, y0, z0, w0 };
     vec4_t point_b = { x1, y1, z1, w1 };
     vec4_t point_c = { x2, y2, z2, w2 };
-
-    // UV
     tex2_t uv_a = { u0, v0 };
     tex2_t uv_b = { u1, v1 };
     tex2_t uv_c = { u2, v2 };
-   
-    /*******************************************************/
-    /* Render the upper part of the triangle (float-bottom)*/
-    /*******************************************************/
-    float inv_slope_1 = 0;
-    float inv_slope_2 = 0;
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; ++y) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // Swap if x_start is to the right of the x_end
-            }
 
-            for (int x = x_start; x < x_end; ++x) {
-                draw_texel_perspective_correct(
-                    x, y, texture, light_intensity,
-                    point_a, point_b, point_c,
-                    uv_a, uv_b, uv_c
-                );
-            }
-        }
+    triangle_setup_t setup;
+    if (setup_triangle(&setup, point_a, point_b, point_c, uv_a, uv_b, uv_c, 0xFFFFFFFF, light_intensity)) {
+        rasterize_textured_triangle(&setup, texture);
     }
-
-    /*******************************************************/
-    /* Render the bottom part of the triangle (float-top)  */
-    /*******************************************************/
-    inv_slope_1 = 0;
-    inv_slope_2 = 0;
-    if (y2 - y1 != 0) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; ++y) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // Swap if x_start is to the right of the x_end
-            }
-
-            for (int x = x_start; x < x_end; ++x) {
-                draw_texel_perspective_correct(
-                    x, y, texture, light_intensity,
-                    point_a, point_b, point_c,
-                    uv_a, uv_b, uv_c
-                );
-            }
-        }
-    }
-
-
 }
@@ -3,15 +3,14 @@
 
 #include "texture.h"
 #include "vector.h"
+#include <stdbool.h>
 #include <stdint.h>
 
+// Indices of the mesh vertices of a triangle
 typedef struct {
     int a;
     int b;
     int c;
-    tex2_t a_uv;
-    tex2_t b_uv;
-    tex2_t c_uv;
     uint32_t color;
 } face_t;
 
@@ -23,6 +22,37 @@ typedef struct {
     // float avg_depth;
 } triangle_t;
 
+// Linear function over the screen: f(x, y) = c + dx * x + dy * y
+typedef struct {
+    float dx;
+    float dy;
+    float c;
+} plane_eq_t;
+
+// Compact triangle record produced by the setup stage. All planes are
+// evaluated relative to the center of the pixel (min_x, min_y).
+typedef struct {
+    plane_eq_t edges[3];            // Edge functions, >= 0 inside the triangle
+    plane_eq_t inv_w;               // 1/w
+    plane_eq_t u_over_w;            // U/w
+    plane_eq_t v_over_w;            // V/w
+    int16_t min_x, min_y;           // Inclusive pixel bounding box
+    int16_t max_x, max_y;
+    int16_t x[3], y[3];             // Screen vertices for the wireframe and vertex points
+    uint32_t color;
+    float light_intensity;
+    bool covers_pixels;             // False: only x and y are set, the triangle is outlined but not filled
+} triangle_setup_t;
+
+// Fills the pixels [x_start, x_end] of row y that pass the edge tests of the setup record.
+// They are stored at the consecutive buffer offsets index, index + 1, ... so in the
+// tiled layout a span never crosses a tile.
+typedef void (*span_shader_t)(const triangle_setup_t* t, int y, int x_start, int x_end, int index, const uint32_t* texture);
+
+static inline float plane_eq_at(plane_eq_t eq, float x, float y) {
+    return eq.c + eq.dx * x + eq.dy * y;
+}
+
 vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p);
 void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
 void draw_texel(
@@ -30,11 +60,6 @@ void draw_texel(
     vec2_t point_a, vec2_t point_b, vec2_t point_c,
     float u0, float v0, float u1, float v1, float u2, float v2
 );
-void draw_texel_perspective_correct(
-    int x, int y, uint32_t* texture, float light_intensity,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c,
-    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv
-);
 void draw_filled_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
 void draw_filled_triangle_with_z_buffer_hacky(
     int x0, int y0, float z0, float w0, float u0, float v0,
@@ -57,4 +82,17 @@ void draw_textured_triangle(
     uint32_t* texture,
     float light_intensity
 );
+// False for degenerate triangles and slivers that cover no pixel center: setup->x and y
+// are still set for the wireframe and vertex points, setup->covers_pixels is false
+bool setup_triangle(
+    triangle_setup_t* setup,
+    vec4_t point_a, vec4_t point_b, vec4_t point_c,
+    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv,
+    uint32_t color,
+    float light_intensity
+);
+void rasterize_solid_triangle(const triangle_setup_t* triangle);
+void rasterize_textured_triangle(const triangle_setup_t* triangle, const uint32_t* texture);
+// Counts depth tests and writes per pixel instead of shading (overdraw debug mode)
+void rasterize_overdraw_triangle(const triangle_setup_t* triangle);
 #endif // PK_TRIANGLE_H
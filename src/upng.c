@@ -28,8 +28,18 @@ freely, subject to the following restrictions:
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include "upng.h"
+#include "file_map.h"
+#include "memory.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UPNG_SSE2 1
+#include <emmintrin.h>
+#else
+#define UPNG_SSE2 0
+#endif
 
 #define MAKE_BYTE(b) ((b) & 0xFF)
 #define MAKE_DWORD(a,b,c,d) ((MAKE_BYTE(a) << 24) | (MAKE_BYTE(b) << 16) | (MAKE_BYTE(c) << 8) | MAKE_BYTE(d))
@@ -38,6 +48,8 @@ freely, subject to the following restrictions:
 #define CHUNK_IHDR MAKE_DWORD('I','H','D','R')
 #define CHUNK_IDAT MAKE_DWORD('I','D','A','T')
 #define CHUNK_IEND MAKE_DWORD('I','E','N','D')
+#define CHUNK_PLTE MAKE_DWORD('P','L','T','E')
+#define CHUNK_TRNS MAKE_DWORD('t','R','N','S')
 
 #define FIRST_LENGTH_CODE_INDEX 257
 #define LAST_LENGTH_CODE_INDEX 285
@@ -45,16 +57,19 @@ freely, subject to the following restrictions:
 #define NUM_DEFLATE_CODE_SYMBOLS 288	/*256 literals, the end code, some length codes, and 2 unused codes */
 #define NUM_DISTANCE_SYMBOLS 32	/*the distance codes have their own symbols, 30 used, 2 unused */
 #define NUM_CODE_LENGTH_CODES 19	/*the code length codes. 0-15: code lengths, 16: copy previous 3-6 times, 17: 3-10 zeros, 18: 11-138 zeros */
-#define MAX_SYMBOLS 288 /* largest number of symbols used by any tree type */
 
-#define DEFLATE_CODE_BITLEN 15
-#define DISTANCE_BITLEN 15
-#define CODE_LENGTH_BITLEN 7
 #define MAX_BIT_LENGTH 15 /* largest bitlen used by any tree type */
 
-#define DEFLATE_CODE_BUFFER_SIZE (NUM_DEFLATE_CODE_SYMBOLS * 2)
-#define DISTANCE_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
-#define CODE_LENGTH_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
+#define LITLEN_TABLE_BITS 10	/* codes up to this long decode in one lookup, longer ones through a subtable */
+#define DISTANCE_TABLE_BITS 8
+#define CODE_LENGTH_TABLE_BITS 7	/* code length codes are at most 7 bits long, no subtables */
+/* the primary table, then room for a subtable per symbol in the worst case */
+#define LITLEN_TABLE_SIZE ((1 << LITLEN_TABLE_BITS) + NUM_DEFLATE_CODE_SYMBOLS * (1 << (MAX_BIT_LENGTH - LITLEN_TABLE_BITS)))
+#define DISTANCE_TABLE_SIZE ((1 << DISTANCE_TABLE_BITS) + NUM_DISTANCE_SYMBOLS * (1 << (MAX_BIT_LENGTH - DISTANCE_TABLE_BITS)))
+
+#define DEFLATE_WINDOW_SIZE 32768	/* how far back a match may reach */
+#define MAX_MATCH_LENGTH 258
+#define INFLATE_SLACK 65536	/* inflated bytes between two slides of the window */
 
 #define SET_ERROR(upng,code) do { (upng)->error = (code); (upng)->error_line = __LINE__; } while (0)
 
@@ -72,6 +87,7 @@ typedef enum upng_state {
 typedef enum upng_color {
 	UPNG_LUM		= 0,
 	UPNG_RGB		= 2,
+	UPNG_PALETTE	= 3,
 	UPNG_LUMA		= 4,
 	UPNG_RGBA		= 6
 } upng_color;
@@ -80,6 +96,7 @@ typedef struct upng_source {
 	const unsigned char*	buffer;
 	unsigned long			size;
 	char					owning;
+	mapped_file_t			mapping;	/* backs buffer when it was mapped from a file */
 } upng_source;
 
 struct upng_t {
@@ -90,6 +107,9 @@ struct upng_t {
 	unsigned		color_depth;
 	upng_format		format;
 
+	unsigned char	palette[256 * 4];	/* RGBA entries of indexed images */
+	unsigned		palette_size;
+
 	unsigned char*	buffer;
 	unsigned long	size;
 
@@ -100,12 +120,6 @@ struct upng_t {
 	upng_source		source;
 };
 
-typedef struct huffman_tree {
-	unsigned* tree2d;
-	unsigned maxbitlen;	/*maximum number of bits a single code can get */
-	unsigned numcodes;	/*number of symbols in the alphabet = number of codes */
-} huffman_tree;
-
 static const unsigned LENGTH_BASE[29] = {	/*the base lengths represented by codes 257-285 */
 	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
 	67, 83, 99, 115, 131, 163, 195, 227, 258
@@ -129,547 +143,503 @@ static const unsigned DISTANCE_EXTRA[30] = {	/*the extra bits of backwards dista
 static const unsigned CLCL[NUM_CODE_LENGTH_CODES]	/*the order in which "code length alphabet code lengths" are stored, out of this the huffman tree of the dynamic huffman tree lengths is generated */
 = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
-static const unsigned FIXED_DEFLATE_CODE_TREE[NUM_DEFLATE_CODE_SYMBOLS * 2] = {
-	289, 370, 290, 307, 546, 291, 561, 292, 293, 300, 294, 297, 295, 296, 0, 1,
-	2, 3, 298, 299, 4, 5, 6, 7, 301, 304, 302, 303, 8, 9, 10, 11, 305, 306, 12,
-	13, 14, 15, 308, 339, 309, 324, 310, 317, 311, 314, 312, 313, 16, 17, 18,
-	19, 315, 316, 20, 21, 22, 23, 318, 321, 319, 320, 24, 25, 26, 27, 322, 323,
-	28, 29, 30, 31, 325, 332, 326, 329, 327, 328, 32, 33, 34, 35, 330, 331, 36,
-	37, 38, 39, 333, 336, 334, 335, 40, 41, 42, 43, 337, 338, 44, 45, 46, 47,
-	340, 355, 341, 348, 342, 345, 343, 344, 48, 49, 50, 51, 346, 347, 52, 53,
-	54, 55, 349, 352, 350, 351, 56, 57, 58, 59, 353, 354, 60, 61, 62, 63, 356,
-	363, 357, 360, 358, 359, 64, 65, 66, 67, 361, 362, 68, 69, 70, 71, 364,
-	367, 365, 366, 72, 73, 74, 75, 368, 369, 76, 77, 78, 79, 371, 434, 372,
-	403, 373, 388, 374, 381, 375, 378, 376, 377, 80, 81, 82, 83, 379, 380, 84,
-	85, 86, 87, 382, 385, 383, 384, 88, 89, 90, 91, 386, 387, 92, 93, 94, 95,
-	389, 396, 390, 393, 391, 392, 96, 97, 98, 99, 394, 395, 100, 101, 102, 103,
-	397, 400, 398, 399, 104, 105, 106, 107, 401, 402, 108, 109, 110, 111, 404,
-	419, 405, 412, 406, 409, 407, 408, 112, 113, 114, 115, 410, 411, 116, 117,
-	118, 119, 413, 416, 414, 415, 120, 121, 122, 123, 417, 418, 124, 125, 126,
-	127, 420, 427, 421, 424, 422, 423, 128, 129, 130, 131, 425, 426, 132, 133,
-	134, 135, 428, 431, 429, 430, 136, 137, 138, 139, 432, 433, 140, 141, 142,
-	143, 435, 483, 436, 452, 568, 437, 438, 445, 439, 442, 440, 441, 144, 145,
-	146, 147, 443, 444, 148, 149, 150, 151, 446, 449, 447, 448, 152, 153, 154,
-	155, 450, 451, 156, 157, 158, 159, 453, 468, 454, 461, 455, 458, 456, 457,
-	160, 161, 162, 163, 459, 460, 164, 165, 166, 167, 462, 465, 463, 464, 168,
-	169, 170, 171, 466, 467, 172, 173, 174, 175, 469, 476, 470, 473, 471, 472,
-	176, 177, 178, 179, 474, 475, 180, 181, 182, 183, 477, 480, 478, 479, 184,
-	185, 186, 187, 481, 482, 188, 189, 190, 191, 484, 515, 485, 500, 486, 493,
-	487, 490, 488, 489, 192, 193, 194, 195, 491, 492, 196, 197, 198, 199, 494,
-	497, 495, 496, 200, 201, 202, 203, 498, 499, 204, 205, 206, 207, 501, 508,
-	502, 505, 503, 504, 208, 209, 210, 211, 506, 507, 212, 213, 214, 215, 509,
-	512, 510, 511, 216, 217, 218, 219, 513, 514, 220, 221, 222, 223, 516, 531,
-	517, 524, 518, 521, 519, 520, 224, 225, 226, 227, 522, 523, 228, 229, 230,
-	231, 525, 528, 526, 527, 232, 233, 234, 235, 529, 530, 236, 237, 238, 239,
-	532, 539, 533, 536, 534, 535, 240, 241, 242, 243, 537, 538, 244, 245, 246,
-	247, 540, 543, 541, 542, 248, 249, 250, 251, 544, 545, 252, 253, 254, 255,
-	547, 554, 548, 551, 549, 550, 256, 257, 258, 259, 552, 553, 260, 261, 262,
-	263, 555, 558, 556, 557, 264, 265, 266, 267, 559, 560, 268, 269, 270, 271,
-	562, 565, 563, 564, 272, 273, 274, 275, 566, 567, 276, 277, 278, 279, 569,
-	572, 570, 571, 280, 281, 282, 283, 573, 574, 284, 285, 286, 287, 0, 0
-};
-
-static const unsigned FIXED_DISTANCE_TREE[NUM_DISTANCE_SYMBOLS * 2] = {
-	33, 48, 34, 41, 35, 38, 36, 37, 0, 1, 2, 3, 39, 40, 4, 5, 6, 7, 42, 45, 43,
-	44, 8, 9, 10, 11, 46, 47, 12, 13, 14, 15, 49, 56, 50, 53, 51, 52, 16, 17,
-	18, 19, 54, 55, 20, 21, 22, 23, 57, 60, 58, 59, 24, 25, 26, 27, 61, 62, 28,
-	29, 30, 31, 0, 0
-};
+/* decode table entries: bits 0-4 are the code bits to consume, bits 5-8 the extra bits that follow
+   (the index bits of the subtable for a link), bits 9-11 the kind and bits 16-31 the literal, the
+   base length or distance, the code length symbol or the offset of the subtable. Kind 0 is an invalid code. */
+#define ENTRY_LITERAL (1u << 9)
+#define ENTRY_MATCH (2u << 9)
+#define ENTRY_END (3u << 9)
+#define ENTRY_LINK (4u << 9)
+#define ENTRY_KIND(e) ((e) & (7u << 9))
+#define ENTRY_BITS(e) ((e) & 31u)
+#define ENTRY_EXTRA(e) (((e) >> 5) & 15u)
+#define ENTRY_VALUE(e) ((e) >> 16)
+
+#define MAX_MATCH_BITS (MAX_BIT_LENGTH + 5 + MAX_BIT_LENGTH + 13)	/* a length code with its extra bits, then a distance code with its own */
+
+/* reads the zlib stream straight from the IDAT chunks of the source, across their boundaries */
+typedef struct bit_reader {
+	const unsigned char* next;	/* next byte to load into the buffer */
+	const unsigned char* end;	/* end of the data of the current chunk */
+	const unsigned char* chunk;	/* the current IDAT chunk, NULL after the last one */
+	const unsigned char* source_end;
+	uint64_t buffer;	/* loaded bits, the next one to read in bit 0 */
+	unsigned count;	/* bits in the buffer */
+	unsigned padding;	/* zero bytes loaded past the end of the input */
+} bit_reader;
+
+typedef struct inflate_state {
+	uint32_t litlen[LITLEN_TABLE_SIZE];
+	uint32_t distance[DISTANCE_TABLE_SIZE];
+	uint32_t code_length[1 << CODE_LENGTH_TABLE_BITS];
+	uint32_t litlen_symbols[NUM_DEFLATE_CODE_SYMBOLS];	/* the entry of every symbol, without its code bits */
+	uint32_t distance_symbols[NUM_DISTANCE_SYMBOLS];
+	uint32_t code_length_symbols[NUM_CODE_LENGTH_CODES];
+	bit_reader br;
+	unsigned in_block;	/* a block is started and not finished */
+	unsigned final;	/* the current block is the last one */
+	unsigned btype;
+	unsigned long stored_left;	/* bytes of the current stored block not copied yet */
+	unsigned done;	/* the last block is finished */
+} inflate_state;
+
+static uint64_t load_le64(const unsigned char* p)
+{
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+		((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
 
-static unsigned char read_bit(unsigned long *bitpointer, const unsigned char *bitstream)
+/* moves to the data of the next IDAT chunk, false after the last one. the chunks were validated before */
+static int next_idat(bit_reader* br)
 {
-	unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> ((*bitpointer) & 0x7)) & 1);
-	(*bitpointer)++;
-	return result;
+	const unsigned char* chunk = br->chunk;
+	while (chunk != NULL) {
+		chunk += upng_chunk_length(chunk) + 12;
+		if (chunk + 12 > br->source_end || upng_chunk_type(chunk) == CHUNK_IEND) {
+			chunk = NULL;
+		} else if (upng_chunk_type(chunk) == CHUNK_IDAT) {
+			br->chunk = chunk;
+			br->next = chunk + 8;
+			br->end = br->next + upng_chunk_length(chunk);
+			return 1;
+		}
+	}
+	br->chunk = NULL;
+	return 0;
 }
 
-static unsigned read_bits(unsigned long *bitpointer, const unsigned char *bitstream, unsigned long nbits)
+/* tops the buffer up to 56 to 63 bits, enough for a length and a distance with their extra bits.
+   the fast path relies on the buffer never holding 64 bits, whatever the path of the previous refill */
+static void refill(bit_reader* br)
 {
-	unsigned result = 0, i;
-	for (i = 0; i < nbits; i++)
-		result |= ((unsigned)read_bit(bitpointer, bitstream)) << i;
-	return result;
+	if (br->end - br->next >= 8) {
+		/* the bytes that do not fit whole are loaded again next time, at the same bit positions */
+		br->buffer |= load_le64(br->next) << br->count;
+		br->next += (63 - br->count) >> 3;
+		br->count |= 56;
+	} else {
+		while (br->count < 56) {
+			if (br->next < br->end) {
+				br->buffer |= (uint64_t)*br->next++ << br->count;
+			} else if (br->chunk != NULL && next_idat(br)) {
+				continue;
+			} else {
+				br->padding++;
+			}
+			br->count += 8;
+		}
+	}
 }
 
-/* the buffer must be numcodes*2 in size! */
-static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned numcodes, unsigned maxbitlen)
+/* true once bits past the end of the input were read */
+static int overrun(const bit_reader* br)
 {
-	tree->tree2d = buffer;
+	return br->padding * 8 > br->count;
+}
 
-	tree->numcodes = numcodes;
-	tree->maxbitlen = maxbitlen;
+static void consume(bit_reader* br, unsigned nbits)
+{
+	br->buffer >>= nbits;
+	br->count -= nbits;
 }
 
-/*given the code lengths (as stored in the PNG file), generate the tree as defined by Deflate. maxbitlen is the maximum bits that a code in the tree can have. return value is error.*/
-static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const unsigned *bitlen)
+static unsigned take_bits(bit_reader* br, unsigned nbits)
 {
-	unsigned tree1d[MAX_SYMBOLS];
-	unsigned blcount[MAX_BIT_LENGTH];
-	unsigned nextcode[MAX_BIT_LENGTH+1];
-	unsigned bits, n, i;
-	unsigned nodefilled = 0;	/*up to which node it is filled */
-	unsigned treepos = 0;	/*position in the tree (1 of the numcodes columns) */
-
-	/* initialize local vectors */
-	memset(blcount, 0, sizeof(blcount));
-	memset(nextcode, 0, sizeof(nextcode));
+	unsigned result = (unsigned)(br->buffer & ((1u << nbits) - 1));
+	consume(br, nbits);
+	return result;
+}
 
-	/*step 1: count number of instances of each code length */
-	for (bits = 0; bits < tree->numcodes; bits++) {
-		blcount[bitlen[bits]]++;
+static unsigned reverse_bits(unsigned code, unsigned nbits)
+{
+	unsigned result = 0, i;
+	for (i = 0; i < nbits; i++) {
+		result = (result << 1) | ((code >> i) & 1);
 	}
+	return result;
+}
 
-	/*step 2: generate the nextcode values */
-	for (bits = 1; bits <= tree->maxbitlen; bits++) {
-		nextcode[bits] = (nextcode[bits - 1] + blcount[bits - 1]) << 1;
-	}
+/* fills the decode table of a canonical huffman code from its code lengths (as stored in the PNG file). codes up to
+   table_bits long are looked up in one step, the longer ones through a subtable. return value is false when the
+   lengths oversubscribe the code; codes left unused by an incomplete one decode as invalid entries. */
+static int build_decode_table(uint32_t* table, unsigned table_bits, const unsigned* bitlen, unsigned numcodes, const uint32_t* symbols)
+{
+	unsigned blcount[MAX_BIT_LENGTH + 1];
+	unsigned nextcode[MAX_BIT_LENGTH + 1];
+	unsigned maxbitlen = 0, code = 0, used = 1u << table_bits, subbits, bits, n, i;
+	int left = 1;
 
-	/*step 3: generate all the codes */
-	for (n = 0; n < tree->numcodes; n++) {
-		if (bitlen[n] != 0) {
-			tree1d[n] = nextcode[bitlen[n]]++;
-		}
+	memset(blcount, 0, sizeof(blcount));
+	for (n = 0; n < numcodes; n++) {
+		blcount[bitlen[n]]++;
 	}
+	blcount[0] = 0;
 
-	/*convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means uninited, a value >= numcodes is an address to another bit, a value < numcodes is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as many columns as codes - 1
-	   a good huffmann tree has N * 2 - 1 nodes, of which N - 1 are internal nodes. Here, the internal nodes are stored (what their 0 and 1 option point to). There is only memory for such good tree currently, if there are more nodes (due to too long length codes), error 55 will happen */
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		tree->tree2d[n] = 32767;	/*32767 here means the tree2d isn't filled there yet */
+	for (bits = 1; bits <= MAX_BIT_LENGTH; bits++) {
+		left = (left << 1) - (int)blcount[bits];
+		if (left < 0) {
+			return 0;
+		}
+		code = (code + blcount[bits - 1]) << 1;
+		nextcode[bits] = code;
+		if (blcount[bits] != 0) {
+			maxbitlen = bits;
+		}
 	}
-
-	for (n = 0; n < tree->numcodes; n++) {	/*the codes */
-		for (i = 0; i < bitlen[n]; i++) {	/*the bits for this code */
-			unsigned char bit = (unsigned char)((tree1d[n] >> (bitlen[n] - i - 1)) & 1);
-			/* check if oversubscribed */
-			if (treepos > tree->numcodes - 2) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
+	subbits = maxbitlen > table_bits ? maxbitlen - table_bits : 0;
+
+	memset(table, 0, sizeof(uint32_t) << table_bits);
+	for (n = 0; n < numcodes; n++) {
+		unsigned len = bitlen[n];
+		unsigned reversed;
+		if (len == 0) {
+			continue;
+		}
+		/* deflate sends the codes from their first bit, which is the lowest bit of the buffer */
+		reversed = reverse_bits(nextcode[len]++, len);
+		if (len <= table_bits) {
+			for (i = reversed; i < (1u << table_bits); i += 1u << len) {
+				table[i] = symbols[n] | len;
 			}
-
-			if (tree->tree2d[2 * treepos + bit] == 32767) {	/*not yet filled in */
-				if (i + 1 == bitlen[n]) {	/*last bit */
-					tree->tree2d[2 * treepos + bit] = n;	/*put the current code in it */
-					treepos = 0;
-				} else {	/*put address of the next step in here, first that address has to be found of course (it's just nodefilled + 1)... */
-					nodefilled++;
-					tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;	/*addresses encoded with numcodes added to it */
-					treepos = nodefilled;
-				}
-			} else {
-				treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
+		} else {
+			unsigned prefix = reversed & ((1u << table_bits) - 1);
+			uint32_t* subtable;
+			if (table[prefix] == 0) {
+				table[prefix] = (used << 16) | ENTRY_LINK | (subbits << 5) | table_bits;
+				memset(table + used, 0, sizeof(uint32_t) << subbits);
+				used += 1u << subbits;
+			}
+			subtable = table + ENTRY_VALUE(table[prefix]);
+			for (i = reversed >> table_bits; i < (1u << subbits); i += 1u << (len - table_bits)) {
+				subtable[i] = symbols[n] | (len - table_bits);
 			}
 		}
 	}
+	return 1;
+}
 
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		if (tree->tree2d[n] == 32767) {
-			tree->tree2d[n] = 0;	/*remove possible remaining 32767's */
-		}
+/* the buffer must hold the longest code */
+static uint32_t decode_entry(bit_reader* br, const uint32_t* table, unsigned table_bits)
+{
+	uint32_t entry = table[br->buffer & ((1u << table_bits) - 1)];
+	if (ENTRY_KIND(entry) == ENTRY_LINK) {
+		consume(br, table_bits);
+		entry = table[ENTRY_VALUE(entry) + (br->buffer & ((1u << ENTRY_EXTRA(entry)) - 1))];
 	}
+	consume(br, ENTRY_BITS(entry));
+	return entry;
 }
 
-static unsigned huffman_decode_symbol(upng_t *upng, const unsigned char *in, unsigned long *bp, const huffman_tree* codetree, unsigned long inlength)
+static void init_symbol_entries(inflate_state* s)
 {
-	unsigned treepos = 0, ct;
-	unsigned char bit;
-	for (;;) {
-		/* error: end of input memory reached without endcode */
-		if (((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
-		}
-
-		bit = read_bit(bp, in);
-
-		ct = codetree->tree2d[(treepos << 1) | bit];
-		if (ct < codetree->numcodes) {
-			return ct;
-		}
-
-		treepos = ct - codetree->numcodes;
-		if (treepos >= codetree->numcodes) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
+	unsigned n;
+	for (n = 0; n < NUM_DEFLATE_CODE_SYMBOLS; n++) {
+		if (n < 256) {
+			s->litlen_symbols[n] = (n << 16) | ENTRY_LITERAL;
+		} else if (n == 256) {
+			s->litlen_symbols[n] = ENTRY_END;
+		} else if (n <= LAST_LENGTH_CODE_INDEX) {
+			s->litlen_symbols[n] = (LENGTH_BASE[n - FIRST_LENGTH_CODE_INDEX] << 16) | ENTRY_MATCH | (LENGTH_EXTRA[n - FIRST_LENGTH_CODE_INDEX] << 5);
+		} else {
+			s->litlen_symbols[n] = 0;	/* 286 and 287 are never used */
 		}
 	}
+	for (n = 0; n < NUM_DISTANCE_SYMBOLS; n++) {
+		s->distance_symbols[n] = n < 30 ? (DISTANCE_BASE[n] << 16) | ENTRY_MATCH | (DISTANCE_EXTRA[n] << 5) : 0;
+	}
+	for (n = 0; n < NUM_CODE_LENGTH_CODES; n++) {
+		s->code_length_symbols[n] = (n << 16) | ENTRY_LITERAL;
+	}
 }
 
-/* get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
-static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffman_tree* codetreeD, huffman_tree* codelengthcodetree, const unsigned char *in, unsigned long *bp, unsigned long inlength)
+static void build_fixed_tables(upng_t* upng, inflate_state* s)
 {
-	unsigned codelengthcode[NUM_CODE_LENGTH_CODES];
 	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
 	unsigned bitlenD[NUM_DISTANCE_SYMBOLS];
-	unsigned n, hlit, hdist, hclen, i;
+	unsigned n;
 
-	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated */
-	/*C-code note: use no "return" between ctor and dtor of an uivector! */
-	if ((*bp) >> 3 >= inlength - 2) {
+	for (n = 0; n < NUM_DEFLATE_CODE_SYMBOLS; n++) {
+		bitlen[n] = n < 144 ? 8 : n < 256 ? 9 : n < 280 ? 7 : 8;
+	}
+	for (n = 0; n < NUM_DISTANCE_SYMBOLS; n++) {
+		bitlenD[n] = 5;
+	}
+	if (!build_decode_table(s->litlen, LITLEN_TABLE_BITS, bitlen, NUM_DEFLATE_CODE_SYMBOLS, s->litlen_symbols) ||
+		!build_decode_table(s->distance, DISTANCE_TABLE_BITS, bitlenD, NUM_DISTANCE_SYMBOLS, s->distance_symbols)) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
-		return;
 	}
+}
 
-	/* clear bitlen arrays */
-	memset(bitlen, 0, sizeof(bitlen));
-	memset(bitlenD, 0, sizeof(bitlenD));
+/* get the tables of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
+static void read_dynamic_tables(upng_t* upng, inflate_state* s, bit_reader* br)
+{
+	unsigned codelengthcode[NUM_CODE_LENGTH_CODES];
+	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS + NUM_DISTANCE_SYMBOLS];	/* the lit/len code lengths, then the distance ones: repeats may cross from one to the other */
+	unsigned hlit, hdist, hclen, i;
 
-	/*the bit pointer is or will go past the memory */
-	hlit = read_bits(bp, in, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
-	hdist = read_bits(bp, in, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
-	hclen = read_bits(bp, in, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
+	refill(br);
+	hlit = take_bits(br, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
+	hdist = take_bits(br, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
+	hclen = take_bits(br, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
 
 	for (i = 0; i < NUM_CODE_LENGTH_CODES; i++) {
-		if (i < hclen) {
-			codelengthcode[CLCL[i]] = read_bits(bp, in, 3);
-		} else {
-			codelengthcode[CLCL[i]] = 0;	/*if not, it must stay 0 */
-		}
+		refill(br);
+		codelengthcode[CLCL[i]] = i < hclen ? take_bits(br, 3) : 0;	/*if not, it must stay 0 */
 	}
-
-	huffman_tree_create_lengths(upng, codelengthcodetree, codelengthcode);
-
-	/* bail now if we encountered an error earlier */
-	if (upng->error != UPNG_EOK) {
+	if (overrun(br) || !build_decode_table(s->code_length, CODE_LENGTH_TABLE_BITS, codelengthcode, NUM_CODE_LENGTH_CODES, s->code_length_symbols)) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
 
-	/*now we can use this tree to read the lengths for the tree that this function will return */
+	/*now we can use this table to read the lengths of the two tables this function builds */
 	i = 0;
-	while (i < hlit + hdist) {	/*i is the current symbol we're reading in the part that contains the code lengths of lit/len codes and dist codes */
-		unsigned code = huffman_decode_symbol(upng, in, bp, codelengthcodetree, inlength);
-		if (upng->error != UPNG_EOK) {
-			break;
-		}
+	while (i < hlit + hdist) {
+		uint32_t entry;
+		unsigned code, value = 0, replength;
 
+		refill(br);
+		entry = decode_entry(br, s->code_length, CODE_LENGTH_TABLE_BITS);
+		if (ENTRY_KIND(entry) == 0 || overrun(br)) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
+		}
+		code = ENTRY_VALUE(entry);
 		if (code <= 15) {	/*a length code */
-			if (i < hlit) {
-				bitlen[i] = code;
-			} else {
-				bitlenD[i - hlit] = code;
-			}
-			i++;
-		} else if (code == 16) {	/*repeat previous */
-			unsigned replength = 3;	/*read in the 2 bits that indicate repeat length (3-6) */
-			unsigned value;	/*set value to the previous code */
-
-			if ((*bp) >> 3 >= inlength) {
+			bitlen[i++] = code;
+			continue;
+		}
+		if (code == 16) {	/*repeat previous 3-6 times */
+			if (i == 0) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
-				break;
-			}
-			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 2);
-
-			if ((i - 1) < hlit) {
-				value = bitlen[i - 1];
-			} else {
-				value = bitlenD[i - hlit - 1];
-			}
-
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
-
-				if (i < hlit) {
-					bitlen[i] = value;
-				} else {
-					bitlenD[i - hlit] = value;
-				}
-				i++;
+				return;
 			}
+			value = bitlen[i - 1];
+			replength = 3 + take_bits(br, 2);
 		} else if (code == 17) {	/*repeat "0" 3-10 times */
-			unsigned replength = 3;	/*read in the bits that indicate repeat length */
-			if ((*bp) >> 3 >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				break;
-			}
-
-			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 3);
-
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* error: i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
-
-				if (i < hlit) {
-					bitlen[i] = 0;
-				} else {
-					bitlenD[i - hlit] = 0;
-				}
-				i++;
-			}
-		} else if (code == 18) {	/*repeat "0" 11-138 times */
-			unsigned replength = 11;	/*read in the bits that indicate repeat length */
-			/* error, bit pointer jumps past memory */
-			if ((*bp) >> 3 >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				break;
-			}
-
-			replength += read_bits(bp, in, 7);
-
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
-				if (i < hlit)
-					bitlen[i] = 0;
-				else
-					bitlenD[i - hlit] = 0;
-				i++;
-			}
-		} else {
-			/* somehow an unexisting code appeared. This can never happen. */
+			replength = 3 + take_bits(br, 3);
+		} else {	/*repeat "0" 11-138 times */
+			replength = 11 + take_bits(br, 7);
+		}
+		/* i would be larger than the amount of codes */
+		if (replength > hlit + hdist - i) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
-			break;
+			return;
+		}
+		while (replength-- > 0) {
+			bitlen[i++] = value;
 		}
-	}
-
-	if (upng->error == UPNG_EOK && bitlen[256] == 0) {
-		SET_ERROR(upng, UPNG_EMALFORMED);
 	}
 
 	/*the length of the end code 256 must be larger than 0 */
-	/*now we've finally got hlit and hdist, so generate the code trees, and the function is done */
-	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetree, bitlen);
-	}
-	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetreeD, bitlenD);
+	if (bitlen[256] == 0 ||
+		!build_decode_table(s->litlen, LITLEN_TABLE_BITS, bitlen, hlit, s->litlen_symbols) ||
+		!build_decode_table(s->distance, DISTANCE_TABLE_BITS, bitlen + hlit, hdist, s->distance_symbols)) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
 	}
 }
 
-/*inflate a block with dynamic of fixed Huffman tree*/
-static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength, unsigned btype)
+/*inflate symbols of a block with dynamic of fixed Huffman tree until its end code, or until a match may not fit
+  in out; return value is true at the end of the block*/
+static int inflate_huffman(upng_t* upng, inflate_state* s, unsigned char* out, unsigned long outsize, unsigned long *pos)
 {
-	unsigned codetree_buffer[DEFLATE_CODE_BUFFER_SIZE];
-	unsigned codetreeD_buffer[DISTANCE_BUFFER_SIZE];
-	unsigned done = 0;
-
-	huffman_tree codetree;
-	huffman_tree codetreeD;
-
-	if (btype == 1) {
-		/* fixed trees */
-		huffman_tree_init(&codetree, (unsigned*)FIXED_DEFLATE_CODE_TREE, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, (unsigned*)FIXED_DISTANCE_TREE, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
-	} else if (btype == 2) {
-		/* dynamic trees */
-		unsigned codelengthcodetree_buffer[CODE_LENGTH_BUFFER_SIZE];
-		huffman_tree codelengthcodetree;
-
-		huffman_tree_init(&codetree, codetree_buffer, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, codetreeD_buffer, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
-		huffman_tree_init(&codelengthcodetree, codelengthcodetree_buffer, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
-		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
-	}
-
-	while (done == 0) {
-		unsigned code = huffman_decode_symbol(upng, in, bp, &codetree, inlength);
-		if (upng->error != UPNG_EOK) {
-			return;
+	bit_reader* br = &s->br;
+	unsigned char* op = out + *pos;
+	unsigned char* const oend = out + outsize;
+	int block_done = 0;
+
+	while ((unsigned long)(oend - op) >= MAX_MATCH_LENGTH) {
+		uint32_t entry;
+		unsigned long length, distance;
+		const unsigned char* from;
+
+		/* a refill covers a length and a distance with their extra bits, literals take less */
+		if (br->count < MAX_MATCH_BITS) {
+			refill(br);
+		}
+		if (br->padding != 0 && overrun(br)) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
 		}
 
-		if (code == 256) {
-			/* end code */
-			done = 1;
-		} else if (code <= 255) {
-			/* literal symbol */
-			if ((*pos) >= outsize) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-
-			/* store output */
-			out[(*pos)++] = (unsigned char)(code);
-		} else if (code >= FIRST_LENGTH_CODE_INDEX && code <= LAST_LENGTH_CODE_INDEX) {	/*length code */
-			/* part 1: get length base */
-			unsigned long length = LENGTH_BASE[code - FIRST_LENGTH_CODE_INDEX];
-			unsigned codeD, distance, numextrabitsD;
-			unsigned long start, forward, backward, numextrabits;
-
-			/* part 2: get extra bits and add the value of that to length */
-			numextrabits = LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX];
-
-			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-			length += read_bits(bp, in, numextrabits);
-
-			/*part 3: get distance code */
-			codeD = huffman_decode_symbol(upng, in, bp, &codetreeD, inlength);
-			if (upng->error != UPNG_EOK) {
-				return;
-			}
-
-			/* invalid distance code (30-31 are never used) */
-			if (codeD > 29) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-
-			distance = DISTANCE_BASE[codeD];
-
-			/*part 4: get extra bits from distance */
-			numextrabitsD = DISTANCE_EXTRA[codeD];
-
-			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-
-			distance += read_bits(bp, in, numextrabitsD);
-
-			/*part 5: fill in all the out[n] values based on the length and dist */
-			start = (*pos);
-			backward = start - distance;
+		entry = decode_entry(br, s->litlen, LITLEN_TABLE_BITS);
+		if (ENTRY_KIND(entry) == ENTRY_LITERAL) {
+			*op++ = (unsigned char)ENTRY_VALUE(entry);
+			continue;
+		}
+		if (ENTRY_KIND(entry) == ENTRY_END) {
+			block_done = 1;
+			break;
+		}
+		if (ENTRY_KIND(entry) != ENTRY_MATCH) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
+		}
+		length = ENTRY_VALUE(entry) + take_bits(br, ENTRY_EXTRA(entry));
 
-			if ((*pos) + length >= outsize) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
+		entry = decode_entry(br, s->distance, DISTANCE_TABLE_BITS);
+		if (ENTRY_KIND(entry) != ENTRY_MATCH) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
+		}
+		distance = ENTRY_VALUE(entry) + take_bits(br, ENTRY_EXTRA(entry));
 
-			for (forward = 0; forward < length; forward++) {
-				out[(*pos)++] = out[backward];
-				backward++;
+		if (distance > (unsigned long)(op - out)) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
+		}
 
-				if (backward >= start) {
-					backward = start - distance;
-				}
+		from = op - distance;
+		if (distance >= 8 && (unsigned long)(oend - op) >= length + 8) {
+			/* whole words: every word read was written before, the bytes past the match are overwritten later */
+			unsigned char* stop = op + length;
+			do {
+				memcpy(op, from, 8);
+				op += 8;
+				from += 8;
+			} while (op < stop);
+			op = stop;
+		} else if (distance == 1) {
+			memset(op, *from, length);
+			op += length;
+		} else {
+			while (length-- > 0) {
+				*op++ = *from++;
 			}
 		}
 	}
+
+	*pos = (unsigned long)(op - out);
+	return block_done;
 }
 
-static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength)
+/*copy the data of a stored block into out, as much of it as fits; return value is true at the end of the block*/
+static int inflate_uncompressed(upng_t* upng, inflate_state* s, unsigned char* out, unsigned long outsize, unsigned long *pos)
 {
-	unsigned long p;
-	unsigned len, nlen, n;
+	bit_reader* br = &s->br;
 
-	/* go to first boundary of byte */
-	while (((*bp) & 0x7) != 0) {
-		(*bp)++;
+	/* the whole bytes left in the buffer come first, then the chunks are read in place */
+	while (s->stored_left > 0 && (*pos) < outsize && br->count >= 8 + br->padding * 8) {
+		out[(*pos)++] = (unsigned char)take_bits(br, 8);
+		s->stored_left--;
 	}
-	p = (*bp) / 8;		/*byte position */
-
-	/* read len (2 bytes) and nlen (2 bytes) */
-	if (p >= inlength - 4) {
-		SET_ERROR(upng, UPNG_EMALFORMED);
-		return;
+	if (br->count < 8) {
+		br->buffer = 0;
+		br->count = 0;
 	}
-
-	len = in[p] + 256 * in[p + 1];
-	p += 2;
-	nlen = in[p] + 256 * in[p + 1];
-	p += 2;
-
-	/* check if 16-bit nlen is really the one's complement of len */
-	if (len + nlen != 65535) {
-		SET_ERROR(upng, UPNG_EMALFORMED);
-		return;
+	while (s->stored_left > 0 && (*pos) < outsize) {
+		unsigned long n = s->stored_left;
+		if (br->count != 0 || (br->next == br->end && !next_idat(br))) {
+			/* the input ends inside the block */
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return 0;
+		}
+		if (n > (unsigned long)(br->end - br->next)) {
+			n = (unsigned long)(br->end - br->next);
+		}
+		if (n > outsize - (*pos)) {
+			n = outsize - (*pos);
+		}
+		memcpy(out + (*pos), br->next, n);
+		br->next += n;
+		(*pos) += n;
+		s->stored_left -= n;
 	}
+	return s->stored_left == 0;
+}
 
-	if ((*pos) + len >= outsize) {
-		SET_ERROR(upng, UPNG_EMALFORMED);
-		return;
-	}
+/*read the header of the next block, and its tables*/
+static void start_block(upng_t* upng, inflate_state* s)
+{
+	bit_reader* br = &s->br;
 
-	/* read the literal data: len bytes are now stored in the out buffer */
-	if (p + len > inlength) {
+	/* read block control bits */
+	refill(br);
+	if (overrun(br)) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
+	s->final = take_bits(br, 1);
+	s->btype = take_bits(br, 2);
 
-	for (n = 0; n < len; n++) {
-		out[(*pos)++] = in[p++];
+	/* process control type appropriateyly */
+	if (s->btype == 3) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+	} else if (s->btype == 0) {
+		/* go to first boundary of byte, read len (2 bytes) and nlen (2 bytes) */
+		unsigned len, nlen;
+		consume(br, br->count & 7);
+		refill(br);
+		len = take_bits(br, 16);
+		nlen = take_bits(br, 16);
+		/* check if 16-bit nlen is really the one's complement of len */
+		if (overrun(br) || len + nlen != 65535) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+		}
+		s->stored_left = len;
+	} else if (s->btype == 1) {
+		build_fixed_tables(upng, s);
+	} else {
+		read_dynamic_tables(upng, s, br);
 	}
-
-	(*bp) = p * 8;
+	s->in_block = 1;
 }
 
-/*inflate the deflated data (cfr. deflate spec); return value is the error*/
-static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long insize, unsigned long inpos)
+/*inflate the deflated data (cfr. deflate spec) into out[*pos, outsize), up to the end of the stream or until out is
+  nearly full: the next call carries on from there*/
+static void inflate_some(upng_t* upng, inflate_state* s, unsigned char* out, unsigned long outsize, unsigned long *pos)
 {
-	unsigned long bp = 0;	/*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte) */
-	unsigned long pos = 0;	/*byte position in the out buffer */
-
-	unsigned done = 0;
-
-	while (done == 0) {
-		unsigned btype;
-
-		/* ensure next bit doesn't point past the end of the buffer */
-		if ((bp >> 3) >= insize) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
+	while (s->done == 0 && upng->error == UPNG_EOK) {
+		int block_done;
+		if (s->in_block == 0) {
+			start_block(upng, s);
+			if (upng->error != UPNG_EOK) {
+				return;
+			}
 		}
 
-		/* read block control bits */
-		done = read_bit(&bp, &in[inpos]);
-		btype = read_bit(&bp, &in[inpos]) | (read_bit(&bp, &in[inpos]) << 1);
-
-		/* process control type appropriateyly */
-		if (btype == 3) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
-		} else if (btype == 0) {
-			inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize);	/*no compression */
+		if (s->btype == 0) {
+			block_done = inflate_uncompressed(upng, s, out, outsize, pos);	/*no compression */
 		} else {
-			inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize, btype);	/*compression, btype 01 or 10 */
+			block_done = inflate_huffman(upng, s, out, outsize, pos);	/*compression, btype 01 or 10 */
 		}
-
-		/* stop if an error has occured */
-		if (upng->error != UPNG_EOK) {
-			return upng->error;
+		if (!block_done) {
+			return;
 		}
+		s->in_block = 0;
+		s->done = s->final;
 	}
-
-	return upng->error;
 }
 
-static upng_error uz_inflate(upng_t* upng, unsigned char *out, unsigned long outsize, const unsigned char *in, unsigned long insize)
+/*check the zlib header in front of the deflated data*/
+static void read_zlib_header(upng_t* upng, bit_reader* br)
 {
+	unsigned cmf, flg;
+
 	/* we require two bytes for the zlib data header */
-	if (insize < 2) {
+	refill(br);
+	if (overrun(br)) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
-		return upng->error;
+		return;
 	}
+	cmf = take_bits(br, 8);
+	flg = take_bits(br, 8);
 
-	/* 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way */
-	if ((in[0] * 256 + in[1]) % 31 != 0) {
+	/* 256 * cmf + flg must be a multiple of 31, the FCHECK value is supposed to be made that way */
+	if ((cmf * 256 + flg) % 31 != 0) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
-		return upng->error;
+		return;
 	}
 
 	/*error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec */
-	if ((in[0] & 15) != 8 || ((in[0] >> 4) & 15) > 7) {
+	if ((cmf & 15) != 8 || ((cmf >> 4) & 15) > 7) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
-		return upng->error;
+		return;
 	}
 
 	/* the specification of PNG says about the zlib stream: "The additional flags shall not specify a preset dictionary." */
-	if (((in[1] >> 5) & 1) != 0) {
+	if (((flg >> 5) & 1) != 0) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
-		return upng->error;
 	}
-
-	/* create output buffer */
-	uz_inflate_data(upng, out, outsize, in, insize, 2);
-
-	return upng->error;
 }
 
 /*Paeth predicter, used by PNG filter type 4*/
@@ -688,6 +658,133 @@ static int paeth_predictor(int a, int b, int c)
 		return c;
 }
 
+#if UPNG_SSE2
+/*SSE2 unfiltering of scanlines of 3 and 4 byte pixels, what most textures are made of. Sub, Average and Paeth
+  depend on the pixel to the left, so they take a whole pixel per step; Up takes 16 bytes per step*/
+static __m128i load_pixel(const unsigned char *p, unsigned long bytewidth)
+{
+	int v = 0;
+	memcpy(&v, p, bytewidth);
+	return _mm_cvtsi32_si128(v);
+}
+
+static void store_pixel(unsigned char *p, __m128i v, unsigned long bytewidth)
+{
+	int t = _mm_cvtsi128_si32(v);
+	memcpy(p, &t, bytewidth);
+}
+
+static void unfilter_sub_sse2(unsigned char *recon, const unsigned char *scanline, unsigned long bytewidth, unsigned long length)
+{
+	__m128i a = _mm_setzero_si128();
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		a = _mm_add_epi8(a, load_pixel(scanline + i, bytewidth));
+		store_pixel(recon + i, a, bytewidth);
+	}
+}
+
+static void unfilter_up_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long length)
+{
+	unsigned long i;
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+		_mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+	}
+	for (; i < length; i++)
+		recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilter_average_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned long length)
+{
+	__m128i a = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		__m128i b = load_pixel(precon + i, bytewidth);
+		/* _mm_avg_epu8 rounds up, the filter rounds down */
+		__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(average, load_pixel(scanline + i, bytewidth));
+		store_pixel(recon + i, a, bytewidth);
+	}
+}
+
+static void unfilter_paeth_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned long length)
+{
+	/* a, b and c are the left, up and up-left pixels, widened to 16 bits so p - a, p - b and p - c do not wrap */
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = zero, c = zero;
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		__m128i b = _mm_unpacklo_epi8(load_pixel(precon + i, bytewidth), zero);
+		__m128i x = _mm_unpacklo_epi8(load_pixel(scanline + i, bytewidth), zero);
+		__m128i pa = _mm_sub_epi16(b, c);	/* p - a = b - c */
+		__m128i pb = _mm_sub_epi16(a, c);	/* p - b = a - c */
+		__m128i pc = _mm_add_epi16(pa, pb);	/* p - c = a + b - 2c */
+		__m128i smallest, nearest, is_a, is_b;
+
+		pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+		smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+		/* a on ties with a, then b on ties with b, as the predictor breaks them */
+		is_a = _mm_cmpeq_epi16(pa, smallest);
+		is_b = _mm_andnot_si128(is_a, _mm_cmpeq_epi16(pb, smallest));
+		nearest = _mm_or_si128(_mm_and_si128(is_a, a), _mm_andnot_si128(is_a, c));
+		nearest = _mm_or_si128(_mm_and_si128(is_b, b), _mm_andnot_si128(is_b, nearest));
+
+		/* bytewise add: the high byte of every 16 bit lane stays 0 */
+		a = _mm_add_epi8(nearest, x);
+		store_pixel(recon + i, _mm_packus_epi16(a, a), bytewidth);
+		c = b;
+	}
+}
+
+/*returns 1 when the scanline was unfiltered with SSE2, 0 to leave it to the scalar code*/
+static int unfilter_scanline_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
+{
+	if (filterType == 2 && precon) {
+		unfilter_up_sse2(recon, scanline, precon, length);
+		return 1;
+	}
+	if (bytewidth != 3 && bytewidth != 4) {
+		return 0;
+	}
+	/* the constant widths let the compiler turn the pixel loads and stores into single moves */
+	switch (filterType) {
+	case 1:
+		if (bytewidth == 3)
+			unfilter_sub_sse2(recon, scanline, 3, length);
+		else
+			unfilter_sub_sse2(recon, scanline, 4, length);
+		return 1;
+	case 3:
+		if (!precon)
+			return 0;
+		if (bytewidth == 3)
+			unfilter_average_sse2(recon, scanline, precon, 3, length);
+		else
+			unfilter_average_sse2(recon, scanline, precon, 4, length);
+		return 1;
+	case 4:
+		/* without a previous scanline, Paeth always picks the left pixel: it is Sub */
+		if (!precon && bytewidth == 3)
+			unfilter_sub_sse2(recon, scanline, 3, length);
+		else if (!precon)
+			unfilter_sub_sse2(recon, scanline, 4, length);
+		else if (bytewidth == 3)
+			unfilter_paeth_sse2(recon, scanline, precon, 3, length);
+		else
+			unfilter_paeth_sse2(recon, scanline, precon, 4, length);
+		return 1;
+	default:
+		return 0;
+	}
+}
+#endif
+
 static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
 {
 	/*
@@ -699,6 +796,11 @@ static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned
 	 */
 
 	unsigned long i;
+#if UPNG_SSE2
+	if (unfilter_scanline_sse2(recon, scanline, precon, bytewidth, filterType, length)) {
+		return;
+	}
+#endif
 	switch (filterType) {
 	case 0:
 		for (i = 0; i < length; i++)
@@ -750,84 +852,212 @@ static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned
 	}
 }
 
-static void unfilter(upng_t* upng, unsigned char *out, const unsigned char *in, unsigned w, unsigned h, unsigned bpp)
+/*read sample x of a scanline with depth bits per sample; below 8 bits, the samples are packed from the high bits on*/
+static unsigned row_sample(const unsigned char *in, unsigned long x, unsigned depth)
 {
-	/*
-	   For PNG filter method 0
-	   this function unfilters a single image (e.g. without interlacing this is called once, with Adam7 it's called 7 times)
-	   out must have enough bytes allocated already, in must have the scanlines + 1 filtertype byte per scanline
-	   w and h are image dimensions or dimensions of reduced image, bpp is bpp per pixel
-	   in and out are allowed to be the same memory address!
-	 */
-
-	unsigned y;
-	unsigned char *prevline = 0;
-
-	unsigned long bytewidth = (bpp + 7) / 8;	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise */
-	unsigned long linebytes = (w * bpp + 7) / 8;
+	unsigned long bit = x * depth;
+	return (in[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+}
 
-	for (y = 0; y < h; y++) {
-		unsigned long outindex = linebytes * y;
-		unsigned long inindex = (1 + linebytes) * y;	/*the extra filterbyte added to each row */
-		unsigned char filterType = in[inindex];
+/*widen an unfiltered scanline of w pixels to 8 bit R, G, B, A in memory order. 16 bit samples keep their high
+  byte, and luminance below 8 bits is scaled to the full range*/
+static void convert_row_rgba(const upng_t* upng, unsigned char *out, const unsigned char *in, unsigned w)
+{
+	unsigned depth = upng->color_depth;
+	unsigned scale = depth < 8 ? 255 / ((1u << depth) - 1) : 1;
+	unsigned x;
 
-		unfilter_scanline(upng, &out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes);
-		if (upng->error != UPNG_EOK) {
-			return;
+	switch (upng->format) {
+	case UPNG_RGBA8:
+		memcpy(out, in, (size_t)w * 4);
+		break;
+	case UPNG_RGB8:
+		for (x = 0; x < w; x++, out += 4, in += 3) {
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+			out[3] = 255;
 		}
-
-		prevline = &out[outindex];
+		break;
+	case UPNG_RGBA16:
+		for (x = 0; x < w; x++, out += 4, in += 8) {
+			out[0] = in[0];
+			out[1] = in[2];
+			out[2] = in[4];
+			out[3] = in[6];
+		}
+		break;
+	case UPNG_RGB16:
+		for (x = 0; x < w; x++, out += 4, in += 6) {
+			out[0] = in[0];
+			out[1] = in[2];
+			out[2] = in[4];
+			out[3] = 255;
+		}
+		break;
+	case UPNG_LUMINANCE8:
+		for (x = 0; x < w; x++, out += 4) {
+			out[0] = out[1] = out[2] = in[x];
+			out[3] = 255;
+		}
+		break;
+	case UPNG_LUMINANCE_ALPHA8:
+		for (x = 0; x < w; x++, out += 4, in += 2) {
+			out[0] = out[1] = out[2] = in[0];
+			out[3] = in[1];
+		}
+		break;
+	case UPNG_LUMINANCE1:
+	case UPNG_LUMINANCE2:
+	case UPNG_LUMINANCE4:
+		for (x = 0; x < w; x++, out += 4) {
+			out[0] = out[1] = out[2] = (unsigned char)(row_sample(in, x, depth) * scale);
+			out[3] = 255;
+		}
+		break;
+	case UPNG_LUMINANCE_ALPHA1:
+	case UPNG_LUMINANCE_ALPHA2:
+	case UPNG_LUMINANCE_ALPHA4:
+		for (x = 0; x < w; x++, out += 4) {
+			out[0] = out[1] = out[2] = (unsigned char)(row_sample(in, 2 * x, depth) * scale);
+			out[3] = (unsigned char)(row_sample(in, 2 * x + 1, depth) * scale);
+		}
+		break;
+	case UPNG_INDEXED8:
+		for (x = 0; x < w; x++, out += 4) {
+			memcpy(out, upng->palette + in[x] * 4, 4);
+		}
+		break;
+	case UPNG_INDEXED1:
+	case UPNG_INDEXED2:
+	case UPNG_INDEXED4:
+		for (x = 0; x < w; x++, out += 4) {
+			memcpy(out, upng->palette + row_sample(in, x, depth) * 4, 4);
+		}
+		break;
+	default:
+		break;
 	}
 }
 
-static void remove_padding_bits(unsigned char *out, const unsigned char *in, unsigned long olinebits, unsigned long ilinebits, unsigned h)
+/*copy the nbits first bits of in to out from bit obp on: the padding bits that end the scanlines of images with
+  less than 8 bits per pixel are not kept in the output*/
+static void pack_row_bits(unsigned char *out, unsigned long obp, const unsigned char *in, unsigned long nbits)
 {
-	/*
-	   After filtering there are still padding bpp if scanlines have non multiple of 8 bit amounts. They need to be removed (except at last scanline of (Adam7-reduced) image) before working with pure image buffers for the Adam7 code, the color convert code and the output to the user.
-	   in and out are allowed to be the same buffer, in may also be higher but still overlapping; in must have >= ilinebits*h bpp, out must have >= olinebits*h bpp, olinebits must be <= ilinebits
-	   also used to move bpp after earlier such operations happened, e.g. in a sequence of reduced images from Adam7
-	   only useful if (ilinebits - olinebits) is a value in the range 1..7
-	 */
-	unsigned y;
-	unsigned long diff = ilinebits - olinebits;
-	unsigned long obp = 0, ibp = 0;	/*bit pointers */
-	for (y = 0; y < h; y++) {
-		unsigned long x;
-		for (x = 0; x < olinebits; x++) {
-			unsigned char bit = (unsigned char)((in[(ibp) >> 3] >> (7 - ((ibp) & 0x7))) & 1);
-			ibp++;
-
-			if (bit == 0)
-				out[(obp) >> 3] &= (unsigned char)(~(1 << (7 - ((obp) & 0x7))));
-			else
-				out[(obp) >> 3] |= (1 << (7 - ((obp) & 0x7)));
-			++obp;
-		}
-		ibp += diff;
+	unsigned long ibp;
+	for (ibp = 0; ibp < nbits; ibp++, obp++) {
+		unsigned char bit = (unsigned char)((in[ibp >> 3] >> (7 - (ibp & 0x7))) & 1);
+		if (bit == 0)
+			out[obp >> 3] &= (unsigned char)(~(1 << (7 - (obp & 0x7))));
+		else
+			out[obp >> 3] |= (1 << (7 - (obp & 0x7)));
 	}
 }
 
-/*out must be buffer big enough to contain full image, and in must contain the full decompressed data from the IDAT chunks*/
-static void post_process_scanlines(upng_t* upng, unsigned char *out, unsigned char *in, const upng_t* info_png)
+/*inflate the IDAT chunks of the source starting at first_idat, and unfilter every scanline into out as soon as it
+  is complete, converted to RGBA when rgba is set. the inflated data goes through a window that only keeps the
+  last 32k (for the matches) and the scanline in progress, instead of the whole filtered image*/
+static void decode_scanlines(upng_t* upng, unsigned char *out, const unsigned char *first_idat, int rgba)
 {
-	unsigned bpp = upng_get_bpp(info_png);
-	unsigned w = info_png->width;
-	unsigned h = info_png->height;
+	unsigned bpp = upng_get_bpp(upng);
+	unsigned w = upng->width;
+	unsigned h = upng->height;
+	unsigned long bytewidth = (bpp + 7) / 8;	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise */
+	unsigned long linebytes = ((unsigned long)w * bpp + 7) / 8;
+	unsigned long olinebits = (unsigned long)w * bpp;
+	int padded = bpp < 8 && olinebits != linebytes * 8;
+	int aside = padded || (rgba && upng->format != UPNG_RGBA8);
+	unsigned long window_size, pos = 0, row = 0;
+	unsigned char *window, *lines = NULL;
+	unsigned char *prevline = NULL;
+	inflate_state* s;
+	unsigned y = 0;
 
 	if (bpp == 0) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
 
-	if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8) {
-		unfilter(upng, in, in, w, h, bpp);
+	/* the window never needs to be larger than the whole filtered image */
+	window_size = DEFLATE_WINDOW_SIZE + 2 * (linebytes + 1) + INFLATE_SLACK;
+	if (window_size > (unsigned long)h * (linebytes + 1) + MAX_MATCH_LENGTH) {
+		window_size = (unsigned long)h * (linebytes + 1) + MAX_MATCH_LENGTH;
+	}
+	s = (inflate_state*)memory_alloc(MEMORY_PNG, sizeof(inflate_state));
+	window = (unsigned char*)memory_alloc(MEMORY_PNG, window_size);
+	/* scanlines with padding bits or to convert are unfiltered aside, the current one and the previous one */
+	if (aside) {
+		lines = (unsigned char*)memory_alloc(MEMORY_PNG, 2 * linebytes);
+	}
+	if (s == NULL || window == NULL || (aside && lines == NULL)) {
+		SET_ERROR(upng, UPNG_ENOMEM);
+		memory_free(s);
+		memory_free(window);
+		memory_free(lines);
+		return;
+	}
+
+	/* packing the rows only sets the bits of the pixels, the ones after the last pixel stay 0 */
+	if (padded && !rgba && h != 0) {
+		out[(olinebits * h + 7) / 8 - 1] = 0;
+	}
+
+	init_symbol_entries(s);
+	s->in_block = 0;
+	s->done = 0;
+	s->br.chunk = first_idat;
+	s->br.next = first_idat + 8;
+	s->br.end = s->br.next + upng_chunk_length(first_idat);
+	s->br.source_end = upng->source.buffer + upng->source.size;
+	s->br.buffer = 0;
+	s->br.count = 0;
+	s->br.padding = 0;
+	read_zlib_header(upng, &s->br);
+
+	while (upng->error == UPNG_EOK) {
+		unsigned long keep_from;
+
+		inflate_some(upng, s, window, window_size, &pos);
 		if (upng->error != UPNG_EOK) {
-			return;
+			break;
 		}
-		remove_padding_bits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
-	} else {
-		unfilter(upng, out, in, w, h, bpp);	/*we can immediatly filter into the out buffer, no other steps needed */
+
+		/* unfilter the complete scanlines, each one after its filter type byte */
+		for (; y < h && pos - row > linebytes; y++, row += linebytes + 1) {
+			unsigned char* recon = aside ? lines + (y & 1) * linebytes : out + linebytes * y;
+			unfilter_scanline(upng, recon, window + row + 1, prevline, bytewidth, window[row], linebytes);
+			if (upng->error != UPNG_EOK) {
+				break;
+			}
+			if (rgba && aside) {
+				convert_row_rgba(upng, out + (unsigned long)w * 4 * y, recon, w);
+			} else if (padded) {
+				pack_row_bits(out, olinebits * y, recon, olinebits);
+			}
+			prevline = recon;
+		}
+		if (y == h || upng->error != UPNG_EOK) {
+			break;
+		}
+		/* the stream ended before the last scanline */
+		if (s->done) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
+		}
+
+		/* slide the window: keep what matches may reach back to, and the scanline in progress */
+		keep_from = pos > DEFLATE_WINDOW_SIZE ? pos - DEFLATE_WINDOW_SIZE : 0;
+		if (keep_from > row) {
+			keep_from = row;
+		}
+		memmove(window, window + keep_from, pos - keep_from);
+		pos -= keep_from;
+		row -= keep_from;
 	}
+
+	memory_free(lines);
+	memory_free(window);
+	memory_free(s);
 }
 
 static upng_format determine_format(upng_t* upng) {
@@ -876,6 +1106,19 @@ static upng_format determine_format(upng_t* upng) {
 		default:
 			return UPNG_BADFORMAT;
 		}
+	case UPNG_PALETTE:
+		switch (upng->color_depth) {
+		case 1:
+			return UPNG_INDEXED1;
+		case 2:
+			return UPNG_INDEXED2;
+		case 4:
+			return UPNG_INDEXED4;
+		case 8:
+			return UPNG_INDEXED8;
+		default:
+			return UPNG_BADFORMAT;
+		}
 	default:
 		return UPNG_BADFORMAT;
 	}
@@ -884,9 +1127,10 @@ static upng_format determine_format(upng_t* upng) {
 static void upng_free_source(upng_t* upng)
 {
 	if (upng->source.owning != 0) {
-		free((void*)upng->source.buffer);
+		memory_free((void*)upng->source.buffer);
 	}
 
+	unmap_file(&upng->source.mapping);
 	upng->source.buffer = NULL;
 	upng->source.size = 0;
 	upng->source.owning = 0;
@@ -960,150 +1204,180 @@ upng_error upng_header(upng_t* upng)
 	return upng->error;
 }
 
-/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-upng_error upng_decode(upng_t* upng)
+/*read the PLTE chunk, the entries it does not set are opaque black. images that are not indexed may carry a
+  suggested palette, it is kept the same way but not used*/
+static void read_palette(upng_t* upng, const unsigned char *data, unsigned long length)
 {
-	const unsigned char *chunk;
-	unsigned char* compressed;
-	unsigned char* inflated;
-	unsigned long compressed_size = 0, compressed_index = 0;
-	unsigned long inflated_size;
-	upng_error error;
+	unsigned i;
 
-	/* if we have an error state, bail now */
-	if (upng->error != UPNG_EOK) {
-		return upng->error;
-	}
-
-	/* parse the main header, if necessary */
-	upng_header(upng);
-	if (upng->error != UPNG_EOK) {
-		return upng->error;
+	if (length == 0 || length % 3 != 0 || length / 3 > 256 || upng->palette_size != 0) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return;
 	}
 
-	/* if the state is not HEADER (meaning we are ready to decode the image), stop now */
-	if (upng->state != UPNG_HEADER) {
-		return upng->error;
+	upng->palette_size = length / 3;
+	for (i = 0; i < 256; i++) {
+		unsigned char *entry = upng->palette + i * 4;
+		if (i < upng->palette_size) {
+			entry[0] = data[i * 3 + 0];
+			entry[1] = data[i * 3 + 1];
+			entry[2] = data[i * 3 + 2];
+		} else {
+			entry[0] = entry[1] = entry[2] = 0;
+		}
+		entry[3] = 255;
 	}
+}
 
-	/* release old result, if any */
-	if (upng->buffer != 0) {
-		free(upng->buffer);
-		upng->buffer = 0;
-		upng->size = 0;
-	}
+/*find the first IDAT chunk, and verify the general well-formedness of all the chunks on the way*/
+static const unsigned char* find_first_idat(upng_t* upng)
+{
+	const unsigned char *chunk;
+	const unsigned char *first_idat = NULL;
 
 	/* first byte of the first chunk after the header */
 	chunk = upng->source.buffer + 33;
 
-	/* scan through the chunks, finding the size of all IDAT chunks, and also
-	 * verify general well-formed-ness */
 	while (chunk < upng->source.buffer + upng->source.size) {
 		unsigned long length;
-		const unsigned char *data;	/*the data in the chunk */
 
 		/* make sure chunk header is not larger than the total compressed */
 		if ((unsigned long)(chunk - upng->source.buffer + 12) > upng->source.size) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
+			return NULL;
 		}
 
 		/* get length; sanity check it */
 		length = upng_chunk_length(chunk);
 		if (length > INT_MAX) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
+			return NULL;
 		}
 
 		/* make sure chunk header+paylaod is not larger than the total compressed */
 		if ((unsigned long)(chunk - upng->source.buffer + length + 12) > upng->source.size) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
+			return NULL;
 		}
 
-		/* get pointer to payload */
-		data = chunk + 8;
-
 		/* parse chunks */
 		if (upng_chunk_type(chunk) == CHUNK_IDAT) {
-			compressed_size += length;
+			if (first_idat == NULL) {
+				first_idat = chunk;
+			}
+		} else if (upng_chunk_type(chunk) == CHUNK_PLTE) {
+			read_palette(upng, chunk + 8, length);
+			if (upng->error != UPNG_EOK) {
+				return NULL;
+			}
+		} else if (upng_chunk_type(chunk) == CHUNK_TRNS && upng->color_type == UPNG_PALETTE) {
+			/* the alpha of the first palette entries */
+			unsigned i;
+			if (length > upng->palette_size) {
+				SET_ERROR(upng, UPNG_EMALFORMED);
+				return NULL;
+			}
+			for (i = 0; i < length; i++) {
+				upng->palette[i * 4 + 3] = chunk[8 + i];
+			}
 		} else if (upng_chunk_type(chunk) == CHUNK_IEND) {
 			break;
 		} else if (upng_chunk_critical(chunk)) {
 			SET_ERROR(upng, UPNG_EUNSUPPORTED);
-			return upng->error;
+			return NULL;
 		}
 
-		chunk += upng_chunk_length(chunk) + 12;
+		chunk += length + 12;
 	}
 
-	/* allocate enough space for the (compressed and filtered) image data */
-	compressed = (unsigned char*)malloc(compressed_size);
-	if (compressed == NULL) {
-		SET_ERROR(upng, UPNG_ENOMEM);
-		return upng->error;
+	if (first_idat == NULL || (upng->color_type == UPNG_PALETTE && upng->palette_size == 0)) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return NULL;
 	}
+	return first_idat;
+}
 
-	/* scan through the chunks again, this time copying the values into
-	 * our compressed buffer.  there's no reason to validate anything a second time. */
-	chunk = upng->source.buffer + 33;
-	while (chunk < upng->source.buffer + upng->source.size) {
-		unsigned long length;
-		const unsigned char *data;	/*the data in the chunk */
-
-		length = upng_chunk_length(chunk);
-		data = chunk + 8;
-
-		/* parse chunks */
-		if (upng_chunk_type(chunk) == CHUNK_IDAT) {
-			memcpy(compressed + compressed_index, data, length);
-			compressed_index += length;
-		} else if (upng_chunk_type(chunk) == CHUNK_IEND) {
-			break;
-		}
+static unsigned long decoded_size(const upng_t* upng)
+{
+	return ((unsigned long)upng->height * upng->width * upng_get_bpp(upng) + 7) / 8;
+}
 
-		chunk += upng_chunk_length(chunk) + 12;
+/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+upng_error upng_decode(upng_t* upng)
+{
+	/* if we have an error state, bail now */
+	if (upng->error != UPNG_EOK) {
+		return upng->error;
 	}
 
-	/* allocate space to store inflated (but still filtered) data */
-	inflated_size = ((upng->width * (upng->height * upng_get_bpp(upng) + 7)) / 8) + upng->height;
-	inflated = (unsigned char*)malloc(inflated_size);
-	if (inflated == NULL) {
-		free(compressed);
-		SET_ERROR(upng, UPNG_ENOMEM);
+	/* parse the main header, if necessary */
+	upng_header(upng);
+	if (upng->error != UPNG_EOK) {
 		return upng->error;
 	}
 
-	/* decompress image data */
-	error = uz_inflate(upng, inflated, inflated_size, compressed, compressed_size);
-	if (error != UPNG_EOK) {
-		free(compressed);
-		free(inflated);
+	/* if the state is not HEADER (meaning we are ready to decode the image), stop now */
+	if (upng->state != UPNG_HEADER) {
 		return upng->error;
 	}
 
-	/* free the compressed compressed data */
-	free(compressed);
+	/* release old result, if any */
+	if (upng->buffer != 0) {
+		memory_free(upng->buffer);
+		upng->buffer = 0;
+		upng->size = 0;
+	}
 
 	/* allocate final image buffer */
-	upng->size = (upng->height * upng->width * upng_get_bpp(upng) + 7) / 8;
-	upng->buffer = (unsigned char*)malloc(upng->size);
+	upng->size = decoded_size(upng);
+	upng->buffer = (unsigned char*)memory_alloc(MEMORY_PNG, upng->size);
 	if (upng->buffer == NULL) {
-		free(inflated);
 		upng->size = 0;
 		SET_ERROR(upng, UPNG_ENOMEM);
 		return upng->error;
 	}
 
-	/* unfilter scanlines */
-	post_process_scanlines(upng, upng->buffer, inflated, upng);
-	free(inflated);
-
+	upng_decode_into(upng, upng->buffer, upng->size);
 	if (upng->error != UPNG_EOK) {
-		free(upng->buffer);
+		memory_free(upng->buffer);
 		upng->buffer = NULL;
 		upng->size = 0;
-	} else {
+	}
+
+	return upng->error;
+}
+
+static upng_error decode_image(upng_t* upng, unsigned char* out, unsigned long size, int rgba)
+{
+	const unsigned char *first_idat;
+
+	/* if we have an error state, bail now */
+	if (upng->error != UPNG_EOK) {
+		return upng->error;
+	}
+
+	/* parse the main header, if necessary */
+	upng_header(upng);
+	if (upng->error != UPNG_EOK) {
+		return upng->error;
+	}
+
+	/* if the state is not HEADER (meaning we are ready to decode the image), stop now */
+	if (upng->state != UPNG_HEADER) {
+		return upng->error;
+	}
+
+	if (out == NULL || size < (rgba ? (unsigned long)upng->width * upng->height * 4 : decoded_size(upng))) {
+		SET_ERROR(upng, UPNG_EPARAM);
+		return upng->error;
+	}
+
+	/* inflate and unfilter the scanlines straight from the IDAT chunks */
+	first_idat = find_first_idat(upng);
+	if (upng->error == UPNG_EOK) {
+		decode_scanlines(upng, out, first_idat, rgba);
+	}
+	if (upng->error == UPNG_EOK) {
 		upng->state = UPNG_DECODED;
 	}
 
@@ -1113,11 +1387,23 @@ upng_error upng_decode(upng_t* upng)
 	return upng->error;
 }
 
+/*read a PNG into out, which must hold width * height * bpp bits: the decoder does not keep a copy of the image*/
+upng_error upng_decode_into(upng_t* upng, unsigned char* out, unsigned long size)
+{
+	return decode_image(upng, out, size, 0);
+}
+
+/*read a PNG of any format into out as 8 bit R, G, B, A in memory order; out must hold width * height * 4 bytes*/
+upng_error upng_decode_rgba(upng_t* upng, unsigned char* out, unsigned long size)
+{
+	return decode_image(upng, out, size, 1);
+}
+
 static upng_t* upng_new(void)
 {
 	upng_t* upng;
 
-	upng = (upng_t*)malloc(sizeof(upng_t));
+	upng = (upng_t*)memory_alloc(MEMORY_PNG, sizeof(upng_t));
 	if (upng == NULL) {
 		return NULL;
 	}
@@ -1130,6 +1416,7 @@ static upng_t* upng_new(void)
 	upng->color_type = UPNG_RGBA;
 	upng->color_depth = 8;
 	upng->format = UPNG_RGBA8;
+	upng->palette_size = 0;
 
 	upng->state = UPNG_NEW;
 
@@ -1139,6 +1426,7 @@ static upng_t* upng_new(void)
 	upng->source.buffer = NULL;
 	upng->source.size = 0;
 	upng->source.owning = 0;
+	memset(&upng->source.mapping, 0, sizeof(upng->source.mapping));
 
 	return upng;
 }
@@ -1160,40 +1448,21 @@ upng_t* upng_new_from_bytes(const unsigned char* buffer, unsigned long size)
 upng_t* upng_new_from_file(const char *filename)
 {
 	upng_t* upng;
-	unsigned char *buffer;
-	FILE *file;
-	long size;
 
 	upng = upng_new();
 	if (upng == NULL) {
 		return NULL;
 	}
 
-	file = fopen(filename, "rb");
-	if (file == NULL) {
+	/* the file is mapped rather than read, the decoder reads the chunks in place */
+	if (!map_file(filename, &upng->source.mapping)) {
 		SET_ERROR(upng, UPNG_ENOTFOUND);
 		return upng;
 	}
 
-	/* get filesize */
-	fseek(file, 0, SEEK_END);
-	size = ftell(file);
-	rewind(file);
-
-	/* read contents of the file into the vector */
-	buffer = (unsigned char *)malloc((unsigned long)size);
-	if (buffer == NULL) {
-		fclose(file);
-		SET_ERROR(upng, UPNG_ENOMEM);
-		return upng;
-	}
-	fread(buffer, 1, (unsigned long)size, file);
-	fclose(file);
-
-	/* set the read buffer as our source buffer, with owning flag set */
-	upng->source.buffer = buffer;
-	upng->source.size = size;
-	upng->source.owning = 1;
+	upng->source.buffer = upng->source.mapping.data;
+	upng->source.size = (unsigned long)upng->source.mapping.size;
+	upng->source.owning = 0;
 
 	return upng;
 }
@@ -1202,14 +1471,14 @@ void upng_free(upng_t* upng)
 {
 	/* deallocate image buffer */
 	if (upng->buffer != NULL) {
-		free(upng->buffer);
+		memory_free(upng->buffer);
 	}
 
 	/* deallocate source buffer, if necessary */
 	upng_free_source(upng);
 
 	/* deallocate struct itself */
-	free(upng);
+	memory_free(upng);
 }
 
 upng_error upng_get_error(const upng_t* upng)
@@ -1241,6 +1510,7 @@ unsigned upng_get_components(const upng_t* upng)
 {
 	switch (upng->color_type) {
 	case UPNG_LUM:
+	case UPNG_PALETTE:
 		return 1;
 	case UPNG_RGB:
 		return 3;
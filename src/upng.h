@@ -52,7 +52,11 @@ typedef enum upng_format {
 	UPNG_LUMINANCE_ALPHA1,
 	UPNG_LUMINANCE_ALPHA2,
 	UPNG_LUMINANCE_ALPHA4,
-	UPNG_LUMINANCE_ALPHA8
+	UPNG_LUMINANCE_ALPHA8,
+	UPNG_INDEXED1,
+	UPNG_INDEXED2,
+	UPNG_INDEXED4,
+	UPNG_INDEXED8
 } upng_format;
 
 typedef struct upng_t upng_t;
@@ -63,6 +67,8 @@ void		upng_free			(upng_t* upng);
 
 upng_error	upng_header			(upng_t* upng);
 upng_error	upng_decode			(upng_t* upng);
+upng_error	upng_decode_into	(upng_t* upng, unsigned char* out, unsigned long size);
+upng_error	upng_decode_rgba	(upng_t* upng, unsigned char* out, unsigned long size);
 
 upng_error	upng_get_error		(const upng_t* upng);
 unsigned	upng_get_error_line	(const upng_t* upng);
@@ -0,0 +1,180 @@
+#include "upng.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************/
+/* Decodes every PNG given on the command line as it   */
+/* is, then with its zlib stream split again into IDAT */
+/* chunks of small, odd and random sizes. The decoder  */
+/* streams across chunk boundaries, so any split must  */
+/* give the same pixels.                               */
+/*******************************************************/
+
+#define SPLIT_FIXED_MAX 64      // Every chunk size from 1 byte up to this one
+#define SPLIT_RANDOM_RUNS 64    // Splits into chunks of random sizes
+
+static uint32_t crc_table[256];
+
+static void init_crc_table() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+    return p + 4;
+}
+
+static uint8_t* put_chunk(uint8_t* p, const char* type, const uint8_t* data, uint32_t length) {
+    p = put_u32(p, length);
+    memcpy(p, type, 4);
+    memcpy(p + 4, data, length);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint32_t i = 0; i < length + 4; ++i) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return put_u32(p + 4 + length, crc ^ 0xFFFFFFFFu);
+}
+
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(*size);
+    if (data && fread(data, 1, *size, file) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+// RGBA8 pixels of a PNG in memory, NULL when it does not decode
+static uint8_t* decode(const uint8_t* png_data, size_t size, size_t* pixels_size, int* error) {
+    upng_t* png = upng_new_from_bytes(png_data, (unsigned long)size);
+    uint8_t* pixels = NULL;
+    *error = png ? upng_header(png) : UPNG_ENOMEM;
+    if (*error == UPNG_EOK) {
+        *pixels_size = (size_t)upng_get_width(png) * upng_get_height(png) * 4;
+        pixels = malloc(*pixels_size);
+        *error = upng_decode_rgba(png, pixels, (unsigned long)*pixels_size);
+        if (*error != UPNG_EOK) {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    upng_free(png);
+    return pixels;
+}
+
+// Rewrites png with the concatenated IDAT data cut into chunks of next_size() bytes
+typedef uint32_t (*split_size_t)(uint32_t* state);
+
+static size_t split_idat(uint8_t* out, const uint8_t* png, size_t size, split_size_t next_size, uint32_t state) {
+    uint8_t* p = out;
+    memcpy(p, png, 8);
+    p += 8;
+    bool written = false;
+    for (size_t offset = 8; offset + 12 <= size;) {
+        uint32_t length = read_u32(png + offset);
+        const uint8_t* type = png + offset + 4;
+        if (memcmp(type, "IDAT", 4) != 0) {
+            p = put_chunk(p, (const char*)type, type + 4, length);
+        } else if (!written) {
+            // Every IDAT chunk of the source, the data of the later ones goes out with the first
+            for (size_t idat = offset; idat + 12 <= size && memcmp(png + idat + 4, "IDAT", 4) == 0;) {
+                uint32_t idat_length = read_u32(png + idat);
+                const uint8_t* data = png + idat + 8;
+                for (uint32_t done = 0; done < idat_length;) {
+                    uint32_t piece = next_size(&state);
+                    if (piece > idat_length - done) {
+                        piece = idat_length - done;
+                    }
+                    p = put_chunk(p, "IDAT", data + done, piece);
+                    done += piece;
+                }
+                idat += 12 + idat_length;
+            }
+            written = true;
+        }
+        offset += 12 + (size_t)length;
+    }
+    return (size_t)(p - out);
+}
+
+static uint32_t fixed_size(uint32_t* state) {
+    return *state;
+}
+
+static uint32_t random_size(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return 1 + (*state >> 16) % 97;
+}
+
+static bool check_split(const char* path, const uint8_t* png, size_t size, const uint8_t* expected, size_t expected_size,
+    uint8_t* split, split_size_t next_size, uint32_t state, const char* description) {
+    size_t split_size = split_idat(split, png, size, next_size, state);
+    size_t pixels_size = 0;
+    int error;
+    uint8_t* pixels = decode(split, split_size, &pixels_size, &error);
+    bool same = pixels && pixels_size == expected_size && memcmp(pixels, expected, expected_size) == 0;
+    if (!same) {
+        fprintf(stderr, "<!> %s in IDAT chunks of %s %u: %s (error %d).\n", path, description, state,
+            pixels ? "different pixels" : "does not decode", error);
+    }
+    free(pixels);
+    return same;
+}
+
+int main(int argc, char** argv) {
+    init_crc_table();
+    int checks = 0;
+    int failures = 0;
+    for (int i = 1; i < argc; ++i) {
+        size_t size;
+        uint8_t* png = read_file(argv[i], &size);
+        size_t expected_size = 0;
+        int error = UPNG_ENOTFOUND;
+        uint8_t* expected = png ? decode(png, size, &expected_size, &error) : NULL;
+        if (expected == NULL) {
+            fprintf(stderr, "<!> %s does not decode (error %d).\n", argv[i], error);
+            free(png);
+            failures++;
+            continue;
+        }
+
+        // 1-byte chunks take 13 bytes each
+        uint8_t* split = malloc(size * 13 + 64);
+        for (uint32_t piece = 1; piece <= SPLIT_FIXED_MAX; ++piece, ++checks) {
+            failures += !check_split(argv[i], png, size, expected, expected_size, split, fixed_size, piece, "size");
+        }
+        for (uint32_t seed = 1; seed <= SPLIT_RANDOM_RUNS; ++seed, ++checks) {
+            failures += !check_split(argv[i], png, size, expected, expected_size, split, random_size, seed, "random sizes, seed");
+        }
+        free(split);
+        free(expected);
+        free(png);
+    }
+    printf("Split IDAT decodes: %d checked, %d failed\n", checks, failures);
+    return failures == 0 && argc > 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+}